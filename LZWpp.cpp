@@ -2,15 +2,60 @@
 #include <fstream>
 #include <sstream>
 #include <unordered_map>
-#include <windows.h>
 #include <functional>
 #include <iomanip>
 #include <thread>
 #include <chrono>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <future>
+#include <exception>
 #include <clocale>
 #include <codecvt>
+#include <queue>
+#include <deque>
+#include <memory>
+#include <array>
+#include <bitset>
+#include <map>
+#include <set>
+#include <list>
+#include <numeric>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include "LZWpp.h"
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LZWPP_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <malloc.h>
+#endif
 
 // Utility functions for various common tasks
 class Utility {
@@ -42,45 +87,16 @@ public:
         return u32_converter.from_bytes(utf8_str);
     }
 
-    // Reads a file into a vector<uint8_t>
-    static void readFileToVector(const std::u32string& filename, std::vector<uint8_t>& data) {
-        std::wstring wfilename = u32stringToWstring(filename); // Convert UTF-32 string path to wide string
-
-        std::ifstream file(wfilename, std::ios::binary | std::ios::ate); // Open file and seek to the end
-        if (!file) {
-            throw std::exception("Error opening file for reading.");
-        }
-
-        // Get the size of the file
-        std::streamsize size = file.tellg();
-        file.seekg(0, std::ios::beg); // Move back to the beginning of the file
-
-        // Resize the vector to accommodate the data
-        data.resize(static_cast<size_t>(size));
-
-        // Read the vector data from the file
-        if (size > 0) {
-            file.read(reinterpret_cast<char*>(data.data()), size);
-        }
-
-        file.close();
-    }
-
-    // Writes a vector<uint8_t> to a file
-    static void writeVectorToFile(const std::u32string& filename, const std::vector<uint8_t>& data) {
-        std::wstring wfilename = u32stringToWstring(filename); // Convert UTF-32 string path to wide string
-
-        std::ofstream file(wfilename, std::ios::binary);
-        if (!file) {
-            throw std::exception("Error opening file for writing.");
-        }
+    // Reads a file into a vector<uint8_t> through the active I/O backend
+    static void readFileToVector(const std::u32string& filename, std::vector<uint8_t>& data);
 
-        // Write the vector data to the file
-        if (!data.empty()) {
-            file.write(reinterpret_cast<const char*>(data.data()), data.size());
-        }
+    // Writes a vector<uint8_t> to a file through the active I/O backend
+    static void writeVectorToFile(const std::u32string& filename, const std::vector<uint8_t>& data);
 
-        file.close();
+    // Converts a UTF-32 encoded std::u32string to a UTF-8 encoded std::string
+    static std::string u32stringToString(const std::u32string& u32str) {
+        std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> converter;
+        return converter.to_bytes(u32str);
     }
 
     // Appends the contents of 'src' vector to the end of 'dest' vector
@@ -97,7 +113,7 @@ public:
         std::u32string::size_type spacePos = input.rfind(U' ');
 
         if (spacePos == std::u32string::npos) {
-            throw std::exception("Cannot parse input: no space found.");
+            throw std::runtime_error("Cannot parse input: no space found.");
         }
 
         // Extract the file path part (before the option)
@@ -143,26 +159,36 @@ public:
 
     // Checks if a file exists at the given UTF-32 encoded path
     static bool fileExists(const std::u32string& path) {
+#ifdef _WIN32
         std::wstring wpath = u32stringToWstring(path); // Convert UTF-32 string path to wide string
 
         struct _stat buffer;
         return (_wstat(wpath.c_str(), &buffer) == 0);
+#else
+        struct stat buffer;
+        return stat(u32stringToString(path).c_str(), &buffer) == 0;
+#endif
     }
 
     // Function to verify if the input option is valid
     static bool isValidOption(const std::u32string& option) {
         // Check if the extension starts with a dot
-        if (option == U"-c" || option == U"-d") return true;
+        if (option == U"-c" || option == U"-ce" || option == U"-cf" || option == U"-cp" || option == U"-cd" || option == U"-a" || option == U"-d" || option == U"-b" || option == U"-e" || option == U"-t" || option == U"-v" || option == U"-s") return true;
         else return false;
     }
 
     // Retrieves the size of a file without opening it
     static std::uintmax_t getFileSize(const std::u32string& filePath) {
+#ifdef _WIN32
         // Convert the UTF-32 file path to a wide string (wstring)
         std::wstring wfilePath = u32stringToWstring(filePath);
 
         struct _stat stat_buf;
         int rc = _wstat(wfilePath.c_str(), &stat_buf);
+#else
+        struct stat stat_buf;
+        int rc = stat(u32stringToString(filePath).c_str(), &stat_buf);
+#endif
         return rc == 0 ? static_cast<std::uintmax_t>(stat_buf.st_size) : static_cast<std::uintmax_t>(0);
     }
 
@@ -204,1188 +230,8516 @@ public:
         std::size_t end = start + length < source.size() ? start + length : source.size(); // Set to the minimum
         return std::vector<uint8_t>(source.begin() + start, source.begin() + end);
     }
+
+    // Reads the whole standard input as bytes
+    static void readStandardInput(std::vector<uint8_t>& data) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY); // No newline translation
+#endif
+        data.clear();
+        std::vector<uint8_t> buffer(1 << 20);
+        size_t count;
+        while ((count = std::fread(buffer.data(), 1, buffer.size(), stdin)) > 0) {
+            data.insert(data.end(), buffer.begin(), buffer.begin() + count);
+        }
+        if (std::ferror(stdin)) throw std::runtime_error("Cannot read the standard input.");
+    }
+
+    // Writes bytes to the standard output
+    static void writeStandardOutput(const std::vector<uint8_t>& data) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY); // No newline translation
+#endif
+        if (std::fwrite(data.data(), 1, data.size(), stdout) != data.size() || std::fflush(stdout) != 0) {
+            throw std::runtime_error("Cannot write the standard output.");
+        }
+    }
 };
 
-// Graphic User Interface (GUI) handling various display functions
-class GUI {
+// Fragments of memory handled as one logical stream, like an iovec array
+// Blocks are cut from the stream wherever they fall, so a block may take bytes from several fragments.
+template <class Byte>
+class ByteSpans {
 
 public:
-    // Clears the console screen by filling it with spaces and resetting the cursor position
-    static void clearScreen() {
-        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-        COORD coordScreen = { 0, 0 };    // Coordinates for the top-left corner of the screen
-        DWORD charsWritten;
-        CONSOLE_SCREEN_BUFFER_INFO csbi;
-        DWORD consoleSize;
+    struct Span {
+        Byte* data; // First byte of the fragment
+        size_t size; // Bytes in the fragment
+    };
 
-        // Retrieve the current screen buffer information
-        GetConsoleScreenBufferInfo(hConsole, &csbi);
-        consoleSize = csbi.dwSize.X * csbi.dwSize.Y;
+    explicit ByteSpans(std::vector<Span> spans) : spans(std::move(spans)) {
+        starts.reserve(this->spans.size() + 1);
+        starts.push_back(0);
+        for (const Span& span : this->spans) starts.push_back(starts.back() + span.size);
+    }
 
-        // Fill the entire screen buffer with spaces
-        FillConsoleOutputCharacter(hConsole, ' ', consoleSize, coordScreen, &charsWritten);
+    // A single fragment
+    ByteSpans(Byte* data, size_t size) : ByteSpans(std::vector<Span>{ { data, size } }) {}
 
-        // Restore the screen attributes (colors and other attributes)
-        FillConsoleOutputAttribute(hConsole, csbi.wAttributes, consoleSize, coordScreen, &charsWritten);
+    // Bytes in all fragments together
+    size_t size() const { return starts.empty() ? 0 : starts.back(); }
 
-        // Move the cursor back to the top-left corner of the screen
-        SetConsoleCursorPosition(hConsole, coordScreen);
+    // 'length' bytes at 'offset' when one fragment holds them all, nullptr otherwise
+    Byte* contiguous(size_t offset, size_t length) const {
+        size_t first = find(offset);
+        if (first < spans.size() && offset <= starts[first + 1] && length <= starts[first + 1] - offset) return spans[first].data + (offset - starts[first]);
+        return nullptr;
     }
 
-    // Returns the ASCII art for the Main screen of the GUI
-    static const std::string& drawMainScreen() {
-        static const std::string mainScreen =
-            "  __________________________________________________________________ \n"
-            " /                                                                  \\ \n"
-            " | General purpose Lempel-Ziv-Welch compressor                      | \n"
-            " |                                                                  | \n"
-            " | Compress     D:\\Folder\\File.ext -c -> D:\\Folder\\File.bin         | \n"
-            " | Decompress   D:\\Folder\\File.bin -d -> D:\\Folder\\File Decoded.ext | \n"
-            " |__________________________________________________________________| \n"
-            " |                                                                  | \n"
-            " | Input:                                                           | \n"
-            " \\__________________________________________________________________/ \n"
-            "  __________________________________________________________________   \n"
-            " /                                                                  \\  \n"
-            " | Progress: [--------------------] 0 %       Time: 00:00:00        | \n"
-            " |                                                                  | \n"
-            " | Size: - / -                               Speed: -               | \n"
-            " |__________________________________________________________________| \n"
-            " |                                                                  | \n"
-            " | Output: -                                                        | \n"
-            " \\__________________________________________________________________/ \n"
-            "                                                                       "
-            ;
-
-        return mainScreen;
+    // 'length' bytes at 'offset', in place when one fragment holds them all, otherwise copied into 'scratch'
+    const uint8_t* read(size_t offset, size_t length, std::vector<uint8_t>& scratch) const {
+        if (const uint8_t* data = contiguous(offset, length)) return data;
+        scratch.resize(length);
+        gather(offset, length, scratch.data());
+        return scratch.data();
     }
 
-    // Returns the ASCII art for the Error screen of the GUI
-    static const std::string& drawErrorScreen() {
-        static const std::string errorScreen =
-            "  __________________________________________________________________   \n"
-            " /                                                                  \\  \n"
-            " | Error:                                                           | \n"
-            " \\__________________________________________________________________/ \n"
-            "                                                                       "
-            ;
-
-        return errorScreen;
+    // Copies 'length' bytes at 'offset' to 'output'
+    void gather(size_t offset, size_t length, uint8_t* output) const {
+        check(offset, length);
+        for (size_t i = find(offset); length > 0; ++i) {
+            size_t skip = offset - starts[i];
+            size_t chunk = std::min(length, spans[i].size - skip);
+            std::memcpy(output, spans[i].data + skip, chunk);
+            output += chunk;
+            offset += chunk;
+            length -= chunk;
+        }
     }
 
-    // Generates a progress bar as a string representation
-    // The progress bar is visualized with '#' characters for completed progress and '-' for remaining progress
-    static std::string drawProgressBar(double progressBar) {
-        // Create the progress bar using '#' and '-' characters
-        return "[" + std::string(static_cast<int>(std::round(progressBar * 20)), '#') +
-            std::string(static_cast<int>(std::round((1 - progressBar) * 20)), '-') +
-            "] " + std::to_string(static_cast<int>(std::round(progressBar * 100))) + " %";
+    // Copies 'length' bytes from 'input' to 'offset' (fragments of writable memory only)
+    void scatter(size_t offset, const uint8_t* input, size_t length) const {
+        check(offset, length);
+        for (size_t i = find(offset); length > 0; ++i) {
+            size_t skip = offset - starts[i];
+            size_t chunk = std::min(length, spans[i].size - skip);
+            std::memcpy(spans[i].data + skip, input, chunk);
+            input += chunk;
+            offset += chunk;
+            length -= chunk;
+        }
     }
 
-    // Formats the size of a file or data for display
-    // Sizes are formatted as Bytes, KB, MB, or GB depending on the magnitude
-    static std::string drawSizeField(size_t size) {
-        std::ostringstream oss;
+    // Reads single bytes at increasing offsets, finding the fragment only when the offset leaves the current one
+    class Cursor {
 
-        // Format size with appropriate units
-        if (size < 1024) {
-            oss << size << " Bytes";
-        }
-        else if (size < 1024 * 1024) {
-            oss << std::fixed << std::setprecision(2) << (size / 1024.0) << " KB";
-        }
-        else if (size < 1024 * 1024 * 1024) {
-            oss << std::fixed << std::setprecision(2) << (size / (1024.0 * 1024.0)) << " MB";
-        }
-        else {
-            oss << std::fixed << std::setprecision(2) << (size / (1024.0 * 1024.0 * 1024.0)) << " GB";
+    public:
+        explicit Cursor(const ByteSpans& spans) : spans(spans) {}
+
+        uint8_t operator()(size_t offset) {
+            if (offset - begin >= length) {
+                size_t i = spans.find(offset);
+                begin = spans.starts[i];
+                length = spans.spans[i].size;
+                data = spans.spans[i].data;
+            }
+            return data[offset - begin];
         }
 
-        return oss.str();
-    }
+    private:
+        const ByteSpans& spans;
+        const Byte* data = nullptr; // Current fragment
+        size_t begin = 0; // Offset of the current fragment in the stream
+        size_t length = 0; // Size of the current fragment
+    };
 
-    // Formats the data transfer speed for display
-    // Speeds are formatted as Bytes/s, KB/s, MB/s, or GB/s depending on the magnitude
-    static std::string drawSpeed(size_t size, double duration) {
-        if (duration <= 0) {
-            duration = 1; // Handle invalid duration input
-        }
+private:
+    std::vector<Span> spans; // Fragments in stream order
+    std::vector<size_t> starts; // Offset of every fragment in the stream, then the total size
 
-        double speed = (size / duration); // Calculate speed in Bytes per second
-        std::ostringstream oss;
+    // Fragment holding 'offset' (skipping empty ones); the end of the stream maps to the last fragment
+    size_t find(size_t offset) const {
+        if (spans.empty()) return 0;
+        return static_cast<size_t>(std::upper_bound(starts.begin(), starts.end() - 1, offset) - starts.begin()) - 1;
+    }
 
-        // Format speed with appropriate units
-        if (speed < 1024) {
-            oss << std::fixed << std::setprecision(2) << speed << " Bytes/s";
-        }
-        else if (speed < 1024 * 1024) {
-            oss << std::fixed << std::setprecision(2) << (speed / 1024.0) << " KB/s";
-        }
-        else if (speed < 1024 * 1024 * 1024) {
-            oss << std::fixed << std::setprecision(2) << (speed / (1024.0 * 1024.0)) << " MB/s";
+    void check(size_t offset, size_t length) const {
+        if (offset > size() || length > size() - offset) {
+            throw std::runtime_error("Range is outside the spans.");
         }
-        else {
-            oss << std::fixed << std::setprecision(2) << (speed / (1024.0 * 1024.0 * 1024.0)) << " GB/s";
-        }
-
-        return oss.str();
     }
 };
 
-// Cursor manipulation for managing console cursor and screen interactions
-class Cursor {
+using InputSpans = ByteSpans<const uint8_t>; // Fragments of data to compress
+using OutputSpans = ByteSpans<uint8_t>; // Fragments of memory to decompress into
+
+// Tuning for the block-based I/O backends
+struct IOOptions {
+    size_t requestSize = 1 << 20; // Bytes per read or write request
+    int queueDepth = 8; // Requests kept in flight at once
+    bool directIO = false; // Bypass the page cache (O_DIRECT / FILE_FLAG_NO_BUFFERING)
+};
+
+// Page-aligned memory block, as required for direct I/O and registered io_uring buffers
+class AlignedBuffer {
 
 public:
-    // Retrieves the coordinates of the last non-space character on the console screen
-    static COORD getLastConsoleChar() {
-        // Obtain the handle to the console
-        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    static const size_t alignment = 4096;
+
+    explicit AlignedBuffer(size_t size) : buffer(nullptr), length(roundUp(size)) {
+        if (length == 0) return;
+#ifdef _WIN32
+        buffer = static_cast<uint8_t*>(_aligned_malloc(length, alignment));
+#else
+        void* memory = nullptr;
+        if (posix_memalign(&memory, alignment, length) == 0) buffer = static_cast<uint8_t*>(memory);
+#endif
+        if (!buffer) throw std::bad_alloc();
+    }
 
-        // Initialize structure to store console screen buffer info
-        CONSOLE_SCREEN_BUFFER_INFO csbi;
+    ~AlignedBuffer() {
+#ifdef _WIN32
+        _aligned_free(buffer);
+#else
+        free(buffer);
+#endif
+    }
 
-        // Get information about the console screen buffer
-        if (GetConsoleScreenBufferInfo(hConsole, &csbi)) {
-            // Calculate total number of characters in the console screen buffer
-            DWORD consoleSize = csbi.dwSize.X * csbi.dwSize.Y;
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
 
-            // Allocate buffer to store console screen contents
-            CHAR_INFO* buffer = new CHAR_INFO[consoleSize];
+    uint8_t* data() const { return buffer; }
+    size_t size() const { return length; }
 
-            COORD bufferSize = csbi.dwSize;
-            COORD bufferCoord = { 0, 0 };
-            SMALL_RECT readRegion = { 0, 0, csbi.dwSize.X - 1, csbi.dwSize.Y - 1 };
+    // Rounds a size up to the next multiple of the alignment
+    static size_t roundUp(size_t size) {
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
 
-            // Read console screen buffer into the allocated buffer
-            if (ReadConsoleOutput(hConsole, buffer, bufferSize, bufferCoord, &readRegion)) {
-                // Search buffer in reverse to find the last non-space character
-                for (int i = consoleSize - 1; i >= 0; --i) {
-                    if (buffer[i].Char.AsciiChar != ' ') {
-                        // Determine the coordinates of the last non-space character
-                        COORD lastCharPos = {
-                            static_cast<SHORT>(i % csbi.dwSize.X),
-                            static_cast<SHORT>(i / csbi.dwSize.X)
-                        };
+private:
+    uint8_t* buffer; // Aligned allocation
+    size_t length; // Size of the allocation in bytes
+};
 
-                        delete[] buffer;
-                        return lastCharPos;
-                    }
-                }
-            }
+// Limits for running as a background job next to latency-sensitive services
+struct ThrottleOptions {
+    double ioBytesPerSecond = 0; // Cap on file reads and writes together, 0 for no cap
+    double cpuShare = 1.0; // Share of wall time a worker may spend running tasks (duty cycle, 0-1]
+    int maxWorkers = 0; // Workers allowed to run tasks at the same time, 0 for all of them
+
+    // LZWPP_IO_MBPS caps file I/O, LZWPP_CPU_SHARE sets the worker duty cycle and LZWPP_WORKERS how many workers run at once
+    static ThrottleOptions fromEnvironment() {
+        ThrottleOptions options;
+        if (std::getenv("LZWPP_IO_MBPS")) options.ioBytesPerSecond = std::atof(std::getenv("LZWPP_IO_MBPS")) * 1024 * 1024;
+        if (std::getenv("LZWPP_CPU_SHARE")) options.cpuShare = std::atof(std::getenv("LZWPP_CPU_SHARE"));
+        if (std::getenv("LZWPP_WORKERS")) options.maxWorkers = std::atoi(std::getenv("LZWPP_WORKERS"));
+        return options;
+    }
+};
 
-            delete[] buffer;
-        }
+// Token bucket: holds up to one burst of bytes and refills at a fixed rate
+// Requests larger than the bucket are let through and paid back by later requests.
+class TokenBucket {
 
-        // Return {0, 0} if no non-space character is found
-        return { 0, 0 };
+public:
+    // Changes the rate (0 disables the limit); the bucket holds a quarter second of traffic
+    void setRate(double bytesPerSecond) {
+        std::lock_guard<std::mutex> lock(mutex);
+        rate = bytesPerSecond;
+        capacity = bytesPerSecond / 4;
+        tokens = capacity;
+        last = std::chrono::steady_clock::now();
     }
 
-    // Moves the cursor to the specified (x, y) position in the console
-    static void goTo(int x, int y) {
-        COORD coord = { x, y };
-        SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), coord);
+    // Blocks until 'bytes' may be transferred
+    void acquire(size_t bytes) {
+        double wait;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (rate <= 0) return;
+
+            auto now = std::chrono::steady_clock::now();
+            tokens = std::min(capacity, tokens + std::chrono::duration<double>(now - last).count() * rate);
+            last = now;
+            tokens -= static_cast<double>(bytes);
+            wait = tokens < 0 ? -tokens / rate : 0;
+        }
+        if (wait > 0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
     }
 
-    // Reads input from the console with support for line wrapping
-    // If maxLineLength is reached, wraps to the next line
-    // Optionally triggers a callback when the line changes
-    static std::u32string readInputStream(int maxLineLength, std::function<void(bool direction)> lineChangeCallback = nullptr) {
-        COORD initialPos = getCurrentCursorPosition();
+private:
+    std::mutex mutex;
+    double rate = 0; // Bytes per second
+    double capacity = 0; // Largest burst in bytes
+    double tokens = 0; // Bytes that may go now; negative while paying back a large request
+    std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+};
 
-        int startX = initialPos.X;
-        int startY = initialPos.Y;
-        int currentX = startX;
-        int currentY = startY;
+// Process-wide throttle consulted by the I/O backends and the worker pool
+// The limits can change while a job runs; pause() / backOff() hold back new I/O and new tasks, and
+// tasks already running stop at their next checkpoint(). On POSIX systems SIGUSR1 pauses and SIGUSR2 resumes.
+class Throttle {
 
-        int lineCount = 1;
+public:
+    static Throttle& getInstance() {
+        static Throttle instance; // Static instance for singleton pattern
+        return instance;
+    }
 
-        std::wstring input;
-        wchar_t ch;
+    Throttle(const Throttle&) = delete;
+    Throttle& operator=(const Throttle&) = delete;
 
-        while (true) {
-            ch = _getwch();  // Read wide character input
+    // Applies new limits, waking workers that may now run
+    void configure(const ThrottleOptions& newOptions) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            options = newOptions;
+            options.cpuShare = options.cpuShare > 0 && options.cpuShare < 1 ? options.cpuShare : 1.0;
+            dutyCycle = options.cpuShare < 1.0;
+        }
+        ioBucket.setRate(newOptions.ioBytesPerSecond);
+        turnAvailable.notify_all();
+    }
 
-            if (ch == L'\r') {  // Enter key
-                break;
-            }
-            else if (ch == L'\b' || ch == 8) {  // Backspace key
-                if (!input.empty()) {
-                    input.pop_back();
+    ThrottleOptions getOptions() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return options;
+    }
 
-                    if (currentX <= startX) {
-                        // Move back to the previous line if the current line is empty
-                        lineCount--;
-                        currentX = startX + maxLineLength - 1;
-                        currentY--;
+    // Stops new I/O and tasks until resume()
+    void pause() {
+        pausedFlag() = true;
+    }
 
-                        goTo(currentX, currentY);
-                        std::wcout << L' ' << L' '; // Erase character
+    void resume() {
+        pausedFlag() = false;
+        turnAvailable.notify_all();
+    }
 
-                        if (lineChangeCallback) lineChangeCallback(0); // Notify line change
+    // Stops new I/O and tasks for a while
+    void backOff(std::chrono::milliseconds duration) {
+        auto until = std::chrono::steady_clock::now() + duration;
+        int64_t ticks = until.time_since_epoch().count();
+        int64_t current = backOffUntil.load();
+        while (current < ticks && !backOffUntil.compare_exchange_weak(current, ticks)) {}
+    }
 
-                        goTo(currentX, currentY);
-                    }
-                    else
-                    {
-                        goTo(--currentX, currentY);
-                        std::wcout << L' ' << L' ';  // Erase character
+    // Called before every file request of 'bytes'
+    void acquireIO(size_t bytes) {
+        waitWhileHeld();
+        ioBucket.acquire(bytes);
+    }
 
-                        goTo(currentX, currentY);
-                    }
-                }
-            }
-            else if (ch == L'\"') { // Skip quote characters
-                continue;
-            }
-            else {
-                if ((float)input.size() / lineCount >= maxLineLength) {
-                    // Move to the next line if the max length is reached
-                    lineCount++;
-                    currentX = startX;
-                    currentY++;
+    // Permission for a worker to run one task, held for the task's lifetime
+    // The idle time that keeps the worker's busy share at cpuShare is taken at the task's checkpoints;
+    // what the end of the task still owes is taken before the worker's next task, not after its last one.
+    class Turn {
+
+    public:
+        explicit Turn(Throttle& throttle) : throttle(throttle), previous(workerState().turn) {
+            // Waiting for this task already counts toward what the last one owed
+            WorkerState& state = workerState();
+            throttle.idle(state.owed - std::chrono::duration<double>(std::chrono::steady_clock::now() - state.idleSince).count());
+            state.owed = 0;
+            throttle.beginTurn();
+            start = std::chrono::steady_clock::now();
+            state.turn = this;
+        }
 
-                    if (lineChangeCallback) lineChangeCallback(1); // Notify line change
+        ~Turn() {
+            WorkerState& state = workerState();
+            state.turn = previous;
+            state.owed = throttle.endTurn(std::chrono::steady_clock::now() - start);
+            state.idleSince = std::chrono::steady_clock::now();
+        }
 
-                    goTo(currentX, currentY);
-                }
-                input += ch;
-                std::wcout << ch;
-
-                currentX++;
-            }
+        Turn(const Turn&) = delete;
+        Turn& operator=(const Turn&) = delete;
+
+        // Gives the turn up for a while when paused or once a slice of work owes idle time
+        void yield() {
+            const std::chrono::milliseconds slice(10); // Work between idle periods under a duty cycle
+            auto now = std::chrono::steady_clock::now();
+            if (!throttle.held() && !(throttle.dutyCycle && now - start >= slice)) return;
+            throttle.idle(throttle.endTurn(now - start));
+            throttle.beginTurn();
+            start = std::chrono::steady_clock::now();
         }
 
-        goTo(0, currentY + 2);  // Move cursor to a new line for subsequent output
+    private:
+        Throttle& throttle;
+        Turn* previous; // Turn of an enclosing task on the same thread
+        std::chrono::steady_clock::time_point start; // When the task last started or resumed running
+    };
 
-        return Utility::wstringToU32string(input); // Convert input to UTF-32 string
+    // Called from inside long loops (every few dozen KB of work) so a running task follows the duty cycle
+    // and pauses; does nothing outside a worker's turn
+    static void checkpoint() {
+        Turn* turn = workerState().turn;
+        if (turn) turn->yield();
     }
 
-    // Writes output to the console with support for line wrapping
-    // If maxLineLength is reached, wraps to the next line
-    // Optionally triggers a callback when the line changes
-    static std::u32string writeOutputStream(const std::u32string& text, int maxLineLength, std::function<void()> lineChangeCallback = nullptr) {
-        COORD initialPos = getCurrentCursorPosition();
-
-        int startX = initialPos.X;
-        int startY = initialPos.Y;
-        int currentX = startX;
-        int currentY = startY;
-
-        int lineCount = 1;
-
-        std::u32string output;
-        size_t pos = 0;
-        size_t textLength = text.length();
+#ifndef _WIN32
+    // SIGUSR1 pauses, SIGUSR2 resumes (the handlers only flip an atomic flag)
+    static void installSignalHandlers() {
+        std::signal(SIGUSR1, [](int) { pausedFlag() = true; });
+        std::signal(SIGUSR2, [](int) { pausedFlag() = false; });
+    }
+#endif
 
-        while (pos < textLength) {
-            wchar_t ch = text[pos++];
+private:
+    Throttle() {}
+
+    std::mutex mutex; // Guards options and running
+    std::condition_variable turnAvailable;
+    ThrottleOptions options;
+    int running = 0; // Workers inside a turn
+    std::atomic<bool> dutyCycle{ false }; // cpuShare is below 1, so turns owe idle time
+    TokenBucket ioBucket;
+    std::atomic<int64_t> backOffUntil{ 0 }; // steady_clock ticks until which work is held back
+
+    // Duty cycle bookkeeping of the calling thread
+    struct WorkerState {
+        Turn* turn = nullptr; // Turn the thread is running a task in, if any
+        double owed = 0; // Idle seconds the thread's last task still owes
+        std::chrono::steady_clock::time_point idleSince; // When that task ended
+    };
 
-            if ((float)output.length() / lineCount >= maxLineLength - 1) {
-                // Move to the next line if the max length is reached
-                lineCount++;
-                currentX = startX;
-                currentY++;
+    static WorkerState& workerState() {
+        static thread_local WorkerState state;
+        return state;
+    }
 
-                if (lineChangeCallback) lineChangeCallback(); // Notify line change
+    static std::atomic<bool>& pausedFlag() {
+        static std::atomic<bool> paused{ false };
+        return paused;
+    }
 
-                goTo(currentX, currentY);
-            }
+    bool held() const {
+        return pausedFlag() || std::chrono::steady_clock::now().time_since_epoch().count() < backOffUntil.load();
+    }
 
-            output += ch;
-            std::wcout << ch;
+    // Polls while paused: a signal handler cannot notify a condition variable
+    void waitWhileHeld() {
+        while (held()) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
 
-            currentX++;
+    void beginTurn() {
+        waitWhileHeld();
+        std::unique_lock<std::mutex> lock(mutex);
+        while (options.maxWorkers > 0 && running >= options.maxWorkers) {
+            turnAvailable.wait_for(lock, std::chrono::milliseconds(50));
         }
+        running++;
+    }
 
-        // Move cursor to a new line after writing the output
-        goTo(0, currentY + 2);
-
-        return output;
+    // Releases the worker's slot and returns the idle seconds that 'busy' owes under the duty cycle
+    double endTurn(std::chrono::steady_clock::duration busy) {
+        double share;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+            share = options.cpuShare;
+        }
+        turnAvailable.notify_one();
+        return share < 1.0 ? std::chrono::duration<double>(busy).count() * (1 - share) / share : 0;
     }
 
-    // Searches for a text string in the console buffer and returns its coordinates
-    // Returns {-1, -1} if the text is not found
-    static COORD findTextInConsole(const std::string& searchString) {
-        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-        CONSOLE_SCREEN_BUFFER_INFO csbi;
-        GetConsoleScreenBufferInfo(hConsole, &csbi);
+    void idle(double seconds) {
+        if (seconds > 0) std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    }
+};
 
-        int consoleWidth = csbi.dwSize.X;
-        int consoleHeight = csbi.dwSize.Y;
+// Page-aligned runs of zero bytes in data about to be written, which a sparse write leaves as holes
+// Disk images restore with whole regions of zeros; skipping them saves both the writes and the space.
+class ZeroRuns {
 
-        CHAR_INFO* buffer = new CHAR_INFO[consoleWidth * consoleHeight];
-        COORD bufferSize = { consoleWidth, consoleHeight };
-        COORD bufferCoord = { 0, 0 };
-        SMALL_RECT readRegion = { 0, 0, consoleWidth - 1, consoleHeight - 1 };
+public:
+    struct Run {
+        uint64_t offset; // File offset of the first zero byte, a multiple of page
+        uint64_t length; // Bytes in the run, a multiple of page
+    };
 
-        // Read the console screen buffer into the allocated buffer
-        if (ReadConsoleOutput(hConsole, buffer, bufferSize, bufferCoord, &readRegion)) {
-            // Search for the text in the console buffer
-            for (int y = 0; y < consoleHeight; ++y) {
-                for (int x = 0; x <= consoleWidth - searchString.size(); ++x) {
-                    bool match = true;
-                    for (size_t i = 0; i < searchString.size(); ++i) {
-                        if (buffer[y * consoleWidth + x + i].Char.AsciiChar != searchString[i]) {
-                            match = false;
-                            break;
-                        }
-                    }
-                    if (match) {
-                        delete[] buffer;
-                        return { static_cast<SHORT>(x + searchString.length()), static_cast<SHORT>(y) };
-                    }
-                }
+    static const size_t page = 4096; // Allocation unit of common file systems
+    static const size_t minimum = 64 * 1024; // Shortest run worth a hole
+
+    // Appends the runs of whole zero pages in 'size' bytes that go to file offset 'base'
+    // Runs shorter than minimum are kept only where they reach the first or last whole page,
+    // since they may join a run of the neighbouring data in merge.
+    static void find(const uint8_t* data, size_t size, uint64_t base, std::vector<Run>& runs) {
+        size_t first = static_cast<size_t>((page - base % page) % page); // First page boundary inside data
+        if (first >= size) return;
+        size_t last = first + (size - first) / page * page; // End of the last whole page
+        size_t start = last;
+        for (size_t offset = first; offset < last; offset += page) {
+            if (isZero(data + offset)) {
+                if (start == last) start = offset;
+            }
+            else if (start != last) {
+                add(runs, base, start, offset, first, last);
+                start = last;
             }
         }
-
-        delete[] buffer;
-
-        // Return {-1, -1} if text is not found
-        return { -1, -1 };
+        if (start != last) add(runs, base, start, last, first, last);
     }
 
-    // Pauses execution and waits for user input before exiting
-    // Moves the cursor to a position below the last character
-    static void pause() {
-        COORD lastChar = Cursor::getLastConsoleChar();
-        Cursor::goTo(0, lastChar.Y + 2);
+    // Sorts runs found piece by piece, joins those that meet and drops those still shorter than minimum
+    // Pieces that do not start on a page boundary leave the page they share with their neighbour
+    // unchecked; it is looked up in 'data', the whole output, when runs lie on both sides of it.
+    static void merge(std::vector<Run>& runs, const uint8_t* data) {
+        std::sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) { return a.offset < b.offset; });
+        std::vector<Run> merged;
+        for (const Run& run : runs) {
+            uint64_t end = merged.empty() ? 0 : merged.back().offset + merged.back().length;
+            if (!merged.empty() && (end == run.offset || (end + page == run.offset && isZero(data + end)))) merged.back().length = run.offset + run.length - merged.back().offset;
+            else merged.push_back(run);
+        }
+        merged.erase(std::remove_if(merged.begin(), merged.end(), [](const Run& run) { return run.length < minimum; }), merged.end());
+        runs.swap(merged);
+    }
 
-        system("pause");  // Wait for user input
+    // Bytes covered by 'runs'
+    static uint64_t total(const std::vector<Run>& runs) {
+        uint64_t bytes = 0;
+        for (const Run& run : runs) bytes += run.length;
+        return bytes;
     }
 
 private:
-    // Retrieves the current cursor position
-    static COORD getCurrentCursorPosition() {
-        CONSOLE_SCREEN_BUFFER_INFO csbi;
-        GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
+    // Whether a page holds only zeros; the OR of words vectorizes
+    static bool isZero(const uint8_t* data) {
+        uint64_t word[page / 8];
+        std::memcpy(word, data, page);
+        uint64_t any = 0;
+        for (size_t i = 0; i < page / 8; ++i) any |= word[i];
+        return any == 0;
+    }
 
-        return csbi.dwCursorPosition;
+    static void add(std::vector<Run>& runs, uint64_t base, size_t start, size_t end, size_t first, size_t last) {
+        if (end - start >= minimum || start == first || end == last) runs.push_back({ base + start, end - start });
     }
 };
 
-// Class for packing and unpacking vector data into a bit-packed format
-class Bitpacker {
+#ifndef _WIN32
+// Owns a POSIX file descriptor
+class FileDescriptor {
 
 public:
-    // Packs 'nin' integers from the 'input' vector into a bit-packed format and stores it in the 'output' vector.
-    // 'n' specifies the number of bits used to represent each integer.
-    // Returns the total number of bits written to the 'output' vector.
-    static int pack(const std::vector<int>& input, std::vector<uint8_t>& output, int n) {
-        int nin = input.size(); // Number of integers to pack
-        int64_t inmask = 0; // Mask to isolate bits from the input integers
-        int obit = 0; // Bit position in the current byte of the output vector
-        int nout = 0; // Total number of bits written to the output vector
+    explicit FileDescriptor(int fd) : fd(fd) {}
+    ~FileDescriptor() { if (fd >= 0) close(fd); }
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    int get() const { return fd; }
+
+    // Opens a file, retrying without O_DIRECT when the file system refuses it
+    static int open(const std::string& path, int flags, bool& direct) {
+#ifdef O_DIRECT
+        if (direct) {
+            int fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            if (fd >= 0 || errno != EINVAL) return fd;
+        }
+#endif
+        direct = false;
+        return ::open(path.c_str(), flags, 0644);
+    }
 
-        // Calculate the maximum number of bytes needed to store the packed data
-        int maxBytes = (nin * n + 7) / 8;
-        output.resize(maxBytes); // Resize the output vector to fit the packed data
-        memset(output.data(), 0, maxBytes); // Initialize the output buffer to zero
+private:
+    int fd;
+};
+#endif
 
-        // Iterate through each integer in the input vector
-        for (int i = 0; i < nin; i++) {
-            inmask = (int64_t)1 << (n - 1); // Initialize mask for the current integer
+// Interface for the file reads and writes done by Utility and Archive
+class IOBackend {
 
-            // Extract bits from the current integer and store them in the output vector
-            for (int k = 0; k < n; k++) {
-                output[nout / 8] |= (((input[i] & inmask) >> (n - k - 1)) << (7 - obit));
-                inmask >>= 1;
-                obit++;
-                nout++;
+public:
+#ifdef _WIN32
+    using NativePath = std::wstring;
+#else
+    using NativePath = std::string;
+#endif
 
-                // If a byte is fully filled, reset the bit position
-                if (obit == 8) {
-                    obit = 0;
-                }
-            }
-        }
-        return nout; // Return the total number of bits packed
-    }
+    virtual ~IOBackend() {}
 
-    // Unpacks 'nbitsin' bits from the 'input' vector and stores the resulting integers in the 'output' vector.
-    // 'n' specifies the number of bits used to represent each integer.
-    // Returns the number of integers written to the 'output' vector.
-    static int unpack(const std::vector<uint8_t>& input, int nbitsin, std::vector<int>& output, int n) {
-        int inbit = 0; // Bit position in the current byte of the input vector
-        int nout = 0; // Total number of bits processed
-        int numInts = nbitsin / n; // Number of integers to unpack
-        output.resize(numInts); // Resize the output vector to fit the unpacked integers
+    // Reads a whole file into 'data'
+    virtual void readFile(const std::u32string& filename, std::vector<uint8_t>& data) = 0;
 
-        // Iterate through each integer to be unpacked
-        for (int i = 0; i < numInts; i++) {
-            int64_t value = 0; // Temporary variable to accumulate the unpacked integer value
+    // Replaces the contents of a file with 'data'
+    virtual void writeFile(const std::u32string& filename, const std::vector<uint8_t>& data) = 0;
 
-            // Extract bits from the input vector to form the integer
-            for (int j = 0; j < n; j++) {
-                if (inbit == 8) { // Move to the next byte if needed
-                    inbit = 0;
-                }
-                int bit = (input[nout / 8] >> (7 - inbit)) & 1;
-                value = (value << 1) | bit;
-                inbit++;
-                nout++;
-            }
-            output[i] = static_cast<int>(value); // Store the unpacked integer in the output vector
+    // Short name of the backend for diagnostics
+    virtual const char* name() const = 0;
+
+    // Size of a file in bytes
+    virtual uint64_t fileSize(const std::u32string& filename) {
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (!GetFileAttributesExW(toNativePath(filename).c_str(), GetFileExInfoStandard, &attributes)) {
+            throw std::runtime_error("Error opening file for reading.");
         }
-        return numInts; // Return the number of integers unpacked
+        return (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+#else
+        struct stat status;
+        if (stat(toNativePath(filename).c_str(), &status) != 0) {
+            throw std::runtime_error("Error opening file for reading.");
+        }
+        return static_cast<uint64_t>(status.st_size);
+#endif
     }
 
-    // Converts an integer value to a vector of uint8_t with a specified number of bytes.
-    static std::vector<uint8_t> intToBytes(int value, size_t n) {
-        std::vector<uint8_t> bytes(n);
-        // Copy the bytes of the integer into the vector
-        std::memcpy(bytes.data(), &value, sizeof(value) < n ? sizeof(value) : n);
-        return bytes;
-    }
+    // Reads 'length' bytes starting at 'offset'
+    virtual void readRange(const std::u32string& filename, uint64_t offset, size_t length, std::vector<uint8_t>& data) {
+        std::ifstream file(toNativePath(filename), std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Error opening file for reading.");
+        }
 
-    // Converts a vector of uint8_t back into an integer.
-    static int bytesToInt(const std::vector<uint8_t>& bytes) {
-        int value = 0;
-        // Copy the bytes from the vector into the integer
-        std::memcpy(&value, bytes.data(), sizeof(value) < bytes.size() ? sizeof(value) : bytes.size());
-        return value;
+        pace(length);
+        data.resize(length);
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(length));
+        if (file.gcount() != static_cast<std::streamsize>(length)) {
+            throw std::runtime_error("Error reading file.");
+        }
     }
-};
-
-// Lempel-Ziv-Welch algorithm
-class LZW {
-    // Type definition for a progress callback function
-    using ProgressCallback = std::function<void(double)>;
 
-public:
-    static std::vector<uint8_t> encode(std::vector<uint8_t>& input, ProgressCallback progressCallback = nullptr) {
-        // Dictionary initialization with std::unordered_map
-        std::unordered_map<std::vector<uint8_t>, int32_t, VectorHash> dictionary;
-        int32_t dictSize = 256; // Standard dictionary size for single-byte values
-        for (int i = 0; i < dictSize; ++i) {
-            dictionary[{static_cast<uint8_t>(i)}] = i;
+    // Writes 'data' at 'offset', cuts the file off right after it and flushes it to stable storage
+    // Bytes before 'offset' are never touched, which is what makes archive appends crash-safe.
+    virtual void writeAt(const std::u32string& filename, uint64_t offset, const std::vector<uint8_t>& data) {
+        pace(data.size());
+        NativePath path = toNativePath(filename);
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Error opening file for writing.");
         }
 
-        std::vector<int32_t> codes;
-        std::vector<uint8_t> currentSeq;
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(offset);
+        bool ok = SetFilePointerEx(file, position, nullptr, FILE_BEGIN) != 0;
+        size_t written = 0;
+        while (ok && written < data.size()) {
+            DWORD chunk = static_cast<DWORD>(data.size() - written < (1u << 30) ? data.size() - written : (1u << 30));
+            DWORD done = 0;
+            ok = WriteFile(file, data.data() + written, chunk, &done, nullptr) != 0;
+            written += done;
+        }
+        ok = ok && SetEndOfFile(file) && FlushFileBuffers(file);
+        CloseHandle(file);
+#else
+        FileDescriptor file(::open(path.c_str(), O_WRONLY | O_CREAT, 0644));
+        bool ok = file.get() >= 0;
+        size_t written = 0;
+        while (ok && written < data.size()) {
+            ssize_t done = pwrite(file.get(), data.data() + written, data.size() - written, static_cast<off_t>(offset + written));
+            if (done < 0 && errno == EINTR) continue;
+            ok = done > 0;
+            if (ok) written += static_cast<size_t>(done);
+        }
+        ok = ok && ftruncate(file.get(), static_cast<off_t>(offset + data.size())) == 0 && fsync(file.get()) == 0;
+#endif
+        if (!ok) {
+            throw std::runtime_error("Error writing file.");
+        }
+    }
 
-        int32_t i = 0;
-        // Calculate interval for progress updates (1/6 of input length)
-        int32_t interval = (input.size() / 3);
+    // Replaces the contents of a file with 'data', leaving the 'holes' (sorted, from ZeroRuns) unwritten
+    // The file is created empty and only the extents between holes are written, so the holes stay
+    // unallocated and read back as zeros. Where the file system has no sparse files they are
+    // allocated as zeros, which still reads back the same.
+    virtual void writeSparseFile(const std::u32string& filename, const std::vector<uint8_t>& data, const std::vector<ZeroRuns::Run>& holes) {
+        if (holes.empty()) {
+            writeFile(filename, data);
+            return;
+        }
+        NativePath path = toNativePath(filename);
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Error opening file for writing.");
+        }
 
-        for (uint8_t byte : input) {
-            currentSeq.push_back(byte);
-            if (dictionary.find(currentSeq) == dictionary.end()) {
-                // Add the sequence to the dictionary
-                std::vector<uint8_t> seq = currentSeq;
-                seq.pop_back();
-                int32_t code = dictionary[seq];
-                codes.push_back(code);
-                dictionary[currentSeq] = dictSize++;
-                currentSeq = { byte };
+        DWORD returned = 0;
+        DeviceIoControl(file, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr); // Refused on FAT, which then allocates the holes
+        bool ok = true;
+        auto writeExtent = [&](uint64_t from, uint64_t to) {
+            pace(static_cast<size_t>(to - from));
+            LARGE_INTEGER position;
+            position.QuadPart = static_cast<LONGLONG>(from);
+            ok = ok && SetFilePointerEx(file, position, nullptr, FILE_BEGIN) != 0;
+            while (ok && from < to) {
+                DWORD chunk = static_cast<DWORD>(to - from < (1u << 30) ? to - from : (1u << 30));
+                DWORD done = 0;
+                ok = WriteFile(file, data.data() + from, chunk, &done, nullptr) != 0;
+                from += done;
             }
-            i++;
-
-            // Report progress periodically (every 1/3 of input length)
-            if (progressCallback && input.size() >= 3 && i % interval == 0) {
-                progressCallback(static_cast<double>(i) / input.size() * .81); // Report progress 
+        };
+#else
+        FileDescriptor file(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+        bool ok = file.get() >= 0;
+        auto writeExtent = [&](uint64_t from, uint64_t to) {
+            pace(static_cast<size_t>(to - from));
+            while (ok && from < to) {
+                ssize_t done = pwrite(file.get(), data.data() + from, static_cast<size_t>(to - from), static_cast<off_t>(from));
+                if (done < 0 && errno == EINTR) continue;
+                ok = done > 0;
+                if (ok) from += static_cast<uint64_t>(done);
             }
+        };
+#endif
+        uint64_t position = 0;
+        for (const ZeroRuns::Run& hole : holes) {
+            writeExtent(position, hole.offset);
+            position = hole.offset + hole.length;
         }
+        writeExtent(position, data.size());
+
+        // A hole at the end is made by setting the size, as no write reaches it
+#ifdef _WIN32
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(data.size());
+        ok = ok && SetFilePointerEx(file, end, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+        CloseHandle(file);
+#else
+        ok = ok && ftruncate(file.get(), static_cast<off_t>(data.size())) == 0;
+#endif
+        if (!ok) {
+            throw std::runtime_error("Error writing file.");
+        }
+    }
 
-        // Output the last sequence
-        if (!currentSeq.empty()) {
-            codes.push_back(dictionary[currentSeq]);
+    // Creates a directory, succeeding when it already exists
+    virtual void createDirectory(const std::u32string& directory) {
+#ifdef _WIN32
+        bool ok = CreateDirectoryW(toNativePath(directory).c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+        bool ok = mkdir(toNativePath(directory).c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+        if (!ok) {
+            throw std::runtime_error("Error creating directory.");
         }
+    }
 
-        uint8_t bitWidth = std::ceil(std::log2(dictSize));
+    // Deletes a file, returning false when it could not be deleted
+    virtual bool removeFile(const std::u32string& filename) {
+#ifdef _WIN32
+        return DeleteFileW(toNativePath(filename).c_str()) != 0;
+#else
+        return unlink(toNativePath(filename).c_str()) == 0;
+#endif
+    }
 
-        // Compress the output codes and append metadata
-        std::vector<uint8_t> compressedVec;
-        int nbits = Bitpacker::pack(codes, compressedVec, bitWidth);
+    // Renames a file, replacing the target atomically when it exists
+    virtual void renameFile(const std::u32string& from, const std::u32string& to) {
+#ifdef _WIN32
+        bool ok = MoveFileExW(toNativePath(from).c_str(), toNativePath(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        bool ok = rename(toNativePath(from).c_str(), toNativePath(to).c_str()) == 0;
+#endif
+        if (!ok) {
+            throw std::runtime_error("Error renaming file.");
+        }
+    }
 
-        // Convert the number of bits used for packing into 4 bytes and append
-        std::vector<uint8_t> nbitsVec = Bitpacker::intToBytes(nbits, 4);
-        Utility::appendVector(compressedVec, nbitsVec);
+    // Returns the backend used by Utility, creating the best available one on first use
+    static IOBackend& getInstance() {
+        std::lock_guard<std::mutex> lock(instanceMutex);
+        if (!instance) instance = create(IOOptions());
+        return *instance;
+    }
 
-        // Append the bit-width used for encoding
-        compressedVec.push_back(bitWidth);
+    // Replaces the backend used by Utility
+    static void setInstance(std::unique_ptr<IOBackend> backend) {
+        std::lock_guard<std::mutex> lock(instanceMutex);
+        instance = std::move(backend);
+    }
 
-        if (progressCallback) progressCallback(1.0); // Report progress
+    // Creates the fastest backend the platform supports, falling back to simpler ones
+    static std::unique_ptr<IOBackend> create(const IOOptions& options);
 
-        return compressedVec;
+protected:
+    // Waits until the throttle lets a request of 'bytes' through
+    static void pace(size_t bytes) {
+        Throttle::getInstance().acquireIO(bytes);
     }
 
-    static std::vector<uint8_t> decode(std::vector<uint8_t>& compressed, ProgressCallback progressCallback = nullptr) {
-        // Extract bit-width from the end
-        int bitWidth = static_cast<int>(compressed.back());
-        // Extract number of bits used for packing
-        std::vector<uint8_t> nbitsVec = Utility::extractSubVector(compressed, compressed.size() - 5, 4);
-        int nbits = Bitpacker::bytesToInt(nbitsVec);
+    // Converts a UTF-32 path to the form expected by the operating system
+    static NativePath toNativePath(const std::u32string& filename) {
+#ifdef _WIN32
+        return Utility::u32stringToWstring(filename);
+#else
+        return Utility::u32stringToString(filename);
+#endif
+    }
 
-        // Resize to remove the metadata
-        compressed.resize(compressed.size() - 5);
+private:
+    static std::unique_ptr<IOBackend> instance; // Backend used by Utility
+    static std::mutex instanceMutex; // Guards replacement of the backend
+};
+// Static member definitions
+std::unique_ptr<IOBackend> IOBackend::instance; // Created lazily by getInstance
+std::mutex IOBackend::instanceMutex; // Definition of the mutex guarding the instance
 
-        // Unpack the compressed data into a vector of codes
-        std::vector<int32_t> unpackedVec;
-        Bitpacker::unpack(compressed, nbits, unpackedVec, bitWidth);
+// Blocking std::fstream backend, reading and writing a file in one call
+class StreamIOBackend : public IOBackend {
 
-        // Dictionary initialization with std::map
-        std::unordered_map<int32_t, std::vector<uint8_t>> dictionary;
-        int32_t dictSize = 256; // Standard dictionary size for single-byte values
-        for (int i = 0; i < dictSize; ++i) {
-            dictionary[i] = { static_cast<uint8_t>(i) };
+public:
+    void readFile(const std::u32string& filename, std::vector<uint8_t>& data) override {
+        std::ifstream file(toNativePath(filename), std::ios::binary | std::ios::ate); // Open file and seek to the end
+        if (!file) {
+            throw std::runtime_error("Error opening file for reading.");
         }
 
-        std::vector<uint8_t> output;
-        std::vector<uint8_t> currentSeq;
-        int32_t oldCode = unpackedVec[0];
-        output.insert(output.end(), dictionary[oldCode].begin(), dictionary[oldCode].end());
-        currentSeq = dictionary[oldCode];
+        // Get the size of the file
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg); // Move back to the beginning of the file
 
-        // Calculate interval for progress updates (1/6 of input length)
-        int32_t interval = (unpackedVec.size() / 3);
-        for (size_t i = 1; i < unpackedVec.size(); ++i) {
-            int32_t code = unpackedVec[i];
-            std::vector<uint8_t> entry;
+        // Resize the vector to accommodate the data
+        data.resize(static_cast<size_t>(size));
 
-            if (dictionary.find(code) != dictionary.end()) {
-                entry = dictionary[code];
-            }
-            else if (code == dictSize) {
-                entry = currentSeq;
-                entry.push_back(currentSeq[0]);
-            }
-            else {
-                throw std::runtime_error("Bad compressed code.");
-            }
+        // Read the vector data from the file, one request at a time so the throttle can pace it
+        for (std::streamsize offset = 0; offset < size; offset += requestSize) {
+            std::streamsize length = size - offset < requestSize ? size - offset : requestSize;
+            pace(static_cast<size_t>(length));
+            file.read(reinterpret_cast<char*>(data.data()) + offset, length);
+        }
 
-            output.insert(output.end(), entry.begin(), entry.end());
+        file.close();
+    }
 
-            // Add new sequence to dictionary
-            currentSeq.push_back(entry[0]);
-            dictionary[dictSize++] = currentSeq;
-            currentSeq = entry;
+    void writeFile(const std::u32string& filename, const std::vector<uint8_t>& data) override {
+        std::ofstream file(toNativePath(filename), std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Error opening file for writing.");
+        }
 
-            // Report progress periodically (every 1/3 of input length)
-            if (progressCallback && unpackedVec.size() >= 3 && i % interval == 0) {
-                progressCallback(static_cast<double>(i) / unpackedVec.size() * 1); // Report progress 
-            }
+        // Write the vector data to the file, one request at a time so the throttle can pace it
+        std::streamsize size = static_cast<std::streamsize>(data.size());
+        for (std::streamsize offset = 0; offset < size; offset += requestSize) {
+            std::streamsize length = size - offset < requestSize ? size - offset : requestSize;
+            pace(static_cast<size_t>(length));
+            file.write(reinterpret_cast<const char*>(data.data()) + offset, length);
         }
 
-        if (progressCallback) progressCallback(1.0); // Report progress
+        file.close();
+    }
 
-        return output;
+    const char* name() const override {
+        return "stream";
     }
 
 private:
-    // Custom hash function for std::vector<uint8_t>
-    struct VectorHash {
-        std::size_t operator()(const std::vector<uint8_t>& vec) const {
-            std::size_t seed = vec.size();
-            for (const auto& i : vec) {
-                seed ^= static_cast<std::size_t>(i) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-            }
-            return seed;
-        }
-    };
+    static const std::streamsize requestSize = 1 << 20; // Bytes per read or write call
 };
 
-// Class to manage thread-safe access to shared resources using a mutex lock
-class SharedResource {
+#ifdef _WIN32
+// Overlapped (asynchronous) Win32 file I/O keeping several block requests in flight
+// With directIO the file is opened with FILE_FLAG_NO_BUFFERING and data moves through aligned bounce buffers
+class OverlappedIOBackend : public IOBackend {
 
 public:
-    // Outputs a message to the console at a specific position
-    // Ensures that multiple threads do not write to the console simultaneously
-    // by acquiring a mutex lock before printing.
-    // This prevents interleaved or garbled output from concurrent threads.
-    // 
-    // Parameters:
-    // - message: The string message to be printed.
-    // - position: The console coordinates where the message will be displayed.
-    static void printMessage(const std::string& message, COORD position) {
-        // Lock the mutex to ensure exclusive access to the console output
-        std::lock_guard<std::mutex> guard(mutex_);
-        Cursor::goTo(position.X, position.Y); // Move cursor to the specified position
-        std::cout << message; // Print the message to the console
+    explicit OverlappedIOBackend(const IOOptions& options = IOOptions()) : options(options) {}
+
+    void readFile(const std::u32string& filename, std::vector<uint8_t>& data) override {
+        bool direct = false;
+        HANDLE file = open(filename, GENERIC_READ, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, direct);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Error opening file for reading.");
+        }
+
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        data.resize(static_cast<size_t>(fileSize.QuadPart));
+
+        transfer(file, data.data(), data.size(), false, direct);
+        CloseHandle(file);
+    }
+
+    void writeFile(const std::u32string& filename, const std::vector<uint8_t>& data) override {
+        bool direct = false;
+        HANDLE file = open(filename, GENERIC_WRITE, CREATE_ALWAYS, 0, direct);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Error opening file for writing.");
+        }
+
+        transfer(file, const_cast<uint8_t*>(data.data()), data.size(), true, direct);
+
+        // Direct writes are padded to whole sectors, so cut the file back to its real size
+        if (direct) {
+            FILE_END_OF_FILE_INFO endOfFile;
+            endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(data.size());
+            SetFileInformationByHandle(file, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+        }
+        CloseHandle(file);
+    }
+
+    const char* name() const override {
+        return options.directIO ? "overlapped-direct" : "overlapped";
+    }
+
+private:
+    IOOptions options;
+
+    // Opens a file for overlapped access, dropping FILE_FLAG_NO_BUFFERING if the volume refuses it;
+    // 'direct' tells whether this handle ended up unbuffered, other files still try direct I/O
+    HANDLE open(const std::u32string& filename, DWORD access, DWORD disposition, DWORD flags, bool& direct) const {
+        NativePath path = toNativePath(filename);
+        DWORD share = access == GENERIC_READ ? FILE_SHARE_READ : 0;
+        flags |= FILE_FLAG_OVERLAPPED;
+
+        HANDLE file = CreateFileW(path.c_str(), access, share, nullptr, disposition,
+            flags | (options.directIO ? FILE_FLAG_NO_BUFFERING : 0), nullptr);
+        direct = options.directIO && file != INVALID_HANDLE_VALUE;
+        if (file == INVALID_HANDLE_VALUE && options.directIO) {
+            file = CreateFileW(path.c_str(), access, share, nullptr, disposition, flags, nullptr);
+        }
+        return file;
+    }
+
+    // Moves 'size' bytes between 'data' and the file with up to queueDepth requests in flight
+    void transfer(HANDLE file, uint8_t* data, size_t size, bool write, bool direct) {
+        const size_t requestSize = direct ? AlignedBuffer::roundUp(options.requestSize) : options.requestSize;
+        const int depth = options.queueDepth > 0 ? options.queueDepth : 1;
+
+        std::unique_ptr<AlignedBuffer> bounce;
+        if (direct) bounce.reset(new AlignedBuffer(requestSize * depth));
+
+        std::vector<OVERLAPPED> requests(depth);
+        std::vector<HANDLE> events(depth);
+        std::vector<size_t> offsets(depth);
+        for (auto& event : events) event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+        std::deque<int> inFlight; // Requests complete in submission order
+        size_t nextOffset = 0;
+        std::string error;
+
+        while (error.empty() && (nextOffset < size || !inFlight.empty())) {
+            // Keep the queue full
+            while (error.empty() && nextOffset < size && static_cast<int>(inFlight.size()) < depth) {
+                int slot = static_cast<int>((nextOffset / requestSize) % depth);
+                size_t length = size - nextOffset < requestSize ? size - nextOffset : requestSize;
+                uint8_t* buffer = data + nextOffset;
+                DWORD requestLength = static_cast<DWORD>(length);
+
+                if (bounce) {
+                    buffer = bounce->data() + slot * requestSize;
+                    requestLength = static_cast<DWORD>(AlignedBuffer::roundUp(length));
+                    if (write) {
+                        memcpy(buffer, data + nextOffset, length);
+                        memset(buffer + length, 0, requestLength - length);
+                    }
+                }
+
+                pace(length);
+                OVERLAPPED& request = requests[slot];
+                memset(&request, 0, sizeof(request));
+                request.Offset = static_cast<DWORD>(nextOffset);
+                request.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(nextOffset) >> 32);
+                request.hEvent = events[slot];
+                offsets[slot] = nextOffset;
+
+                BOOL started = write ? WriteFile(file, buffer, requestLength, nullptr, &request)
+                                     : ReadFile(file, buffer, requestLength, nullptr, &request);
+                if (!started && GetLastError() != ERROR_IO_PENDING) {
+                    error = write ? "Error writing file." : "Error reading file.";
+                    break;
+                }
+
+                inFlight.push_back(slot);
+                nextOffset += length;
+            }
+
+            if (inFlight.empty()) break;
+
+            // Wait for the oldest request and copy it out of its bounce buffer
+            int slot = inFlight.front();
+            inFlight.pop_front();
+            DWORD transferred = 0;
+            if (!GetOverlappedResult(file, &requests[slot], &transferred, TRUE)) {
+                error = write ? "Error writing file." : "Error reading file.";
+                continue;
+            }
+            if (bounce && !write) {
+                size_t length = size - offsets[slot] < requestSize ? size - offsets[slot] : requestSize;
+                memcpy(data + offsets[slot], bounce->data() + slot * requestSize, length);
+            }
+        }
+
+        // Drain whatever is still pending before the buffers go away
+        for (int slot : inFlight) {
+            DWORD transferred = 0;
+            GetOverlappedResult(file, &requests[slot], &transferred, TRUE);
+        }
+        for (auto& event : events) CloseHandle(event);
+
+        if (!error.empty()) {
+            CloseHandle(file);
+            throw std::runtime_error(error);
+        }
+    }
+};
+#else
+// Blocking pread/pwrite backend, used where io_uring is unavailable
+class PositionalIOBackend : public IOBackend {
+
+public:
+    explicit PositionalIOBackend(const IOOptions& options = IOOptions()) : options(options) {}
+
+    void readFile(const std::u32string& filename, std::vector<uint8_t>& data) override {
+        bool direct = options.directIO;
+        FileDescriptor file(FileDescriptor::open(toNativePath(filename), O_RDONLY, direct));
+        struct stat status;
+        if (file.get() < 0 || fstat(file.get(), &status) != 0) {
+            throw std::runtime_error("Error opening file for reading.");
+        }
+
+        data.resize(static_cast<size_t>(status.st_size));
+        transfer(file.get(), data.data(), data.size(), false, direct);
+    }
+
+    void writeFile(const std::u32string& filename, const std::vector<uint8_t>& data) override {
+        bool direct = options.directIO;
+        FileDescriptor file(FileDescriptor::open(toNativePath(filename), O_WRONLY | O_CREAT | O_TRUNC, direct));
+        if (file.get() < 0) {
+            throw std::runtime_error("Error opening file for writing.");
+        }
+
+        transfer(file.get(), const_cast<uint8_t*>(data.data()), data.size(), true, direct);
+        if (direct && ftruncate(file.get(), static_cast<off_t>(data.size())) != 0) {
+            throw std::runtime_error("Error writing file.");
+        }
+    }
+
+    const char* name() const override {
+        return "pread";
+    }
+
+private:
+    IOOptions options;
+
+    // Moves 'size' bytes between 'data' and the file one request at a time
+    void transfer(int fd, uint8_t* data, size_t size, bool write, bool direct) {
+        const size_t requestSize = direct ? AlignedBuffer::roundUp(options.requestSize) : options.requestSize;
+        std::unique_ptr<AlignedBuffer> bounce;
+        if (direct) bounce.reset(new AlignedBuffer(requestSize));
+
+        size_t offset = 0;
+        while (offset < size) {
+            size_t length = size - offset < requestSize ? size - offset : requestSize;
+            uint8_t* buffer = bounce ? bounce->data() : data + offset;
+            size_t requestLength = bounce ? AlignedBuffer::roundUp(length) : length;
+
+            if (write && bounce) {
+                memcpy(buffer, data + offset, length);
+                memset(buffer + length, 0, requestLength - length);
+            }
+
+            pace(length);
+            ssize_t done = write ? pwrite(fd, buffer, requestLength, static_cast<off_t>(offset))
+                                 : pread(fd, buffer, requestLength, static_cast<off_t>(offset));
+            if (done <= 0) {
+                if (done < 0 && errno == EINTR) continue;
+                throw std::runtime_error(write ? "Error writing file." : "Error reading file.");
+            }
+
+            size_t useful = static_cast<size_t>(done) < length ? static_cast<size_t>(done) : length;
+            if (!write && bounce) memcpy(data + offset, buffer, useful);
+            offset += useful;
+        }
+    }
+};
+
+#ifdef __linux__
+// Minimal io_uring ring driven through the raw system calls (no liburing dependency)
+class IoUring {
+
+public:
+    explicit IoUring(unsigned entries) : ringFd(-1), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqes(MAP_FAILED), sqRingSize(0), cqRingSize(0), sqesSize(0) {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) {
+            throw std::runtime_error("io_uring is not available.");
+        }
+
+        // Map the submission queue, completion queue and submission entries
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) sqRingSize = cqRingSize = (sqRingSize > cqRingSize ? sqRingSize : cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        cqRing = singleMap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+            release();
+            throw std::runtime_error("io_uring is not available.");
+        }
+
+        uint8_t* sq = static_cast<uint8_t*>(sqRing);
+        uint8_t* cq = static_cast<uint8_t*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUring() {
+        release();
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Registers one buffer for READ_FIXED/WRITE_FIXED; returns false if the kernel refuses (e.g. memlock limit)
+    bool registerBuffer(void* buffer, size_t size) {
+        struct iovec vector = { buffer, size };
+        return syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, &vector, 1) == 0;
+    }
+
+    // Queues a read or write of 'length' bytes at 'offset'; 'fixed' selects the registered buffer
+    void prepare(int fd, bool write, bool fixed, void* buffer, unsigned length, uint64_t offset, uint64_t userData) {
+        unsigned tail = *sqTail;
+        unsigned index = tail & sqMask;
+        struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes) + index;
+        memset(sqe, 0, sizeof(*sqe));
+
+        if (fixed) {
+            sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->addr = reinterpret_cast<uint64_t>(buffer);
+            sqe->len = length;
+            sqe->buf_index = 0;
+        }
+        else {
+            // Vectored ops predate the fixed ones, the iovec must live until completion
+            iovecs[userData] = { buffer, length };
+            sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe->addr = reinterpret_cast<uint64_t>(&iovecs[userData]);
+            sqe->len = 1;
+        }
+        sqe->fd = fd;
+        sqe->off = offset;
+        sqe->user_data = userData;
+
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        pendingSubmissions++;
+    }
+
+    // Submits queued requests and waits for at least one completion
+    void submitAndWait() {
+        while (true) {
+            long result = syscall(__NR_io_uring_enter, ringFd, pendingSubmissions, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (result >= 0) break;
+            if (errno != EINTR) throw std::runtime_error("io_uring submission failed.");
+        }
+        pendingSubmissions = 0;
+    }
+
+    // Pops one completion if available
+    bool popCompletion(uint64_t& userData, int& result) {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+
+        struct io_uring_cqe* cqe = &cqes[head & cqMask];
+        userData = cqe->user_data;
+        result = cqe->res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Sizes the iovec table used by non-fixed requests
+    void reserveSlots(size_t slots) {
+        iovecs.resize(slots);
+    }
+
+private:
+    int ringFd;
+    void* sqRing;
+    void* cqRing;
+    void* sqes;
+    size_t sqRingSize, cqRingSize, sqesSize;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    struct io_uring_cqe* cqes = nullptr;
+    unsigned pendingSubmissions = 0;
+    std::vector<struct iovec> iovecs;
+
+    void release() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+    }
+};
+
+// io_uring backend keeping queueDepth block requests in flight through one registered buffer
+class UringIOBackend : public IOBackend {
+
+public:
+    explicit UringIOBackend(const IOOptions& options = IOOptions())
+        : options(options),
+          requestSize(AlignedBuffer::roundUp(options.requestSize)),
+          depth(options.queueDepth > 0 ? options.queueDepth : 1),
+          ring(static_cast<unsigned>(depth)),
+          buffers(requestSize * depth),
+          slotOffsets(depth),
+          slotLengths(depth) {
+        registered = ring.registerBuffer(buffers.data(), buffers.size());
+        ring.reserveSlots(depth);
+    }
+
+    void readFile(const std::u32string& filename, std::vector<uint8_t>& data) override {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        bool direct = options.directIO;
+        FileDescriptor file(FileDescriptor::open(toNativePath(filename), O_RDONLY, direct));
+        struct stat status;
+        if (file.get() < 0 || fstat(file.get(), &status) != 0) {
+            throw std::runtime_error("Error opening file for reading.");
+        }
+
+        data.resize(static_cast<size_t>(status.st_size));
+        transfer(file.get(), data.data(), data.size(), false, direct);
+    }
+
+    void writeFile(const std::u32string& filename, const std::vector<uint8_t>& data) override {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        bool direct = options.directIO;
+        FileDescriptor file(FileDescriptor::open(toNativePath(filename), O_WRONLY | O_CREAT | O_TRUNC, direct));
+        if (file.get() < 0) {
+            throw std::runtime_error("Error opening file for writing.");
+        }
+
+        transfer(file.get(), const_cast<uint8_t*>(data.data()), data.size(), true, direct);
+        if (direct && ftruncate(file.get(), static_cast<off_t>(data.size())) != 0) {
+            throw std::runtime_error("Error writing file.");
+        }
+    }
+
+    const char* name() const override {
+        return registered ? "io_uring-fixed" : "io_uring";
+    }
+
+private:
+    IOOptions options;
+    size_t requestSize; // Aligned size of one request
+    int depth; // Requests kept in flight
+    IoUring ring;
+    AlignedBuffer buffers; // One slot of requestSize bytes per request
+    bool registered; // Whether 'buffers' is registered with the ring
+    std::vector<size_t> slotOffsets; // File offset of the request in each slot
+    std::vector<size_t> slotLengths; // Remaining length of the request in each slot
+    std::mutex ringMutex; // The ring is used by one transfer at a time
+
+    // Moves 'size' bytes between 'data' and the file; completions may arrive in any order
+    void transfer(int fd, uint8_t* data, size_t size, bool write, bool direct) {
+        std::vector<int> freeSlots;
+        for (int slot = depth - 1; slot >= 0; --slot) freeSlots.push_back(slot);
+
+        size_t nextOffset = 0;
+        int inFlight = 0;
+        while (nextOffset < size || inFlight > 0) {
+            // Fill every free slot with the next block
+            while (nextOffset < size && !freeSlots.empty()) {
+                int slot = freeSlots.back();
+                freeSlots.pop_back();
+                slotOffsets[slot] = nextOffset;
+                slotLengths[slot] = size - nextOffset < requestSize ? size - nextOffset : requestSize;
+                pace(slotLengths[slot]);
+                nextOffset += slotLengths[slot];
+                submit(fd, slot, write, direct, data);
+                inFlight++;
+            }
+
+            ring.submitAndWait();
+
+            uint64_t userData;
+            int result;
+            while (ring.popCompletion(userData, result)) {
+                int slot = static_cast<int>(userData);
+                if (result <= 0) {
+                    drain(inFlight - 1);
+                    throw std::runtime_error(write ? "Error writing file." : "Error reading file.");
+                }
+
+                size_t done = static_cast<size_t>(result) < slotLengths[slot] ? static_cast<size_t>(result) : slotLengths[slot];
+                if (!write) memcpy(data + slotOffsets[slot], buffers.data() + slot * requestSize, done);
+
+                if (done < slotLengths[slot]) {
+                    // Short transfer: queue the remainder on the same slot
+                    slotOffsets[slot] += done;
+                    slotLengths[slot] -= done;
+                    submit(fd, slot, write, direct, data);
+                    continue;
+                }
+                freeSlots.push_back(slot);
+                inFlight--;
+            }
+        }
+    }
+
+    // Queues the request described by slotOffsets[slot] and slotLengths[slot]
+    void submit(int fd, int slot, bool write, bool direct, const uint8_t* data) {
+        uint8_t* buffer = buffers.data() + slot * requestSize;
+        size_t length = slotLengths[slot];
+        size_t requestLength = direct ? AlignedBuffer::roundUp(length) : length;
+        if (write) {
+            memcpy(buffer, data + slotOffsets[slot], length);
+            memset(buffer + length, 0, requestLength - length);
+        }
+        ring.prepare(fd, write, registered, buffer, static_cast<unsigned>(requestLength), slotOffsets[slot], static_cast<uint64_t>(slot));
+    }
+
+    // Waits for outstanding requests so the ring is clean for the next transfer
+    void drain(int outstanding) {
+        uint64_t userData;
+        int result;
+        while (outstanding > 0) {
+            ring.submitAndWait();
+            while (ring.popCompletion(userData, result)) outstanding--;
+        }
+    }
+};
+#endif
+#endif
+
+// Picks io_uring or overlapped I/O where available, pread/pwrite or streams otherwise
+std::unique_ptr<IOBackend> IOBackend::create(const IOOptions& options) {
+#if defined(_WIN32)
+    return std::unique_ptr<IOBackend>(new OverlappedIOBackend(options));
+#else
+#if defined(__linux__)
+    try {
+        return std::unique_ptr<IOBackend>(new UringIOBackend(options));
+    }
+    catch (const std::exception&) {
+        // Kernel without io_uring or a sandbox blocking it
+    }
+#endif
+    return std::unique_ptr<IOBackend>(new PositionalIOBackend(options));
+#endif
+}
+
+// Utility file functions route through the active backend
+void Utility::readFileToVector(const std::u32string& filename, std::vector<uint8_t>& data) {
+    IOBackend::getInstance().readFile(filename, data);
+}
+
+void Utility::writeVectorToFile(const std::u32string& filename, const std::vector<uint8_t>& data) {
+    IOBackend::getInstance().writeFile(filename, data);
+}
+
+// Graphic User Interface (GUI) handling various display functions
+class GUI {
+
+public:
+#ifdef _WIN32
+    // Clears the console screen by filling it with spaces and resetting the cursor position
+    static void clearScreen() {
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        COORD coordScreen = { 0, 0 };    // Coordinates for the top-left corner of the screen
+        DWORD charsWritten;
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        DWORD consoleSize;
+
+        // Retrieve the current screen buffer information
+        GetConsoleScreenBufferInfo(hConsole, &csbi);
+        consoleSize = csbi.dwSize.X * csbi.dwSize.Y;
+
+        // Fill the entire screen buffer with spaces
+        FillConsoleOutputCharacter(hConsole, ' ', consoleSize, coordScreen, &charsWritten);
+
+        // Restore the screen attributes (colors and other attributes)
+        FillConsoleOutputAttribute(hConsole, csbi.wAttributes, consoleSize, coordScreen, &charsWritten);
+
+        // Move the cursor back to the top-left corner of the screen
+        SetConsoleCursorPosition(hConsole, coordScreen);
+    }
+#endif
+
+    // Returns the ASCII art for the Main screen of the GUI
+    static const std::string& drawMainScreen() {
+        static const std::string mainScreen =
+            "  __________________________________________________________________ \n"
+            " /                                                                  \\ \n"
+            " | General purpose Lempel-Ziv-Welch compressor                      | \n"
+            " |                                                                  | \n"
+            " | Compress     D:\\Folder\\File.ext -c -> D:\\Folder\\File.bin         | \n"
+            " | Compress+    D:\\Folder\\File.ext -ce -> D:\\Folder\\File.bin        | \n"
+            " | Records      D:\\Folder\\File.ext -cf -> D:\\Folder\\File.bin        | \n"
+            " | Primed       D:\\Folder\\File.ext -cp -> D:\\Folder\\File.bin        | \n"
+            " | Dedup        D:\\Folder\\File.ext -cd -> D:\\Folder\\File.bin        | \n"
+            " | Append       D:\\Folder\\File.ext -a -> D:\\Folder\\File.bin         | \n"
+            " | Decompress   D:\\Folder\\File.bin -d -> D:\\Folder\\File Decoded.ext | \n"
+            " | Benchmark    D:\\Folder\\File.ext -b -> policy comparison          | \n"
+            " | Estimate     D:\\Folder\\File.ext -e -> ratio and time from sample | \n"
+            " | Autotune     D:\\Folder\\File.ext -t -> profile for this machine   | \n"
+            " | Verify       D:\\Folder\\File.bin -v -> decode and compare         | \n"
+            " | Statistics   D:\\Folder\\File.ext -s -> D:\\Folder\\File.stats.json  | \n"
+            " |__________________________________________________________________| \n"
+            " |                                                                  | \n"
+            " | Input:                                                           | \n"
+            " \\__________________________________________________________________/ \n"
+            "  __________________________________________________________________   \n"
+            " /                                                                  \\  \n"
+            " | Progress: [--------------------] 0 %       Time: 00:00:00        | \n"
+            " |                                                                  | \n"
+            " | Size: - / -                               Speed: -               | \n"
+            " |__________________________________________________________________| \n"
+            " |                                                                  | \n"
+            " | Output: -                                                        | \n"
+            " \\__________________________________________________________________/ \n"
+            "                                                                       "
+            ;
+
+        return mainScreen;
+    }
+
+    // Returns the ASCII art for the Error screen of the GUI
+    static const std::string& drawErrorScreen() {
+        static const std::string errorScreen =
+            "  __________________________________________________________________   \n"
+            " /                                                                  \\  \n"
+            " | Error:                                                           | \n"
+            " \\__________________________________________________________________/ \n"
+            "                                                                       "
+            ;
+
+        return errorScreen;
+    }
+
+    // Generates a progress bar as a string representation
+    // The progress bar is visualized with '#' characters for completed progress and '-' for remaining progress
+    static std::string drawProgressBar(double progressBar) {
+        // Create the progress bar using '#' and '-' characters
+        return "[" + std::string(static_cast<int>(std::round(progressBar * 20)), '#') +
+            std::string(static_cast<int>(std::round((1 - progressBar) * 20)), '-') +
+            "] " + std::to_string(static_cast<int>(std::round(progressBar * 100))) + " %";
+    }
+
+    // Formats the size of a file or data for display
+    // Sizes are formatted as Bytes, KB, MB, or GB depending on the magnitude
+    static std::string drawSizeField(size_t size) {
+        std::ostringstream oss;
+
+        // Format size with appropriate units
+        if (size < 1024) {
+            oss << size << " Bytes";
+        }
+        else if (size < 1024 * 1024) {
+            oss << std::fixed << std::setprecision(2) << (size / 1024.0) << " KB";
+        }
+        else if (size < 1024 * 1024 * 1024) {
+            oss << std::fixed << std::setprecision(2) << (size / (1024.0 * 1024.0)) << " MB";
+        }
+        else {
+            oss << std::fixed << std::setprecision(2) << (size / (1024.0 * 1024.0 * 1024.0)) << " GB";
+        }
+
+        return oss.str();
+    }
+
+    // Formats the data transfer speed for display
+    // Speeds are formatted as Bytes/s, KB/s, MB/s, or GB/s depending on the magnitude
+    static std::string drawSpeed(size_t size, double duration) {
+        if (duration <= 0) {
+            duration = 1; // Handle invalid duration input
+        }
+
+        double speed = (size / duration); // Calculate speed in Bytes per second
+        std::ostringstream oss;
+
+        // Format speed with appropriate units
+        if (speed < 1024) {
+            oss << std::fixed << std::setprecision(2) << speed << " Bytes/s";
+        }
+        else if (speed < 1024 * 1024) {
+            oss << std::fixed << std::setprecision(2) << (speed / 1024.0) << " KB/s";
+        }
+        else if (speed < 1024 * 1024 * 1024) {
+            oss << std::fixed << std::setprecision(2) << (speed / (1024.0 * 1024.0)) << " MB/s";
+        }
+        else {
+            oss << std::fixed << std::setprecision(2) << (speed / (1024.0 * 1024.0 * 1024.0)) << " GB/s";
+        }
+
+        return oss.str();
+    }
+};
+
+#ifdef _WIN32
+// Cursor manipulation for managing console cursor and screen interactions
+// The screens are drawn through the Win32 console API, so they exist only on Windows.
+class Cursor {
+
+public:
+    // Retrieves the coordinates of the last non-space character on the console screen
+    static COORD getLastConsoleChar() {
+        // Obtain the handle to the console
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+
+        // Initialize structure to store console screen buffer info
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+
+        // Get information about the console screen buffer
+        if (GetConsoleScreenBufferInfo(hConsole, &csbi)) {
+            // Calculate total number of characters in the console screen buffer
+            DWORD consoleSize = csbi.dwSize.X * csbi.dwSize.Y;
+
+            // Allocate buffer to store console screen contents
+            CHAR_INFO* buffer = new CHAR_INFO[consoleSize];
+
+            COORD bufferSize = csbi.dwSize;
+            COORD bufferCoord = { 0, 0 };
+            SMALL_RECT readRegion = { 0, 0, csbi.dwSize.X - 1, csbi.dwSize.Y - 1 };
+
+            // Read console screen buffer into the allocated buffer
+            if (ReadConsoleOutput(hConsole, buffer, bufferSize, bufferCoord, &readRegion)) {
+                // Search buffer in reverse to find the last non-space character
+                for (int i = consoleSize - 1; i >= 0; --i) {
+                    if (buffer[i].Char.AsciiChar != ' ') {
+                        // Determine the coordinates of the last non-space character
+                        COORD lastCharPos = {
+                            static_cast<SHORT>(i % csbi.dwSize.X),
+                            static_cast<SHORT>(i / csbi.dwSize.X)
+                        };
+
+                        delete[] buffer;
+                        return lastCharPos;
+                    }
+                }
+            }
+
+            delete[] buffer;
+        }
+
+        // Return {0, 0} if no non-space character is found
+        return { 0, 0 };
+    }
+
+    // Moves the cursor to the specified (x, y) position in the console
+    static void goTo(int x, int y) {
+        COORD coord = { x, y };
+        SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), coord);
+    }
+
+    // Reads input from the console with support for line wrapping
+    // If maxLineLength is reached, wraps to the next line
+    // Optionally triggers a callback when the line changes
+    static std::u32string readInputStream(int maxLineLength, std::function<void(bool direction)> lineChangeCallback = nullptr) {
+        COORD initialPos = getCurrentCursorPosition();
+
+        int startX = initialPos.X;
+        int startY = initialPos.Y;
+        int currentX = startX;
+        int currentY = startY;
+
+        int lineCount = 1;
+
+        std::wstring input;
+        wchar_t ch;
+
+        while (true) {
+            ch = _getwch();  // Read wide character input
+
+            if (ch == L'\r') {  // Enter key
+                break;
+            }
+            else if (ch == L'\b' || ch == 8) {  // Backspace key
+                if (!input.empty()) {
+                    input.pop_back();
+
+                    if (currentX <= startX) {
+                        // Move back to the previous line if the current line is empty
+                        lineCount--;
+                        currentX = startX + maxLineLength - 1;
+                        currentY--;
+
+                        goTo(currentX, currentY);
+                        std::wcout << L' ' << L' '; // Erase character
+
+                        if (lineChangeCallback) lineChangeCallback(0); // Notify line change
+
+                        goTo(currentX, currentY);
+                    }
+                    else
+                    {
+                        goTo(--currentX, currentY);
+                        std::wcout << L' ' << L' ';  // Erase character
+
+                        goTo(currentX, currentY);
+                    }
+                }
+            }
+            else if (ch == L'\"') { // Skip quote characters
+                continue;
+            }
+            else {
+                if ((float)input.size() / lineCount >= maxLineLength) {
+                    // Move to the next line if the max length is reached
+                    lineCount++;
+                    currentX = startX;
+                    currentY++;
+
+                    if (lineChangeCallback) lineChangeCallback(1); // Notify line change
+
+                    goTo(currentX, currentY);
+                }
+                input += ch;
+                std::wcout << ch;
+
+                currentX++;
+            }
+        }
+
+        goTo(0, currentY + 2);  // Move cursor to a new line for subsequent output
+
+        return Utility::wstringToU32string(input); // Convert input to UTF-32 string
+    }
+
+    // Writes output to the console with support for line wrapping
+    // If maxLineLength is reached, wraps to the next line
+    // Optionally triggers a callback when the line changes
+    static std::u32string writeOutputStream(const std::u32string& text, int maxLineLength, std::function<void()> lineChangeCallback = nullptr) {
+        COORD initialPos = getCurrentCursorPosition();
+
+        int startX = initialPos.X;
+        int startY = initialPos.Y;
+        int currentX = startX;
+        int currentY = startY;
+
+        int lineCount = 1;
+
+        std::u32string output;
+        size_t pos = 0;
+        size_t textLength = text.length();
+
+        while (pos < textLength) {
+            wchar_t ch = text[pos++];
+
+            if ((float)output.length() / lineCount >= maxLineLength - 1) {
+                // Move to the next line if the max length is reached
+                lineCount++;
+                currentX = startX;
+                currentY++;
+
+                if (lineChangeCallback) lineChangeCallback(); // Notify line change
+
+                goTo(currentX, currentY);
+            }
+
+            output += ch;
+            std::wcout << ch;
+
+            currentX++;
+        }
+
+        // Move cursor to a new line after writing the output
+        goTo(0, currentY + 2);
+
+        return output;
+    }
+
+    // Searches for a text string in the console buffer and returns its coordinates
+    // Returns {-1, -1} if the text is not found
+    static COORD findTextInConsole(const std::string& searchString) {
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        GetConsoleScreenBufferInfo(hConsole, &csbi);
+
+        int consoleWidth = csbi.dwSize.X;
+        int consoleHeight = csbi.dwSize.Y;
+
+        CHAR_INFO* buffer = new CHAR_INFO[consoleWidth * consoleHeight];
+        COORD bufferSize = { consoleWidth, consoleHeight };
+        COORD bufferCoord = { 0, 0 };
+        SMALL_RECT readRegion = { 0, 0, consoleWidth - 1, consoleHeight - 1 };
+
+        // Read the console screen buffer into the allocated buffer
+        if (ReadConsoleOutput(hConsole, buffer, bufferSize, bufferCoord, &readRegion)) {
+            // Search for the text in the console buffer
+            for (int y = 0; y < consoleHeight; ++y) {
+                for (int x = 0; x <= consoleWidth - searchString.size(); ++x) {
+                    bool match = true;
+                    for (size_t i = 0; i < searchString.size(); ++i) {
+                        if (buffer[y * consoleWidth + x + i].Char.AsciiChar != searchString[i]) {
+                            match = false;
+                            break;
+                        }
+                    }
+                    if (match) {
+                        delete[] buffer;
+                        return { static_cast<SHORT>(x + searchString.length()), static_cast<SHORT>(y) };
+                    }
+                }
+            }
+        }
+
+        delete[] buffer;
+
+        // Return {-1, -1} if text is not found
+        return { -1, -1 };
+    }
+
+    // Pauses execution and waits for user input before exiting
+    // Moves the cursor to a position below the last character
+    static void pause() {
+        COORD lastChar = Cursor::getLastConsoleChar();
+        Cursor::goTo(0, lastChar.Y + 2);
+
+        system("pause");  // Wait for user input
+    }
+
+private:
+    // Retrieves the current cursor position
+    static COORD getCurrentCursorPosition() {
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
+
+        return csbi.dwCursorPosition;
+    }
+};
+#endif
+
+// Class for packing and unpacking vector data into a bit-packed format
+class Bitpacker {
+
+public:
+    // Packs 'nin' integers from the 'input' vector into a bit-packed format and stores it in the 'output' vector.
+    // 'n' specifies the number of bits used to represent each integer.
+    // Returns the total number of bits written to the 'output' vector.
+    static int pack(const std::vector<int>& input, std::vector<uint8_t>& output, int n) {
+        int nin = input.size(); // Number of integers to pack
+        int64_t inmask = 0; // Mask to isolate bits from the input integers
+        int obit = 0; // Bit position in the current byte of the output vector
+        int nout = 0; // Total number of bits written to the output vector
+
+        // Calculate the maximum number of bytes needed to store the packed data
+        int maxBytes = (nin * n + 7) / 8;
+        output.resize(maxBytes); // Resize the output vector to fit the packed data
+        memset(output.data(), 0, maxBytes); // Initialize the output buffer to zero
+
+        // Iterate through each integer in the input vector
+        for (int i = 0; i < nin; i++) {
+            inmask = (int64_t)1 << (n - 1); // Initialize mask for the current integer
+
+            // Extract bits from the current integer and store them in the output vector
+            for (int k = 0; k < n; k++) {
+                output[nout / 8] |= (((input[i] & inmask) >> (n - k - 1)) << (7 - obit));
+                inmask >>= 1;
+                obit++;
+                nout++;
+
+                // If a byte is fully filled, reset the bit position
+                if (obit == 8) {
+                    obit = 0;
+                }
+            }
+        }
+        return nout; // Return the total number of bits packed
+    }
+
+    // Unpacks 'nbitsin' bits from the 'input' vector and stores the resulting integers in the 'output' vector.
+    // 'n' specifies the number of bits used to represent each integer.
+    // Returns the number of integers written to the 'output' vector.
+    static int unpack(const std::vector<uint8_t>& input, int nbitsin, std::vector<int>& output, int n) {
+        int inbit = 0; // Bit position in the current byte of the input vector
+        int nout = 0; // Total number of bits processed
+        int numInts = nbitsin / n; // Number of integers to unpack
+        output.resize(numInts); // Resize the output vector to fit the unpacked integers
+
+        // Iterate through each integer to be unpacked
+        for (int i = 0; i < numInts; i++) {
+            int64_t value = 0; // Temporary variable to accumulate the unpacked integer value
+
+            // Extract bits from the input vector to form the integer
+            for (int j = 0; j < n; j++) {
+                if (inbit == 8) { // Move to the next byte if needed
+                    inbit = 0;
+                }
+                int bit = (input[nout / 8] >> (7 - inbit)) & 1;
+                value = (value << 1) | bit;
+                inbit++;
+                nout++;
+            }
+            output[i] = static_cast<int>(value); // Store the unpacked integer in the output vector
+        }
+        return numInts; // Return the number of integers unpacked
+    }
+
+    // Converts an integer value to a vector of uint8_t with a specified number of bytes.
+    static std::vector<uint8_t> intToBytes(int value, size_t n) {
+        std::vector<uint8_t> bytes(n);
+        // Copy the bytes of the integer into the vector
+        std::memcpy(bytes.data(), &value, sizeof(value) < n ? sizeof(value) : n);
+        return bytes;
+    }
+
+    // Converts a vector of uint8_t back into an integer.
+    static int bytesToInt(const std::vector<uint8_t>& bytes) {
+        int value = 0;
+        // Copy the bytes from the vector into the integer
+        std::memcpy(&value, bytes.data(), sizeof(value) < bytes.size() ? sizeof(value) : bytes.size());
+        return value;
+    }
+};
+
+// Writes variable-width values into a byte vector, most significant bit first (same bit order as Bitpacker)
+class BitWriter {
+
+public:
+    explicit BitWriter(std::vector<uint8_t>& output) : output(output), accumulator(0), pending(0), written(0) {}
+
+    // Appends the low 'n' bits of 'value' (n <= 32)
+    void write(uint32_t value, int n) {
+        accumulator = (accumulator << n) | (value & mask(n));
+        pending += n;
+        written += n;
+
+        // Move every completed byte to the output
+        while (pending >= 8) {
+            pending -= 8;
+            output.push_back(static_cast<uint8_t>(accumulator >> pending));
+        }
+    }
+
+    // Pads the last partial byte with zero bits
+    void flush() {
+        if (pending > 0) {
+            output.push_back(static_cast<uint8_t>(accumulator << (8 - pending)));
+            pending = 0;
+        }
+    }
+
+    // Total number of bits written so far
+    int64_t bitCount() const {
+        return written;
+    }
+
+    static uint64_t mask(int n) {
+        return n >= 64 ? ~0ull : ((1ull << n) - 1);
+    }
+
+private:
+    std::vector<uint8_t>& output; // Destination of the packed bits
+    uint64_t accumulator; // Bits not yet moved to the output
+    int pending; // Number of valid bits in the accumulator
+    int64_t written; // Total number of bits written
+};
+
+// Reads variable-width values from a byte buffer, most significant bit first
+// Reading past the end of the buffer yields zero bits
+class BitReader {
+
+public:
+    BitReader(const uint8_t* data, size_t size) : data(data), size(size), position(0), accumulator(0), available(0) {}
+
+    // Reads the next 'n' bits (n <= 32)
+    uint32_t read(int n) {
+        refill(n);
+        available -= n;
+        return static_cast<uint32_t>((accumulator >> available) & BitWriter::mask(n));
+    }
+
+    // Returns the next 'n' bits without consuming them
+    uint32_t peek(int n) {
+        refill(n);
+        return static_cast<uint32_t>((accumulator >> (available - n)) & BitWriter::mask(n));
+    }
+
+    // Consumes 'n' bits previously inspected with peek
+    void skip(int n) {
+        available -= n;
+    }
+
+private:
+    const uint8_t* data; // Source buffer
+    size_t size; // Size of the source buffer in bytes
+    size_t position; // Next byte to load into the accumulator
+    uint64_t accumulator; // Loaded bits not yet consumed
+    int available; // Number of valid bits in the accumulator
+
+    // Loads whole bytes until at least 'n' bits are available
+    void refill(int n) {
+        while (available < n) {
+            accumulator = (accumulator << 8) | (position < size ? data[position] : 0);
+            position++;
+            available += 8;
+        }
+    }
+};
+
+// Canonical Huffman coding of an LZW code stream over code-length classes
+// Each code is split into a class symbol (its bit length plus the two bits below the leading one)
+// and raw extra bits, so the alphabet stays small regardless of the dictionary size.
+class HuffmanCoder {
+
+public:
+    static const int numSymbols = 124; // Classes for code values up to 32 bits
+    static const int maxCodeLength = 15; // Longest Huffman code, also the decoding table index width
+
+    // Entropy codes 'codes' into 'output' as [code count 4B][code lengths 4 bits each][bitstream].
+    // Returns the number of bits in the bitstream.
+    static int64_t encode(const std::vector<int>& codes, std::vector<uint8_t>& output) {
+        // Count class frequencies
+        std::vector<uint32_t> frequencies(numSymbols, 0);
+        for (int code : codes) {
+            int extraBits;
+            frequencies[symbolOf(static_cast<uint32_t>(code), extraBits)]++;
+        }
+
+        std::vector<uint8_t> lengths;
+        buildLengths(frequencies, lengths);
+        std::vector<uint32_t> huffmanCodes;
+        assignCodes(lengths, huffmanCodes);
+
+        // Header: code count followed by the nibble-packed code lengths
+        Utility::appendVector(output, Bitpacker::intToBytes(static_cast<int>(codes.size()), 4));
+        for (int i = 0; i < numSymbols; i += 2) {
+            output.push_back(static_cast<uint8_t>((lengths[i] << 4) | lengths[i + 1]));
+        }
+
+        // Bitstream: class code followed by the extra bits of each code
+        BitWriter writer(output);
+        for (int code : codes) {
+            int extraBits;
+            int symbol = symbolOf(static_cast<uint32_t>(code), extraBits);
+            writer.write(huffmanCodes[symbol], lengths[symbol]);
+            if (extraBits > 0) writer.write(static_cast<uint32_t>(code), extraBits);
+        }
+        writer.flush();
+
+        return writer.bitCount();
+    }
+
+    // Decodes a stream produced by encode() back into the code sequence
+    static void decode(const std::vector<uint8_t>& input, std::vector<int>& output) {
+        const size_t headerSize = 4 + numSymbols / 2;
+        if (input.size() < headerSize) {
+            throw std::runtime_error("Bad entropy coded block.");
+        }
+
+        // Every code takes at least one bit, so a larger count can only come from a damaged header
+        int count = Bitpacker::bytesToInt(std::vector<uint8_t>(input.begin(), input.begin() + 4));
+        if (count < 0 || static_cast<uint64_t>(count) > 8 * static_cast<uint64_t>(input.size() - headerSize)) {
+            throw std::runtime_error("Bad entropy coded block.");
+        }
+        std::vector<uint8_t> lengths(numSymbols);
+        for (int i = 0; i < numSymbols; i += 2) {
+            lengths[i] = input[4 + i / 2] >> 4;
+            lengths[i + 1] = input[4 + i / 2] & 0x0F;
+        }
+
+        // The lengths must form a prefix code (Kraft sum at most 1), or the table below would be overrun
+        uint32_t space = 0;
+        for (uint8_t length : lengths) {
+            if (length > 0) space += static_cast<uint32_t>(1) << (maxCodeLength - length);
+        }
+        if (space > (static_cast<uint32_t>(1) << maxCodeLength) || (space == 0 && count > 0)) {
+            throw std::runtime_error("Bad entropy coded block.");
+        }
+
+        // Single-level lookup table indexed by the next maxCodeLength bits: (symbol << 4) | length
+        std::vector<uint32_t> huffmanCodes;
+        assignCodes(lengths, huffmanCodes);
+        std::vector<uint16_t> table(static_cast<size_t>(1) << maxCodeLength, 0);
+        for (int symbol = 0; symbol < numSymbols; ++symbol) {
+            int length = lengths[symbol];
+            if (length == 0) continue;
+            uint32_t first = huffmanCodes[symbol] << (maxCodeLength - length);
+            uint32_t last = (huffmanCodes[symbol] + 1) << (maxCodeLength - length);
+            for (uint32_t j = first; j < last; ++j) {
+                table[j] = static_cast<uint16_t>((symbol << 4) | length);
+            }
+        }
+
+        output.resize(count);
+        BitReader reader(input.data() + headerSize, input.size() - headerSize);
+        for (int i = 0; i < count; ++i) {
+            uint16_t entry = table[reader.peek(maxCodeLength)];
+            if (entry == 0) {
+                throw std::runtime_error("Bad entropy coded block.");
+            }
+            reader.skip(entry & 0x0F);
+
+            // Rebuild the code from its class and extra bits
+            int symbol = entry >> 4;
+            if (symbol < 4) {
+                output[i] = symbol;
+            }
+            else {
+                int shift = symbol / 4 - 1; // Bit length minus the three leading bits
+                uint32_t value = static_cast<uint32_t>(4 | (symbol & 3)) << shift;
+                if (shift > 0) value |= reader.read(shift);
+                output[i] = static_cast<int>(value);
+            }
+        }
+    }
+
+private:
+    // Maps a code to its class symbol and number of extra bits
+    static int symbolOf(uint32_t value, int& extraBits) {
+        if (value < 4) {
+            extraBits = 0;
+            return static_cast<int>(value);
+        }
+
+        int bitLength = 0;
+        while (bitLength < 32 && (value >> bitLength) != 0) ++bitLength;
+
+        extraBits = bitLength - 3;
+        return 4 * (bitLength - 2) + static_cast<int>((value >> extraBits) & 3);
+    }
+
+    // Computes Huffman code lengths limited to maxCodeLength bits
+    static void buildLengths(const std::vector<uint32_t>& frequencies, std::vector<uint8_t>& lengths) {
+        std::vector<uint64_t> weights(frequencies.begin(), frequencies.end());
+        lengths.assign(numSymbols, 0);
+
+        while (true) {
+            // Leaves occupy nodes [0, numSymbols), internal nodes are appended after them
+            std::vector<int> parent(numSymbols, -1);
+            typedef std::pair<uint64_t, int> Node;
+            std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+            for (int i = 0; i < numSymbols; ++i) {
+                if (weights[i] > 0) heap.push({ weights[i], i });
+            }
+
+            if (heap.empty()) return;
+            if (heap.size() == 1) {
+                lengths[heap.top().second] = 1; // A lone symbol still needs one bit
+                return;
+            }
+
+            while (heap.size() > 1) {
+                Node a = heap.top(); heap.pop();
+                Node b = heap.top(); heap.pop();
+                int node = static_cast<int>(parent.size());
+                parent.push_back(-1);
+                parent[a.second] = node;
+                parent[b.second] = node;
+                heap.push({ a.first + b.first, node });
+            }
+
+            // Depth of each leaf is its code length
+            int longest = 0;
+            for (int i = 0; i < numSymbols; ++i) {
+                if (weights[i] == 0) continue;
+                int depth = 0;
+                for (int node = i; parent[node] != -1; node = parent[node]) ++depth;
+                lengths[i] = static_cast<uint8_t>(depth);
+                longest = longest > depth ? longest : depth;
+            }
+
+            if (longest <= maxCodeLength) return;
+
+            // Flatten the distribution and retry until the lengths fit
+            for (auto& weight : weights) {
+                if (weight > 0) weight = (weight >> 1) | 1;
+            }
+        }
+    }
+
+    // Assigns canonical codes from code lengths (shorter codes first, then by symbol)
+    static void assignCodes(const std::vector<uint8_t>& lengths, std::vector<uint32_t>& codes) {
+        int lengthCount[maxCodeLength + 1] = { 0 };
+        for (uint8_t length : lengths) lengthCount[length]++;
+        lengthCount[0] = 0;
+
+        uint32_t nextCode[maxCodeLength + 1] = { 0 };
+        uint32_t code = 0;
+        for (int bits = 1; bits <= maxCodeLength; ++bits) {
+            code = (code + lengthCount[bits - 1]) << 1;
+            nextCode[bits] = code;
+        }
+
+        codes.assign(lengths.size(), 0);
+        for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+            if (lengths[symbol] != 0) codes[symbol] = nextCode[lengths[symbol]]++;
+        }
+    }
+};
+
+// Reversible transforms that reshape a block before the dictionary sees it
+// Arrays of fixed-width records repeat little byte for byte, but their deltas and byte planes do.
+// Encoding runs delta, then shuffle, then run-length; decoding runs them in reverse.
+class BlockFilter {
+
+public:
+    enum Kind : uint8_t {
+        Delta = 0x01, // Each byte minus the byte one record earlier
+        Shuffle = 0x02, // Byte j of every record gathered into plane j
+        RunLength = 0x04 // Runs of 3 or more equal bytes stored as [0x80 | length - 3][byte]
+    };
+    static const uint8_t Auto = 0x80; // Pick the filters and record width per block from a sample
+
+    // Transforms 'size' bytes with 'kinds' into 'output'
+    static void apply(const uint8_t* input, size_t size, uint8_t kinds, int width, std::vector<uint8_t>& output) {
+        std::vector<uint8_t> stage;
+        const uint8_t* current = input;
+        if (kinds & Delta) {
+            stage.resize(size);
+            delta(current, size, width, stage.data());
+            current = stage.data();
+        }
+        if (kinds & Shuffle) {
+            output.resize(size);
+            shuffle(current, size, width, output.data());
+            if (!(kinds & RunLength)) return;
+            stage.swap(output);
+            current = stage.data();
+        }
+        if (kinds & RunLength) {
+            output.clear();
+            runLength(current, size, output);
+            return;
+        }
+        output.assign(current, current + size);
+    }
+
+    // Undoes 'apply' and appends the original bytes to 'output'
+    static void invert(const uint8_t* input, size_t size, uint8_t kinds, int width, std::vector<uint8_t>& output) {
+        if (width < 1) {
+            throw std::runtime_error("Bad compressed block.");
+        }
+
+        std::vector<uint8_t> expanded;
+        if (kinds & RunLength) {
+            expandRuns(input, size, expanded);
+            input = expanded.data();
+            size = expanded.size();
+        }
+
+        size_t start = output.size();
+        output.resize(start + size);
+        uint8_t* target = output.data() + start;
+        if ((kinds & Shuffle) && (kinds & Delta)) {
+            std::vector<uint8_t> planes(size);
+            unshuffle(input, size, width, planes.data());
+            undelta(planes.data(), size, width, target);
+        }
+        else if (kinds & Shuffle) {
+            unshuffle(input, size, width, target);
+        }
+        else if (kinds & Delta) {
+            undelta(input, size, width, target);
+        }
+        else if (size > 0) {
+            std::memcpy(target, input, size);
+        }
+    }
+
+    // Picks the filters and record width that encode a sample of the block smallest
+    // 'encodedSize' encodes a buffer without filters and returns its size.
+    static void choose(const uint8_t* input, size_t size, const std::function<size_t(const uint8_t*, size_t)>& encodedSize, uint8_t& kinds, int& width) {
+        kinds = 0;
+        width = 1;
+        if (size < minimumSample) return;
+
+        size_t sampleSize = size < sampleLimit ? size : sampleLimit;
+        size_t best = encodedSize(input, sampleSize);
+        std::vector<uint8_t> filtered;
+        auto trial = [&](uint8_t trialKinds, int trialWidth) {
+            apply(input, sampleSize, trialKinds, trialWidth, filtered);
+            size_t encoded = encodedSize(filtered.data(), filtered.size());
+            if (encoded < best) {
+                best = encoded;
+                kinds = trialKinds;
+                width = trialWidth;
+            }
+        };
+
+        trial(Delta, 1);
+        for (int recordWidth : { 2, 4, 8 }) {
+            trial(Shuffle, recordWidth);
+            trial(Delta | Shuffle, recordWidth);
+        }
+        trial(static_cast<uint8_t>(kinds | RunLength), width);
+    }
+
+private:
+    static const size_t minimumSample = 1024; // Smaller blocks are left unfiltered
+    static const size_t sampleLimit = 32 * 1024; // Bytes encoded per trial
+
+    static void delta(const uint8_t* input, size_t size, int width, uint8_t* output) {
+        size_t stride = static_cast<size_t>(width);
+        size_t i = 0;
+        for (; i < stride && i < size; ++i) output[i] = input[i];
+#ifdef LZWPP_SSE2
+        for (; i + 16 <= size; i += 16) {
+            __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i - stride));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_sub_epi8(current, previous));
+        }
+#endif
+        for (; i < size; ++i) output[i] = static_cast<uint8_t>(input[i] - input[i - stride]);
+    }
+
+    static void undelta(const uint8_t* input, size_t size, int width, uint8_t* output) {
+        size_t stride = static_cast<size_t>(width);
+        size_t i = 0;
+#ifdef LZWPP_SSE2
+        // Each output depends on the one a record earlier: strides of 16 or more take whole vectors,
+        // power-of-two strides below that are prefix sums within a vector plus the previous vector's last record.
+        // The first record (and at least one vector) has nothing a stride back, so it is done byte by byte.
+        for (; (i < 16 || i < stride) && i < size; ++i) output[i] = static_cast<uint8_t>(input[i] + (i >= stride ? output[i - stride] : 0));
+        switch (width) {
+        case 1: i = undeltaVector<1>(input, size, i, output); break;
+        case 2: i = undeltaVector<2>(input, size, i, output); break;
+        case 4: i = undeltaVector<4>(input, size, i, output); break;
+        case 8: i = undeltaVector<8>(input, size, i, output); break;
+        default:
+            if (stride >= 16) {
+                for (; i + 16 <= size; i += 16) {
+                    __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+                    __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(output + i - stride));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_add_epi8(current, previous));
+                }
+            }
+        }
+#endif
+        for (; i < size; ++i) output[i] = static_cast<uint8_t>(input[i] + (i >= stride ? output[i - stride] : 0));
+    }
+
+    // Planes go one after another; bytes of an incomplete last record stay at the end as they are
+    static void shuffle(const uint8_t* input, size_t size, int width, uint8_t* output) {
+        size_t stride = static_cast<size_t>(width);
+        size_t records = size / stride;
+        size_t i = 0;
+#ifdef LZWPP_SSE2
+        i = shuffleVector(input, records, width, output);
+#endif
+        for (; i < records; ++i) {
+            for (size_t j = 0; j < stride; ++j) output[j * records + i] = input[i * stride + j];
+        }
+        for (size_t k = records * stride; k < size; ++k) output[k] = input[k];
+    }
+
+    static void unshuffle(const uint8_t* input, size_t size, int width, uint8_t* output) {
+        size_t stride = static_cast<size_t>(width);
+        size_t records = size / stride;
+        size_t i = 0;
+#ifdef LZWPP_SSE2
+        i = unshuffleVector(input, records, width, output);
+#endif
+        for (; i < records; ++i) {
+            for (size_t j = 0; j < stride; ++j) output[i * stride + j] = input[j * records + i];
+        }
+        for (size_t k = records * stride; k < size; ++k) output[k] = input[k];
+    }
+
+    // Literals are stored as [count - 1][count bytes], up to 128 at a time
+    static void runLength(const uint8_t* input, size_t size, std::vector<uint8_t>& output) {
+        size_t i = 0;
+        while (i < size) {
+            size_t run = runAt(input, size, i);
+            if (run >= 3) {
+                output.push_back(static_cast<uint8_t>(0x80 | (run - 3)));
+                output.push_back(input[i]);
+                i += run;
+                continue;
+            }
+
+            size_t end = nextRun(input, size, i + 1);
+            if (end - i > 128) end = i + 128;
+            output.push_back(static_cast<uint8_t>(end - i - 1));
+            output.insert(output.end(), input + i, input + end);
+            i = end;
+        }
+    }
+
+    static void expandRuns(const uint8_t* input, size_t size, std::vector<uint8_t>& output) {
+        size_t i = 0;
+        while (i < size) {
+            uint8_t control = input[i++];
+            if (control & 0x80) {
+                if (i == size) throw std::runtime_error("Bad compressed block.");
+                output.insert(output.end(), static_cast<size_t>(control & 0x7F) + 3, input[i++]);
+            }
+            else {
+                size_t count = static_cast<size_t>(control) + 1;
+                if (count > size - i) throw std::runtime_error("Bad compressed block.");
+                output.insert(output.end(), input + i, input + i + count);
+                i += count;
+            }
+        }
+    }
+
+    // Length of the run of equal bytes at 'i', at most 130
+    static size_t runAt(const uint8_t* input, size_t size, size_t i) {
+        size_t limit = size - i < 130 ? size - i : 130;
+        size_t length = 1;
+#ifdef LZWPP_SSE2
+        __m128i byte = _mm_set1_epi8(static_cast<char>(input[i]));
+        while (length + 16 <= limit) {
+            int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + length)), byte));
+            if (equal != 0xFFFF) return length + lowestBit(~equal & 0xFFFF);
+            length += 16;
+        }
+#endif
+        while (length < limit && input[i + length] == input[i]) ++length;
+        return length;
+    }
+
+    // Position of the next run of 3 or more equal bytes at or after 'i', 'size' if there is none
+    static size_t nextRun(const uint8_t* input, size_t size, size_t i) {
+#ifdef LZWPP_SSE2
+        for (; i + 18 <= size; i += 16) {
+            __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 1));
+            __m128i third = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 2));
+            int starts = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, second), _mm_cmpeq_epi8(first, third)));
+            if (starts != 0) return i + lowestBit(starts);
+        }
+#endif
+        for (; i + 2 < size; ++i) {
+            if (input[i] == input[i + 1] && input[i] == input[i + 2]) return i;
+        }
+        return size;
+    }
+
+#ifdef LZWPP_SSE2
+    static int lowestBit(int mask) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, static_cast<unsigned long>(mask));
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(static_cast<unsigned>(mask));
+#endif
+    }
+
+    // Prefix sums over records of W bytes (W of 1, 2, 4 or 8), 16 bytes at a time from 'i' (at least 16)
+    template <int W>
+    static size_t undeltaVector(const uint8_t* input, size_t size, size_t i, uint8_t* output) {
+        for (; i + 16 <= size; i += 16) {
+            __m128i sum = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            sum = _mm_add_epi8(sum, _mm_slli_si128(sum, W));
+            if (2 * W < 16) sum = _mm_add_epi8(sum, _mm_slli_si128(sum, (2 * W) & 15));
+            if (4 * W < 16) sum = _mm_add_epi8(sum, _mm_slli_si128(sum, (4 * W) & 15));
+            if (8 * W < 16) sum = _mm_add_epi8(sum, _mm_slli_si128(sum, (8 * W) & 15));
+            __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(output + i - 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_add_epi8(sum, lastRecord<W>(previous)));
+        }
+        return i;
+    }
+
+    // The last W bytes of 'vector' repeated across a whole vector
+    template <int W>
+    static __m128i lastRecord(__m128i vector) {
+        if (W == 8) return _mm_unpackhi_epi64(vector, vector);
+        if (W == 1) vector = _mm_unpackhi_epi8(vector, vector);
+        if (W <= 2) vector = _mm_shufflehi_epi16(vector, 0xFF);
+        return _mm_shuffle_epi32(vector, 0xFF);
+    }
+
+    // Splits 16 records of 2 bytes (in 'a' and 'b') into their two planes
+    static void split2(__m128i a, __m128i b, __m128i& low, __m128i& high) {
+        __m128i mask = _mm_set1_epi16(0x00FF);
+        low = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+        high = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    }
+
+    // Splits 16 records of 4 bytes into four planes: first into 2-byte halves, then each half into bytes
+    static void split4(const __m128i* records, __m128i* planes) {
+        __m128i low[2], high[2];
+        for (int k = 0; k < 2; ++k) {
+            __m128i a = records[2 * k], b = records[2 * k + 1];
+            low[k] = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+            high[k] = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+        }
+        split2(low[0], low[1], planes[0], planes[1]);
+        split2(high[0], high[1], planes[2], planes[3]);
+    }
+
+    // Splits 16 records of 8 bytes into eight planes through their 4-byte halves
+    static void split8(const __m128i* records, __m128i* planes) {
+        __m128i low[4], high[4];
+        for (int k = 0; k < 4; ++k) {
+            __m128i a = _mm_shuffle_epi32(records[2 * k], _MM_SHUFFLE(3, 1, 2, 0));
+            __m128i b = _mm_shuffle_epi32(records[2 * k + 1], _MM_SHUFFLE(3, 1, 2, 0));
+            low[k] = _mm_unpacklo_epi64(a, b);
+            high[k] = _mm_unpackhi_epi64(a, b);
+        }
+        split4(low, planes);
+        split4(high, planes + 4);
+    }
+
+    // Inverse of split2, split4 and split8
+    static void merge2(__m128i low, __m128i high, __m128i& a, __m128i& b) {
+        a = _mm_unpacklo_epi8(low, high);
+        b = _mm_unpackhi_epi8(low, high);
+    }
+
+    static void merge4(const __m128i* planes, __m128i* records) {
+        __m128i low[2], high[2];
+        merge2(planes[0], planes[1], low[0], low[1]);
+        merge2(planes[2], planes[3], high[0], high[1]);
+        for (int k = 0; k < 2; ++k) {
+            records[2 * k] = _mm_unpacklo_epi16(low[k], high[k]);
+            records[2 * k + 1] = _mm_unpackhi_epi16(low[k], high[k]);
+        }
+    }
+
+    static void merge8(const __m128i* planes, __m128i* records) {
+        __m128i low[4], high[4];
+        merge4(planes, low);
+        merge4(planes + 4, high);
+        for (int k = 0; k < 4; ++k) {
+            records[2 * k] = _mm_unpacklo_epi32(low[k], high[k]);
+            records[2 * k + 1] = _mm_unpackhi_epi32(low[k], high[k]);
+        }
+    }
+
+    // Shuffles groups of 16 records of 2, 4 or 8 bytes; returns the number of records done
+    static size_t shuffleVector(const uint8_t* input, size_t records, int width, uint8_t* output) {
+        if (width != 2 && width != 4 && width != 8) return 0;
+        size_t i = 0;
+        __m128i in[8], planes[8];
+        for (; i + 16 <= records; i += 16) {
+            for (int k = 0; k < width; ++k) in[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * width + 16 * k));
+            if (width == 2) split2(in[0], in[1], planes[0], planes[1]);
+            else if (width == 4) split4(in, planes);
+            else split8(in, planes);
+            for (int j = 0; j < width; ++j) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + j * records + i), planes[j]);
+        }
+        return i;
+    }
+
+    static size_t unshuffleVector(const uint8_t* input, size_t records, int width, uint8_t* output) {
+        if (width != 2 && width != 4 && width != 8) return 0;
+        size_t i = 0;
+        __m128i planes[8], out[8];
+        for (; i + 16 <= records; i += 16) {
+            for (int j = 0; j < width; ++j) planes[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + j * records + i));
+            if (width == 2) merge2(planes[0], planes[1], out[0], out[1]);
+            else if (width == 4) merge4(planes, out);
+            else merge8(planes, out);
+            for (int k = 0; k < width; ++k) _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * width + 16 * k), out[k]);
+        }
+        return i;
+    }
+#endif
+};
+
+// Options controlling how blocks are encoded
+struct EncodeOptions {
+    bool entropyCoding = false; // Try the Huffman stage on each block and keep it where it is smaller
+    bool growingWidth = true; // Write each code with the width of the dictionary at that point (GrowingWidth), false uses FinalWidth
+    int maxCodeBits = 0; // Reset the dictionary once it needs codes this wide (9-30), 0 never resets
+    uint8_t filters = 0; // BlockFilter kinds run on each block before encoding, BlockFilter::Auto picks them per block
+    int elementWidth = 1; // Record width in bytes for the delta and shuffle filters (1-255)
+    size_t primeBytes = 0; // Prime each block's dictionary on this many trailing bytes of the block before it, 0 disables
+    int primeChain = 0; // Blocks per chain of primed blocks (the first of a chain is not primed, so chains decode in parallel), 0 one chain per thread
+    bool longRepeats = true; // Cut long runs and copies of earlier data out of the code stream (RepeatCoder)
+    bool searchFilters = false; // Keep a SearchFilter of every block in the archive index (Parallelization::parallelSearch)
+};
+
+// Metadata stored at the end of every encoded block
+// Plain blocks end with [nbits 4B][bitWidth 1B]. Blocks that use an optional stage set the
+// high bit of the width byte and carry a flags byte in front of nbits.
+struct BlockTrailer {
+    enum Flags : uint8_t {
+        EntropyCoded = 0x01, // Code stream is Huffman coded (HuffmanCoder)
+        GrowingWidth = 0x02, // Code widths grow with the dictionary (GrowingWidth)
+        DictionaryReset = 0x04, // Dictionary restarts every 2^bitWidth - 256 codes (ResetWhenFull)
+        Filtered = 0x08, // Data went through BlockFilter first; [filters 1B][elementWidth 1B] precede the flags byte
+        Primed = 0x10, // Dictionary primed on the end of the previous block; [primeWindow 4B][primedEntries 4B] come before the above
+        Stored = 0x20, // The payload is the data itself, not a code stream (Deadline fallback)
+        Repeats = 0x40, // Long repeats were cut out of the code stream; [repeat table][table size 4B] come before all of the above
+        LongStream = 0x80 // The code stream has 2^31 bits or more; [nbits high 4B] sits between the Primed and Filtered fields
+    };
+    static const uint8_t extendedBit = 0x80;
+
+    int64_t nbits = 0; // Number of bits in the code stream
+    int bitWidth = 0; // Width of the largest code
+    uint8_t flags = 0; // Combination of Flags
+    uint8_t filters = 0; // BlockFilter kinds, with the Filtered flag
+    uint8_t elementWidth = 0; // Record width of the filters, with the Filtered flag
+    uint32_t primeWindow = 0; // Bytes at the end of the previous block the dictionary was primed on, with the Primed flag
+    uint32_t primedEntries = 0; // Entries priming added, with the Primed flag
+    uint32_t repeatsSize = 0; // Bytes of the repeat table, with the Repeats flag
+    std::vector<uint8_t> repeats; // Repeat table to write (RepeatCoder::write); read leaves it in the block
+    size_t size = 0; // Number of bytes occupied by the trailer, the repeat table included
+
+    // Appends the trailer to an encoded block
+    // LongStream follows from nbits, so writers never set it themselves.
+    void write(std::vector<uint8_t>& block) const {
+        uint8_t stored = static_cast<uint8_t>(nbits > std::numeric_limits<int32_t>::max() ? flags | LongStream : flags & ~LongStream);
+        if (stored & Repeats) {
+            Utility::appendVector(block, repeats);
+            Utility::appendVector(block, Bitpacker::intToBytes(static_cast<int>(repeats.size()), 4));
+        }
+        if (stored & Primed) {
+            Utility::appendVector(block, Bitpacker::intToBytes(static_cast<int>(primeWindow), 4));
+            Utility::appendVector(block, Bitpacker::intToBytes(static_cast<int>(primedEntries), 4));
+        }
+        if (stored & LongStream) {
+            Utility::appendVector(block, Bitpacker::intToBytes(static_cast<int>(nbits >> 32), 4));
+        }
+        if (stored & Filtered) {
+            block.push_back(filters);
+            block.push_back(elementWidth);
+        }
+        if (stored != 0) block.push_back(stored);
+        Utility::appendVector(block, Bitpacker::intToBytes(static_cast<int>(nbits & 0xFFFFFFFF), 4));
+        block.push_back(static_cast<uint8_t>(bitWidth | (stored != 0 ? extendedBit : 0)));
+    }
+
+    // Parses the trailer at the end of an encoded block
+    static BlockTrailer read(const std::vector<uint8_t>& block) {
+        return read(block.data(), block.size());
+    }
+
+    static BlockTrailer read(const uint8_t* block, size_t size) {
+        if (size < 5) {
+            throw std::runtime_error("Bad compressed block.");
+        }
+
+        BlockTrailer trailer;
+        uint8_t widthByte = block[size - 1];
+        trailer.bitWidth = widthByte & ~extendedBit;
+        int32_t lowBits;
+        std::memcpy(&lowBits, block + size - 5, 4); // Same layout as Bitpacker::intToBytes
+        trailer.nbits = lowBits;
+        trailer.size = 5;
+
+        if (widthByte & extendedBit) {
+            if (size < 6) {
+                throw std::runtime_error("Bad compressed block.");
+            }
+            trailer.flags = block[size - 6];
+            trailer.size = 6;
+        }
+
+        if (trailer.flags & Filtered) {
+            if (size < 8) {
+                throw std::runtime_error("Bad compressed block.");
+            }
+            trailer.filters = block[size - 8];
+            trailer.elementWidth = block[size - 7];
+            trailer.size = 8;
+        }
+
+        if (trailer.flags & LongStream) {
+            if (size < trailer.size + 4) {
+                throw std::runtime_error("Bad compressed block.");
+            }
+            uint32_t highBits;
+            std::memcpy(&highBits, block + size - trailer.size - 4, 4);
+            trailer.nbits = static_cast<int64_t>(static_cast<uint64_t>(highBits) << 32 | static_cast<uint32_t>(trailer.nbits));
+            trailer.size += 4;
+        }
+
+        if (trailer.flags & Primed) {
+            if (size < trailer.size + 8) {
+                throw std::runtime_error("Bad compressed block.");
+            }
+            std::memcpy(&trailer.primeWindow, block + size - trailer.size - 8, 4);
+            std::memcpy(&trailer.primedEntries, block + size - trailer.size - 4, 4);
+            trailer.size += 8;
+        }
+
+        if (trailer.flags & Repeats) {
+            if (size < trailer.size + 4) {
+                throw std::runtime_error("Bad compressed block.");
+            }
+            std::memcpy(&trailer.repeatsSize, block + size - trailer.size - 4, 4);
+            trailer.size += 4;
+            if (size - trailer.size < trailer.repeatsSize) {
+                throw std::runtime_error("Bad compressed block.");
+            }
+            trailer.size += trailer.repeatsSize;
+        }
+        return trailer;
+    }
+};
+
+// Dictionary policies for the encoder: map (prefix code, next byte) to a code
+// findOrInsert returns the existing code, or inserts the pair as 'code' and returns -1.
+// Single-byte entries (codes 0-255) are implicit and never stored.
+
+// Open-addressing hash table with linear probing
+class HashDictionary {
+
+public:
+    static const char* name() { return "hash"; }
+
+    // Empties the dictionary, keeping its memory for the next block or epoch
+    void reset() {
+        if (entries.empty()) entries.resize(initialCapacity);
+        else std::fill(entries.begin(), entries.end(), Entry());
+        shift = 64;
+        for (size_t slots = entries.size(); slots > 1; slots >>= 1) shift--;
+        used = 0;
+    }
+
+    int32_t findOrInsert(int32_t prefix, uint8_t byte, int32_t code) {
+        uint64_t key = (static_cast<uint64_t>(prefix) << 8) | byte;
+        size_t mask = entries.size() - 1;
+        size_t slot = hash(key, shift);
+
+        while (entries[slot].key != emptyKey) {
+            if (entries[slot].key == key) return entries[slot].code;
+            slot = (slot + 1) & mask;
+        }
+
+        entries[slot].key = key;
+        entries[slot].code = code;
+        if (++used * 2 > entries.size()) grow(); // Keep the load factor at or below 1/2
+        return -1;
+    }
+
+private:
+    static const uint64_t emptyKey = ~0ull;
+    static const size_t initialCapacity = 1 << 12;
+
+    struct Entry {
+        uint64_t key = emptyKey;
+        int32_t code = 0;
+    };
+
+    std::vector<Entry> entries; // Power-of-two sized slot array
+    size_t used = 0; // Number of occupied slots
+
+    int shift = 64; // 64 - log2(number of slots)
+
+    // Fibonacci hashing: the top bits of the product select the slot
+    static size_t hash(uint64_t key, int shift) {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    // Doubles the table and reinserts every entry
+    void grow() {
+        std::vector<Entry> old(entries.size() * 2);
+        old.swap(entries);
+        shift--;
+        size_t mask = entries.size() - 1;
+        for (size_t i = 0; i < old.size(); ++i) {
+            const Entry& entry = old[i];
+            if ((i & 0xFFFF) == 0xFFFF) Throttle::checkpoint(); // Large tables take a while to rehash
+            if (entry.key == emptyKey) continue;
+            size_t slot = hash(entry.key, shift);
+            while (entries[slot].key != emptyKey) slot = (slot + 1) & mask;
+            entries[slot] = entry;
+        }
+    }
+};
+
+// Trie stored in flat arrays: each code links to its first child and next sibling
+class ArrayTrieDictionary {
+
+public:
+    static const char* name() { return "trie"; }
+
+    void reset() {
+        firstChild.assign(256, -1);
+        nextSibling.assign(256, -1);
+        suffix.assign(256, 0);
+    }
+
+    // Codes are handed out sequentially, so 'code' is always the next array index
+    int32_t findOrInsert(int32_t prefix, uint8_t byte, int32_t code) {
+        for (int32_t child = firstChild[prefix]; child != -1; child = nextSibling[child]) {
+            if (suffix[child] == byte) return child;
+        }
+
+        firstChild.push_back(-1);
+        nextSibling.push_back(firstChild[prefix]);
+        suffix.push_back(byte);
+        firstChild[prefix] = code;
+        return -1;
+    }
+
+private:
+    std::vector<int32_t> firstChild; // First child of each code, -1 if none
+    std::vector<int32_t> nextSibling; // Next code with the same prefix, -1 if none
+    std::vector<uint8_t> suffix; // Last byte of each code
+};
+
+// Direct-indexed table for two-byte phrases, hash table for longer ones
+class DirectIndexedDictionary {
+
+public:
+    static const char* name() { return "direct"; }
+
+    void reset() {
+        firstLevel.assign(256 * 256, -1);
+        deeper.reset();
+    }
+
+    int32_t findOrInsert(int32_t prefix, uint8_t byte, int32_t code) {
+        if (prefix < 256) {
+            int32_t& entry = firstLevel[(prefix << 8) | byte];
+            if (entry >= 0) return entry;
+            entry = code;
+            return -1;
+        }
+        return deeper.findOrInsert(prefix, byte, code);
+    }
+
+private:
+    std::vector<int32_t> firstLevel; // Code of every (single byte, byte) pair, -1 if absent
+    HashDictionary deeper; // Phrases of three bytes or more
+};
+
+// Code width policies: lay out the codes of a block in the code stream
+// A Writer receives the codes as the encoder produces them; a Reader hands them back one at a time.
+
+// One width for the whole block, large enough for its largest dictionary
+// The width is only known once the block is parsed, so the writer has to keep the codes until then.
+struct FinalWidth {
+    static const char* name() { return "final"; }
+
+    class Writer {
+
+    public:
+        explicit Writer(std::vector<uint8_t>& output) : output(output) {}
+
+        void put(int32_t code) {
+            codes.push_back(code);
+        }
+
+        // The dictionary was cleared after the last code
+        void reset() {}
+
+        // The dictionary starts with 'entries' primed entries
+        void prime(size_t) {}
+
+        // BitWriter packs like Bitpacker::pack, but counts bits in 64 bits so large blocks do not overflow
+        void finish(int32_t largestDictSize, BlockTrailer& trailer) {
+            trailer.bitWidth = static_cast<int>(std::ceil(std::log2(largestDictSize)));
+            BitWriter writer(output);
+            for (int32_t code : codes) writer.write(static_cast<uint32_t>(code), trailer.bitWidth);
+            writer.flush();
+            trailer.nbits = writer.bitCount();
+        }
+
+    private:
+        std::vector<uint8_t>& output; // Destination of the code stream
+        std::vector<int32_t> codes; // Codes of the block so far
+    };
+
+    class Reader {
+
+    public:
+        Reader(const uint8_t* input, size_t size, const BlockTrailer& trailer)
+            : reader(input, size), width(trailer.bitWidth), remaining(trailer.bitWidth > 0 ? trailer.nbits / trailer.bitWidth : 0), total(remaining) {}
+
+        bool next(int32_t& code) {
+            if (remaining == 0) return false;
+            remaining--;
+            code = static_cast<int32_t>(reader.read(width));
+            return true;
+        }
+
+        // Fraction of the code stream consumed
+        double progress() const {
+            return total > 0 ? 1.0 - static_cast<double>(remaining) / total : 1.0;
+        }
+
+    private:
+        BitReader reader;
+        int width; // Width of every code
+        int64_t remaining; // Codes not yet read
+        int64_t total; // Codes in the block
+    };
+};
+
+// Classic LZW widths: each code uses just enough bits for the dictionary size at the time it is written
+// Codes go straight into the output bit stream, the encoder never holds them.
+struct GrowingWidth {
+    static const char* name() { return "growing"; }
+
+    class Writer {
+
+    public:
+        explicit Writer(std::vector<uint8_t>& output) : writer(output) {}
+
+        void put(int32_t code) {
+            width = widthAt(index++, width);
+            writer.write(static_cast<uint32_t>(code), width);
+        }
+
+        // The dictionary was cleared after the last code, widths start over
+        void reset() {
+            index = 0;
+            width = 8;
+        }
+
+        // The dictionary starts with 'entries' primed entries, so codes start wider
+        void prime(size_t entries) {
+            index = entries;
+        }
+
+        void finish(int32_t largestDictSize, BlockTrailer& trailer) {
+            writer.flush();
+            trailer.bitWidth = static_cast<int>(std::ceil(std::log2(largestDictSize)));
+            trailer.nbits = writer.bitCount();
+            trailer.flags |= BlockTrailer::GrowingWidth;
+        }
+
+    private:
+        BitWriter writer;
+        int width = 8; // Width of the previous code
+        size_t index = 0; // Codes written since the last dictionary reset
+    };
+
+    class Reader {
+
+    public:
+        Reader(const uint8_t* input, size_t size, const BlockTrailer& trailer, size_t epochLength)
+            : reader(input, size), nbits(trailer.nbits), epochLength(epochLength), index(trailer.flags & BlockTrailer::Primed ? trailer.primedEntries : 0) {}
+
+        bool next(int32_t& code) {
+            width = widthAt(index, width);
+            if (consumed + width > nbits) return false; // Only padding is left
+            code = static_cast<int32_t>(reader.read(width));
+            consumed += width;
+            if (++index == epochLength) {
+                index = 0;
+                width = 8;
+            }
+            return true;
+        }
+
+        // Fraction of the code stream consumed
+        double progress() const {
+            return nbits > 0 ? static_cast<double>(consumed) / nbits : 1.0;
+        }
+
+    private:
+        BitReader reader;
+        int64_t nbits; // Bits in the code stream
+        size_t epochLength; // Codes between dictionary resets, 0 if it never resets
+        int64_t consumed = 0; // Bits read so far
+        int width = 8; // Width of the previous code
+        size_t index; // Codes read since the last reset, plus the primed entries in the first epoch
+    };
+
+    // Width of the code at 'index' since the last reset: the bits needed for 255 + index,
+    // the largest code the dictionary can hold at that point
+    static int widthAt(size_t index, int width) {
+        while (((255 + index) >> width) != 0) ++width;
+        return width;
+    }
+};
+
+// Codes already held in memory (entropy coded blocks are decoded as a whole)
+class CodeVectorReader {
+
+public:
+    explicit CodeVectorReader(const std::vector<int32_t>& codes) : codes(codes) {}
+
+    bool next(int32_t& code) {
+        if (position == codes.size()) return false;
+        code = codes[position++];
+        return true;
+    }
+
+    // Fraction of the codes consumed
+    double progress() const {
+        return codes.empty() ? 1.0 : static_cast<double>(position) / codes.size();
+    }
+
+private:
+    const std::vector<int32_t>& codes;
+    size_t position = 0; // Next code to return
+};
+
+// Reset policies: decide when the dictionary is cleared
+
+// The dictionary grows for the whole block
+struct NoReset {
+    static const char* name() { return "none"; }
+
+    explicit NoReset(const EncodeOptions&) {}
+
+    bool isFull(int32_t) const { return false; }
+
+    // Entries priming may add
+    int32_t primeLimit() const { return std::numeric_limits<int32_t>::max() - 256; }
+};
+
+// The dictionary is cleared once it holds 2^maxCodeBits entries (16 bits unless configured)
+struct ResetWhenFull {
+    static const char* name() { return "full"; }
+
+    explicit ResetWhenFull(const EncodeOptions& options) {
+        int bits = options.maxCodeBits > 0 ? options.maxCodeBits : 16;
+        bits = bits < 9 ? 9 : (bits > 30 ? 30 : bits);
+        limit = static_cast<int32_t>(1) << bits;
+    }
+
+    bool isFull(int32_t dictSize) const { return dictSize >= limit; }
+
+    // Priming stops short of a full dictionary, leaving room for the block's first code
+    int32_t primeLimit() const { return limit - 257; }
+
+private:
+    int32_t limit; // Dictionary size that triggers a reset
+};
+
+// Priming: the dictionary learns the phrases of the previous block's tail before a block starts
+// Both sides parse the window as the encoder would, adding entries but emitting no codes,
+// so a primed block decodes given the same window.
+class DictionaryPrimer {
+
+public:
+    // Adds at most 'limit' entries from 'window' to 'dictionary' and tells 'added' each (prefix code, byte)
+    // Returns the number of entries added.
+    template <class Dictionary, class Added>
+    static int32_t prime(Dictionary& dictionary, const uint8_t* window, size_t size, int64_t limit, Added added) {
+        int32_t count = 0;
+        if (size == 0) return count;
+
+        int32_t current = window[0];
+        for (size_t i = 1; i < size && count < limit; ++i) {
+            int32_t next = dictionary.findOrInsert(current, window[i], 256 + count);
+            if (next >= 0) {
+                current = next;
+            }
+            else {
+                added(current, window[i]);
+                count++;
+                current = window[i];
+            }
+        }
+        return count;
+    }
+};
+
+// Long repeats: runs of one byte and copies of earlier data in the same block
+// The encoder finds them before coding and codes only the bytes between them. Each repeat becomes a token
+// [gap][length][distance] of varints in a table after the code stream ('gap' bytes coded since the previous
+// token, distance 0 a run followed by its byte), and the decoder fills them in with bulk copies.
+class RepeatCoder {
+
+public:
+    struct Token {
+        size_t position; // Offset of the repeat in the block
+        size_t length; // Bytes it covers
+        size_t distance; // How far back the copied data starts, 0 for a run
+        uint8_t byte; // Byte of a run
+    };
+
+    static const size_t minRun = 32; // Shortest run worth a token
+    static const size_t minMatch = 64; // Shortest copy worth a token
+    static const size_t window = 16 * 1024 * 1024; // Farthest a copy may reach back
+    static const size_t step = 8; // Positions indexed for copies: one in 'step' (copies of minMatch bytes still cover one)
+
+    // Finds the long runs and copies in 'input', in order and without overlaps
+    static void find(const uint8_t* input, size_t size, std::vector<Token>& tokens) {
+        tokens.clear();
+        if (size < minRun) return;
+
+        // Last indexed position (plus one) of each hash of 16 bytes
+        int bits = 10;
+        while (bits < 16 && (static_cast<size_t>(1) << bits) < size / step) ++bits;
+        std::vector<uint32_t> table(static_cast<size_t>(1) << bits, 0);
+
+        size_t covered = 0; // End of the last token
+        size_t i = 0;
+        while (i + 16 <= size) {
+            uint64_t first = load(input + i);
+            uint64_t second = load(input + i + 8);
+
+            // 16 equal bytes start a run
+            uint64_t run = 0x0101010101010101ull * input[i];
+            if (first == run && second == run) {
+                size_t end = i + 16;
+                while (end < size && input[end] == input[i]) ++end;
+                if (end - i >= minRun) {
+                    tokens.push_back({ i, end - i, 0, input[i] });
+                    covered = i = end;
+                    continue;
+                }
+            }
+
+            // The same 16 bytes at an indexed position start a copy
+            uint32_t& slot = table[static_cast<size_t>((first * 0x9E3779B97F4A7C15ull ^ second * 0xC2B2AE3D27D4EB4Full) >> (64 - bits))];
+            size_t candidate = slot;
+            if (i % step == 0) slot = static_cast<uint32_t>(i + 1);
+            if (candidate != 0 && i - (candidate - 1) <= window) {
+                size_t from = candidate - 1;
+                if (load(input + from) == first && load(input + from + 8) == second) {
+                    size_t length = 16;
+                    while (i + length + 8 <= size && load(input + from + length) == load(input + i + length)) length += 8;
+                    while (i + length < size && input[from + length] == input[i + length]) ++length;
+
+                    // Grow it back over bytes not yet covered
+                    size_t start = i;
+                    while (start > covered && from > 0 && input[start - 1] == input[from - 1]) {
+                        --start;
+                        --from;
+                    }
+                    length += i - start;
+
+                    if (length >= minMatch) {
+                        tokens.push_back({ start, length, start - from, 0 });
+                        covered = i = start + length;
+                        continue;
+                    }
+                }
+            }
+            ++i;
+        }
+    }
+
+    // Serializes 'tokens' as the repeat table of a block
+    static void write(const std::vector<Token>& tokens, std::vector<uint8_t>& table) {
+        table.clear();
+        size_t covered = 0;
+        for (const Token& token : tokens) {
+            putVarint(table, token.position - covered);
+            putVarint(table, token.length);
+            putVarint(table, token.distance);
+            if (token.distance == 0) table.push_back(token.byte);
+            covered = token.position + token.length;
+        }
+    }
+
+    // Fills in the repeats of a block while the decoder writes the coded bytes between them
+    class Player {
+
+    public:
+        // A block without repeats
+        Player() = default;
+
+        // 'table' is the block's repeat table; 'start' is where the block begins in the output
+        Player(const uint8_t* table, size_t size, size_t start) : position(table), end(table + size), start(start), due(start) {
+            advance();
+        }
+
+        // Output size at which the next repeat goes in
+        size_t next() const { return due; }
+
+        // Appends every repeat that starts at the end of 'output'
+        void play(std::vector<uint8_t>& output) {
+            while (due == output.size() && pending) {
+                if (token.distance == 0) {
+                    output.insert(output.end(), token.length, token.byte);
+                }
+                else {
+                    if (token.distance > output.size() - start) {
+                        throw std::runtime_error("Bad compressed block.");
+                    }
+
+                    // A copy may overlap itself; copying whole periods lets each pass double the span
+                    size_t to = output.size();
+                    size_t from = to - token.distance;
+                    output.resize(to + token.length);
+                    uint8_t* data = output.data();
+                    for (size_t done = 0; done < token.length;) {
+                        size_t chunk = std::min(token.length - done, token.distance + done);
+                        std::memcpy(data + to + done, data + from, chunk);
+                        done += chunk;
+                    }
+                }
+                due = output.size();
+                advance();
+            }
+        }
+
+        // True once every repeat was played
+        bool finished() const { return !pending; }
+
+    private:
+        const uint8_t* position = nullptr; // Next token in the table
+        const uint8_t* end = nullptr; // End of the table
+        size_t start = 0; // Output size when the block began
+        size_t due = std::numeric_limits<size_t>::max(); // Output size at which 'token' goes in
+        Token token{}; // Next repeat
+        bool pending = false; // 'token' is still to be played
+
+        // Reads the next token, if any
+        void advance() {
+            pending = position != end;
+            if (!pending) {
+                due = std::numeric_limits<size_t>::max();
+                return;
+            }
+            size_t gap = getVarint(position, end);
+            token.length = getVarint(position, end);
+            token.distance = getVarint(position, end);
+            if (token.distance == 0) {
+                if (position == end) throw std::runtime_error("Bad compressed block.");
+                token.byte = *position++;
+            }
+            if (token.length == 0 || token.length > maxLength || gap > maxLength) {
+                throw std::runtime_error("Bad compressed block.");
+            }
+            due += gap;
+        }
+    };
+
+private:
+    static const size_t maxLength = static_cast<size_t>(1) << 30; // Longest a block can be
+
+    static uint64_t load(const uint8_t* data) {
+        uint64_t value;
+        std::memcpy(&value, data, 8);
+        return value;
+    }
+
+    static void putVarint(std::vector<uint8_t>& output, size_t value) {
+        while (value >= 0x80) {
+            output.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        output.push_back(static_cast<uint8_t>(value));
+    }
+
+    static size_t getVarint(const uint8_t*& position, const uint8_t* end) {
+        size_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (position == end) break;
+            uint8_t byte = *position++;
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+        throw std::runtime_error("Bad compressed block.");
+    }
+};
+
+// Decoder shared by every encoder configuration
+// Blocks describe their width and reset policy in the trailer, so one decoder handles all of them.
+class LzwDecoder {
+
+public:
+    // Type definition for a progress callback function
+    using ProgressCallback = std::function<void(double)>;
+
+    // Memory of the decoder, kept between blocks by callers that decode many of them
+    struct Workspace {
+        std::vector<int32_t> prefix; // Dictionary entry each entry extends
+        std::vector<uint8_t> suffix; // Last byte of each entry
+        std::vector<uint8_t> firstByte; // First byte of each entry
+        std::vector<uint32_t> length; // Length of each entry
+        std::vector<uint8_t> payload; // Copy of an entropy coded stream (HuffmanCoder reads vectors)
+        std::vector<int32_t> codes; // Codes of an entropy coded stream
+        std::vector<uint8_t> filtered; // Decoded data of a filtered block, before BlockFilter::invert
+        HashDictionary primer; // Parses the priming window of primed blocks
+    };
+
+    // Primed blocks need the decoded previous block (at least its last trailer.primeWindow bytes) in 'prime'
+    static std::vector<uint8_t> decode(std::vector<uint8_t>& compressed, ProgressCallback progressCallback = nullptr, const uint8_t* prime = nullptr, size_t primeSize = 0) {
+        std::vector<uint8_t> output;
+        Workspace workspace;
+        size_t payloadSize = decodeInto(compressed.data(), compressed.size(), output, workspace, progressCallback, prime, primeSize);
+
+        // Resize to remove the metadata
+        compressed.resize(payloadSize);
+        return output;
+    }
+
+    // Receives every code the decoder reads; this one ignores them and compiles away
+    struct CodeObserver {
+        // 'code' expands to 'length' bytes; 'index' counts the codes since the last reset, plus the primed entries in the first epoch
+        void code(int32_t, uint32_t, size_t) {}
+    };
+
+    // Decodes the block in 'compressed' and appends the data to 'output'
+    // Returns the size of the block without its trailer.
+    static size_t decodeInto(const uint8_t* compressed, size_t size, std::vector<uint8_t>& output, Workspace& workspace, ProgressCallback progressCallback = nullptr, const uint8_t* prime = nullptr, size_t primeSize = 0) {
+        CodeObserver observer;
+        return decodeObserved(compressed, size, output, workspace, observer, progressCallback, prime, primeSize);
+    }
+
+    // Same as decodeInto, handing every code to 'observer' (see CodeObserver) as it is decoded
+    template <class Observer>
+    static size_t decodeObserved(const uint8_t* compressed, size_t size, std::vector<uint8_t>& output, Workspace& workspace, Observer& observer, ProgressCallback progressCallback = nullptr, const uint8_t* prime = nullptr, size_t primeSize = 0) {
+        // Extract bit-width, number of bits and block flags from the end
+        BlockTrailer trailer = BlockTrailer::read(compressed, size);
+        size_t payloadSize = size - trailer.size;
+
+        // Stored blocks hold the data as is
+        if (trailer.flags & BlockTrailer::Stored) {
+            output.insert(output.end(), compressed, compressed + payloadSize);
+            if (progressCallback) progressCallback(1.0);
+            return payloadSize;
+        }
+
+        // The priming window is the end of the previous block
+        Window window;
+        if (trailer.flags & BlockTrailer::Primed) {
+            if (!prime || primeSize < trailer.primeWindow) {
+                throw std::runtime_error("Block needs the end of the previous block.");
+            }
+            window.data = prime + primeSize - trailer.primeWindow;
+            window.size = trailer.primeWindow;
+            window.entries = trailer.primedEntries;
+        }
+
+        // A reset happens after every 2^bitWidth - 256 codes
+        size_t epochLength = 0;
+        if (trailer.flags & BlockTrailer::DictionaryReset) {
+            epochLength = (static_cast<size_t>(1) << trailer.bitWidth) - 256;
+        }
+
+        // Filtered blocks decode to a scratch buffer that the filters then turn back into the data
+        bool filtered = (trailer.flags & BlockTrailer::Filtered) != 0;
+        std::vector<uint8_t>& target = filtered ? workspace.filtered : output;
+        if (filtered) target.clear();
+
+        // Long repeats are filled in between the codes
+        RepeatCoder::Player repeats;
+        if (trailer.flags & BlockTrailer::Repeats) {
+            repeats = RepeatCoder::Player(compressed + payloadSize, trailer.repeatsSize, target.size());
+        }
+
+        // Codes are read from the bit stream as they are needed; only entropy coded blocks are expanded first
+        if (trailer.flags & BlockTrailer::EntropyCoded) {
+            workspace.payload.assign(compressed, compressed + payloadSize);
+            workspace.codes.clear();
+            HuffmanCoder::decode(workspace.payload, workspace.codes);
+            CodeVectorReader reader(workspace.codes);
+            decodeCodes(reader, epochLength, window, repeats, target, workspace, observer, progressCallback);
+        }
+        else if (trailer.flags & BlockTrailer::GrowingWidth) {
+            GrowingWidth::Reader reader(compressed, payloadSize, trailer, epochLength);
+            decodeCodes(reader, epochLength, window, repeats, target, workspace, observer, progressCallback);
+        }
+        else {
+            FinalWidth::Reader reader(compressed, payloadSize, trailer);
+            decodeCodes(reader, epochLength, window, repeats, target, workspace, observer, progressCallback);
+        }
+
+        if (filtered) {
+            BlockFilter::invert(target.data(), target.size(), trailer.filters, trailer.elementWidth, output);
+        }
+        return payloadSize;
+    }
+
+    // True when the block was primed and so needs the block before it to decode
+    static bool isPrimed(const uint8_t* compressed, size_t size) {
+        return (BlockTrailer::read(compressed, size).flags & BlockTrailer::Primed) != 0;
+    }
+
+private:
+    // Priming window of a block
+    struct Window {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        uint32_t entries = 0; // Entries the encoder added from it
+    };
+
+    // Rebuilds the data from the codes handed out by 'reader' and appends it to 'output'
+    template <class CodeReader, class Observer>
+    static void decodeCodes(CodeReader& reader, size_t epochLength, const Window& window, RepeatCoder::Player& repeats, std::vector<uint8_t>& output, Workspace& workspace, Observer& observer, ProgressCallback progressCallback) {
+        // Dictionary stored as arrays: every entry is an earlier entry ('prefix') plus one byte ('suffix')
+        std::vector<int32_t>& prefix = workspace.prefix;
+        std::vector<uint8_t>& suffix = workspace.suffix;
+        std::vector<uint8_t>& firstByte = workspace.firstByte;
+        std::vector<uint32_t>& length = workspace.length;
+        prefix.assign(256, -1);
+        suffix.resize(256);
+        firstByte.resize(256);
+        length.assign(256, 1);
+        for (int i = 0; i < 256; ++i) {
+            suffix[i] = static_cast<uint8_t>(i);
+            firstByte[i] = static_cast<uint8_t>(i);
+        }
+
+        // Entries the encoder learned from the previous block before this one started
+        if (window.entries > 0) {
+            workspace.primer.reset();
+            int32_t added = DictionaryPrimer::prime(workspace.primer, window.data, window.size, window.entries, [&](int32_t code, uint8_t byte) {
+                prefix.push_back(code);
+                suffix.push_back(byte);
+                firstByte.push_back(firstByte[code]);
+                length.push_back(length[code] + 1);
+            });
+            if (added != static_cast<int32_t>(window.entries)) {
+                throw std::runtime_error("Bad compressed block.");
+            }
+        }
+
+        int32_t previous = -1; // Previous code in the current epoch, -1 right after a reset
+        size_t index = window.entries; // Codes read since the last reset, plus the primed entries in the first epoch
+        int32_t code;
+        if (repeats.next() == output.size()) repeats.play(output);
+
+        // Report progress every 2^16 codes
+        for (size_t i = 0; reader.next(code); ++i) {
+            int32_t dictSize = static_cast<int32_t>(prefix.size());
+
+            if (previous >= 0) {
+                if (code > dictSize || code < 0) {
+                    throw std::runtime_error("Bad compressed code.");
+                }
+
+                // Add the previous sequence extended by the first byte of this one
+                // (when the code is the entry being added, that byte is the previous sequence's first)
+                prefix.push_back(previous);
+                suffix.push_back(code < dictSize ? firstByte[code] : firstByte[previous]);
+                firstByte.push_back(firstByte[previous]);
+                length.push_back(length[previous] + 1);
+            }
+            else if (code >= dictSize || code < 0) {
+                throw std::runtime_error("Bad compressed code.");
+            }
+
+            // Write the sequence back to front by following the prefix chain
+            size_t end = output.size() + length[code];
+            output.resize(end);
+            for (int32_t entry = code; entry >= 0; entry = prefix[entry]) {
+                output[--end] = suffix[entry];
+            }
+            previous = code;
+            observer.code(code, length[code], index);
+            if (repeats.next() == output.size()) repeats.play(output);
+
+            if (++index == epochLength) {
+                index = 0;
+                previous = -1;
+                prefix.resize(256);
+                suffix.resize(256);
+                firstByte.resize(256);
+                length.resize(256);
+            }
+
+            if ((i & 0xFFFF) == 0xFFFF) {
+                if (progressCallback) progressCallback(reader.progress()); // Report progress
+                Throttle::checkpoint(); // Let the throttle pace the worker
+            }
+        }
+
+        if (!repeats.finished()) {
+            throw std::runtime_error("Bad compressed block.");
+        }
+        if (progressCallback) progressCallback(1.0); // Report progress
+    }
+};
+
+// Lempel-Ziv-Welch algorithm, assembled at compile time from a dictionary, code width and reset policy
+template <class DictionaryPolicy, class CodeWidthPolicy, class ResetPolicy>
+class BasicLzw : public LzwDecoder {
+
+public:
+    static std::vector<uint8_t> encode(std::vector<uint8_t>& input, ProgressCallback progressCallback = nullptr, const EncodeOptions& options = EncodeOptions()) {
+        std::vector<uint8_t> compressedVec;
+        DictionaryPolicy dictionary;
+        encodeInto(input.data(), input.size(), compressedVec, dictionary, progressCallback, options);
+        return compressedVec;
+    }
+
+    // Encodes 'size' bytes into 'compressedVec', replacing its contents but keeping its memory
+    // The dictionary is reset first, so one instance can serve any number of blocks.
+    // A 'prime' window (the end of the previous block) primes the dictionary; the decoder then needs the same bytes.
+    static void encodeInto(const uint8_t* input, size_t size, std::vector<uint8_t>& compressedVec, DictionaryPolicy& dictionary, ProgressCallback progressCallback = nullptr, const EncodeOptions& options = EncodeOptions(), const uint8_t* prime = nullptr, size_t primeSize = 0) {
+        // Filters reshape the block first; the choice is recorded in the trailer
+        uint8_t filters = options.filters;
+        int elementWidth = options.elementWidth;
+        if (filters & BlockFilter::Auto) {
+            EncodeOptions plain = options;
+            plain.filters = 0;
+            plain.entropyCoding = false;
+            BlockFilter::choose(input, size, [&](const uint8_t* sample, size_t sampleSize) {
+                std::vector<uint8_t> encoded;
+                encodeInto(sample, sampleSize, encoded, dictionary, nullptr, plain);
+                return encoded.size();
+            }, filters, elementWidth);
+        }
+        std::vector<uint8_t> filtered;
+        if (filters != 0) {
+            BlockFilter::apply(input, size, filters, elementWidth, filtered);
+            input = filtered.data();
+            size = filtered.size();
+        }
+
+        dictionary.reset();
+        ResetPolicy resetPolicy(options);
+
+        int32_t dictSize = 256; // Standard dictionary size for single-byte values
+        int32_t largestDictSize = dictSize;
+        bool wasReset = false;
+
+        // Codes go to the width policy as they are found; the entropy stage needs all of them, so only then are they kept
+        compressedVec.clear();
+        typename CodeWidthPolicy::Writer writer(compressedVec);
+        std::vector<int32_t> codes;
+        auto emit = [&](int32_t code) {
+            writer.put(code);
+            if (options.entropyCoding) codes.push_back(code);
+        };
+
+        // Learn the phrases of the previous block's tail without emitting them
+        int32_t primedEntries = 0;
+        if (prime && primeSize > 0) {
+            primedEntries = DictionaryPrimer::prime(dictionary, prime, primeSize, resetPolicy.primeLimit(), [](int32_t, uint8_t) {});
+            dictSize += primedEntries;
+            largestDictSize = dictSize;
+            writer.prime(static_cast<size_t>(primedEntries));
+        }
+
+        // Long repeats go to the trailer; only the bytes between them are coded
+        std::vector<RepeatCoder::Token> repeats;
+        if (options.longRepeats) RepeatCoder::find(input, size, repeats);
+        size_t repeat = 0; // Next repeat to skip
+        size_t segmentEnd = size; // Start of that repeat
+        auto skip = [&](size_t position) {
+            while (repeat < repeats.size() && repeats[repeat].position == position) {
+                position += repeats[repeat++].length;
+            }
+            segmentEnd = repeat < repeats.size() ? repeats[repeat].position : size;
+            return position;
+        };
+
+        // Calculate interval for progress updates (1/3 of input length)
+        size_t interval = (size / 3);
+
+        size_t first = skip(0);
+        if (first < size) {
+            int32_t current = input[first]; // Code of the sequence matched so far
+
+            for (size_t i = first + 1; i < size; ++i) {
+                // A sequence never spans a repeat, but the entry for it is still added so both sides keep counting one per code
+                bool boundary = false;
+                if (i == segmentEnd) {
+                    i = skip(i);
+                    if (i == size) break;
+                    boundary = true;
+                }
+
+                uint8_t byte = input[i];
+                int32_t next = dictionary.findOrInsert(current, byte, dictSize);
+                if (next >= 0 && !boundary) {
+                    current = next; // The extended sequence is known, keep matching
+                }
+                else {
+                    // The extended sequence was just added: output the matched one and restart from this byte
+                    emit(current);
+                    if (resetPolicy.isFull(++dictSize)) {
+                        largestDictSize = dictSize;
+                        wasReset = true;
+                        dictionary.reset();
+                        writer.reset();
+                        dictSize = 256;
+                    }
+                    current = byte;
+                }
+
+                // Report progress periodically (every 1/3 of input length)
+                if (progressCallback && size >= 3 && i % interval == 0) {
+                    progressCallback(static_cast<double>(i) / size * .81); // Report progress 
+                }
+
+                // Let the throttle pace the worker every 64 KB
+                if ((i & 0xFFFF) == 0) Throttle::checkpoint();
+            }
+
+            // Output the last sequence
+            emit(current);
+        }
+        largestDictSize = largestDictSize > dictSize ? largestDictSize : dictSize;
+
+        // Finish the code stream
+        BlockTrailer trailer;
+        if (wasReset) {
+            trailer.flags |= BlockTrailer::DictionaryReset;
+        }
+        if (filters != 0) {
+            trailer.flags |= BlockTrailer::Filtered;
+            trailer.filters = filters;
+            trailer.elementWidth = static_cast<uint8_t>(elementWidth);
+        }
+        if (prime && primeSize > 0) {
+            trailer.flags |= BlockTrailer::Primed;
+            trailer.primeWindow = static_cast<uint32_t>(primeSize);
+            trailer.primedEntries = static_cast<uint32_t>(primedEntries);
+        }
+        if (!repeats.empty()) {
+            trailer.flags |= BlockTrailer::Repeats;
+            RepeatCoder::write(repeats, trailer.repeats);
+        }
+        writer.finish(largestDictSize, trailer);
+
+        // Entropy code the code stream instead when that makes the block smaller
+        if (options.entropyCoding) {
+            std::vector<uint8_t> entropyVec;
+            int64_t entropyBits = HuffmanCoder::encode(codes, entropyVec);
+            if (entropyVec.size() + 1 < compressedVec.size()) {
+                compressedVec.swap(entropyVec);
+                trailer.nbits = entropyBits;
+                trailer.flags |= BlockTrailer::EntropyCoded;
+            }
+        }
+
+        // Append the number of bits, the bit-width and the block flags as metadata
+        trailer.write(compressedVec);
+
+        if (progressCallback) progressCallback(1.0); // Report progress
+    }
+
+    // Name of the policy combination, e.g. "hash/final/none"
+    static std::string name() {
+        return std::string(DictionaryPolicy::name()) + "/" + CodeWidthPolicy::name() + "/" + ResetPolicy::name();
+    }
+};
+
+// Lempel-Ziv-Welch algorithm with the width and reset policy chosen at run time from EncodeOptions
+class LZW : public LzwDecoder {
+
+public:
+    static std::vector<uint8_t> encode(std::vector<uint8_t>& input, ProgressCallback progressCallback = nullptr, const EncodeOptions& options = EncodeOptions(), const uint8_t* prime = nullptr, size_t primeSize = 0) {
+        if (prime && primeSize > 0) {
+            std::vector<uint8_t> output;
+            HashDictionary dictionary;
+            encodeInto(input.data(), input.size(), output, dictionary, progressCallback, options, prime, primeSize);
+            return output;
+        }
+        if (options.maxCodeBits > 0) {
+            return options.growingWidth
+                ? BasicLzw<HashDictionary, GrowingWidth, ResetWhenFull>::encode(input, progressCallback, options)
+                : BasicLzw<HashDictionary, FinalWidth, ResetWhenFull>::encode(input, progressCallback, options);
+        }
+        return options.growingWidth
+            ? BasicLzw<HashDictionary, GrowingWidth, NoReset>::encode(input, progressCallback, options)
+            : BasicLzw<HashDictionary, FinalWidth, NoReset>::encode(input, progressCallback, options);
+    }
+
+    // Encodes into a caller-owned buffer with a caller-owned dictionary (see BasicLzw::encodeInto)
+    static void encodeInto(const uint8_t* input, size_t size, std::vector<uint8_t>& output, HashDictionary& dictionary, ProgressCallback progressCallback = nullptr, const EncodeOptions& options = EncodeOptions(), const uint8_t* prime = nullptr, size_t primeSize = 0) {
+        if (options.maxCodeBits > 0) {
+            if (options.growingWidth) BasicLzw<HashDictionary, GrowingWidth, ResetWhenFull>::encodeInto(input, size, output, dictionary, progressCallback, options, prime, primeSize);
+            else BasicLzw<HashDictionary, FinalWidth, ResetWhenFull>::encodeInto(input, size, output, dictionary, progressCallback, options, prime, primeSize);
+            return;
+        }
+        if (options.growingWidth) BasicLzw<HashDictionary, GrowingWidth, NoReset>::encodeInto(input, size, output, dictionary, progressCallback, options, prime, primeSize);
+        else BasicLzw<HashDictionary, FinalWidth, NoReset>::encodeInto(input, size, output, dictionary, progressCallback, options, prime, primeSize);
+    }
+
+    // Writes a stored block: the data as is, for when there is no time to encode it
+    static void store(const uint8_t* input, size_t size, std::vector<uint8_t>& output) {
+        output.assign(input, input + size);
+        BlockTrailer trailer;
+        trailer.flags = BlockTrailer::Stored;
+        trailer.write(output);
+    }
+
+    // Size of the priming window of block 'index' (ending at ends[index]), 0 when the block is not primed
+    // Every chain of options.primeChain blocks (or 'chains' chains over 'ends' when 0) starts with an unprimed block.
+    static size_t primeWindow(size_t index, const std::vector<size_t>& ends, const EncodeOptions& options, size_t chains) {
+        if (options.primeBytes == 0 || index == 0) return 0;
+        size_t chain = options.primeChain > 0 ? static_cast<size_t>(options.primeChain) : (ends.size() + chains - 1) / (chains > 0 ? chains : 1);
+        if (chain <= 1 || index % chain == 0) return 0;
+        size_t previous = ends[index - 1] - (index > 1 ? ends[index - 2] : 0);
+        return previous < options.primeBytes ? previous : options.primeBytes;
+    }
+};
+
+// Measures every dictionary, code width and reset policy combination on the same input
+class Benchmark {
+
+public:
+    struct Result {
+        std::string name; // Policy combination
+        size_t encodedSize; // Size of the encoded block in bytes
+        double encodeSeconds; // Time spent encoding
+        double decodeSeconds; // Time spent decoding
+    };
+
+    // Encodes and decodes the input with each combination, verifying the round trip
+    static std::vector<Result> runAll(const std::vector<uint8_t>& input, const EncodeOptions& options = EncodeOptions()) {
+        std::vector<Result> results;
+        runWidths<HashDictionary>(input, options, results);
+        runWidths<ArrayTrieDictionary>(input, options, results);
+        runWidths<DirectIndexedDictionary>(input, options, results);
+        return results;
+    }
+
+    // Formats the results as a table, one combination per line
+    static std::string drawResults(const std::vector<Result>& results, size_t inputSize) {
+        std::ostringstream oss;
+        oss << " " << std::left << std::setw(24) << "Policies" << std::setw(14) << "Size" << std::setw(9) << "Ratio"
+            << std::setw(16) << "Encode" << "Decode\n";
+        for (const Result& result : results) {
+            oss << " " << std::left << std::setw(24) << result.name
+                << std::setw(14) << GUI::drawSizeField(result.encodedSize)
+                << std::setw(9) << std::fixed << std::setprecision(4) << (inputSize ? static_cast<double>(result.encodedSize) / inputSize : 0.0)
+                << std::setw(16) << GUI::drawSpeed(inputSize, result.encodeSeconds)
+                << GUI::drawSpeed(inputSize, result.decodeSeconds) << "\n";
+        }
+        return oss.str();
+    }
+
+private:
+    template <class D>
+    static void runWidths(const std::vector<uint8_t>& input, const EncodeOptions& options, std::vector<Result>& results) {
+        runResets<D, FinalWidth>(input, options, results);
+        runResets<D, GrowingWidth>(input, options, results);
+    }
+
+    template <class D, class W>
+    static void runResets(const std::vector<uint8_t>& input, const EncodeOptions& options, std::vector<Result>& results) {
+        run<D, W, NoReset>(input, options, results);
+        run<D, W, ResetWhenFull>(input, options, results);
+    }
+
+    template <class D, class W, class R>
+    static void run(const std::vector<uint8_t>& input, const EncodeOptions& options, std::vector<Result>& results) {
+        using namespace std::chrono;
+        std::vector<uint8_t> source(input);
+
+        auto start = steady_clock::now();
+        std::vector<uint8_t> encoded = BasicLzw<D, W, R>::encode(source, nullptr, options);
+        auto encoded_at = steady_clock::now();
+
+        Result result;
+        result.name = BasicLzw<D, W, R>::name();
+        result.encodedSize = encoded.size();
+
+        std::vector<uint8_t> decoded = BasicLzw<D, W, R>::decode(encoded);
+        auto decoded_at = steady_clock::now();
+        if (decoded != input) {
+            throw std::runtime_error("Benchmark round trip failed for " + result.name + ".");
+        }
+
+        result.encodeSeconds = duration_cast<duration<double>>(encoded_at - start).count();
+        result.decodeSeconds = duration_cast<duration<double>>(decoded_at - encoded_at).count();
+        results.push_back(result);
+    }
+};
+
+// Settings of the sampling estimator
+struct EstimateOptions {
+    size_t sampleBlockSize = 256 * 1024; // Bytes per sampled block
+    double sampleFraction = 0.01; // Share of the input that is sampled
+    size_t minSamples = 8; // Fewest blocks sampled, whatever the fraction
+    double z = 1.96; // Normal quantile of the confidence bounds (1.96 for 95 %)
+    uint32_t seed = 1; // Seed of the sample positions, fixed so estimates are repeatable
+};
+
+// Predicts ratio, output size and wall time of a job by encoding a sample of its blocks
+// The input is cut into strata of equal size and one block is drawn at a random position in each,
+// so every region is represented. The ratio is the ratio estimator sum(out) / sum(in) with its
+// standard error (including the finite population correction); the time comes from the measured
+// single-thread throughput spread over the job's threads.
+// Samples are shorter than the job's blocks, so with a dictionary that never resets the ratio
+// leans pessimistic and the time optimistic (the job's larger dictionaries miss the cache more).
+class Estimator {
+
+public:
+    struct Estimate {
+        uint64_t inputSize = 0; // Bytes in the whole input
+        uint64_t sampledBytes = 0; // Bytes actually encoded
+        size_t samples = 0; // Number of sampled blocks
+        double ratio = 0, ratioLow = 0, ratioHigh = 0; // Encoded / input size and its bounds
+        double outputSize = 0, outputLow = 0, outputHigh = 0; // Predicted archive size in bytes
+        double seconds = 0, secondsLow = 0, secondsHigh = 0; // Predicted wall time of the encode
+        double sampleSeconds = 0; // Time spent producing the estimate
+    };
+
+    // Reads 'length' bytes at 'offset' of the input
+    using RangeReader = std::function<void(uint64_t offset, size_t length, std::vector<uint8_t>& data)>;
+
+    // Estimates a job over data already in memory
+    static Estimate estimate(const std::vector<uint8_t>& input, int threads, const EncodeOptions& options = EncodeOptions(), const EstimateOptions& estimateOptions = EstimateOptions()) {
+        return estimate(input.size(), [&input](uint64_t offset, size_t length, std::vector<uint8_t>& data) {
+            data.assign(input.begin() + static_cast<size_t>(offset), input.begin() + static_cast<size_t>(offset) + length);
+        }, threads, options, estimateOptions);
+    }
+
+    // Estimates a job over a file, reading only the sampled blocks
+    static Estimate estimateFile(const std::u32string& path, int threads, const EncodeOptions& options = EncodeOptions(), const EstimateOptions& estimateOptions = EstimateOptions()) {
+        IOBackend& io = IOBackend::getInstance();
+        return estimate(io.fileSize(path), [&io, &path](uint64_t offset, size_t length, std::vector<uint8_t>& data) {
+            io.readRange(path, offset, length, data);
+        }, threads, options, estimateOptions);
+    }
+
+    static Estimate estimate(uint64_t inputSize, const RangeReader& read, int threads, const EncodeOptions& options, const EstimateOptions& estimateOptions) {
+        using namespace std::chrono;
+        auto started = steady_clock::now();
+
+        Estimate result;
+        result.inputSize = inputSize;
+        if (inputSize == 0) return result;
+
+        // One stratum per sample; inputs smaller than the sample are encoded whole
+        size_t blockSize = static_cast<size_t>(inputSize < estimateOptions.sampleBlockSize ? inputSize : estimateOptions.sampleBlockSize);
+        uint64_t population = (inputSize + blockSize - 1) / blockSize; // Blocks the input could be cut into
+        uint64_t wanted = static_cast<uint64_t>(std::ceil(population * estimateOptions.sampleFraction));
+        wanted = wanted < estimateOptions.minSamples ? estimateOptions.minSamples : wanted;
+        wanted = wanted > population ? population : wanted;
+        uint64_t stratum = inputSize / wanted;
+
+        std::mt19937_64 random(estimateOptions.seed);
+        std::vector<double> inSizes, outSizes, seconds;
+        std::vector<uint8_t> block;
+        for (uint64_t i = 0; i < wanted; ++i) {
+            uint64_t first = i * stratum;
+            uint64_t span = (i + 1 == wanted ? inputSize : first + stratum) - first;
+            size_t length = static_cast<size_t>(span < blockSize ? span : blockSize);
+            uint64_t offset = first + (span > length ? random() % (span - length + 1) : 0);
+            read(offset, length, block);
+
+            auto start = steady_clock::now();
+            size_t encodedSize = LZW::encode(block, nullptr, options).size();
+            double elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+            inSizes.push_back(static_cast<double>(length));
+            outSizes.push_back(static_cast<double>(encodedSize));
+            seconds.push_back(elapsed);
+        }
+
+        result.samples = inSizes.size();
+        double sampledIn = std::accumulate(inSizes.begin(), inSizes.end(), 0.0);
+        double sampledOut = std::accumulate(outSizes.begin(), outSizes.end(), 0.0);
+        double sampledSeconds = std::accumulate(seconds.begin(), seconds.end(), 0.0);
+        result.sampledBytes = static_cast<uint64_t>(sampledIn);
+
+        // Ratio with its confidence bounds
+        double ratioMargin = margin(inSizes, outSizes, population, estimateOptions.z);
+        result.ratio = sampledOut / sampledIn;
+        result.ratioLow = std::max(0.0, result.ratio - ratioMargin);
+        result.ratioHigh = result.ratio + ratioMargin;
+        result.outputSize = result.ratio * inputSize;
+        result.outputLow = result.ratioLow * inputSize;
+        result.outputHigh = result.ratioHigh * inputSize;
+
+        // Wall time: seconds per byte on one thread, divided over the threads that can run at once
+        double secondsMargin = margin(inSizes, seconds, population, estimateOptions.z);
+        double secondsPerByte = sampledSeconds / sampledIn;
+        unsigned processors = std::thread::hardware_concurrency();
+        int running = threads > 0 ? threads : 1;
+        running = processors > 0 && static_cast<unsigned>(running) > processors ? static_cast<int>(processors) : running;
+        double parallel = static_cast<double>(running);
+        result.seconds = secondsPerByte * inputSize / parallel;
+        result.secondsLow = std::max(0.0, secondsPerByte - secondsMargin) * inputSize / parallel;
+        result.secondsHigh = (secondsPerByte + secondsMargin) * inputSize / parallel;
+
+        result.sampleSeconds = duration_cast<duration<double>>(steady_clock::now() - started).count();
+        return result;
+    }
+
+    // Formats the estimate for the console
+    static std::string drawEstimate(const Estimate& estimate) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(4)
+            << " Ratio   " << estimate.ratio << "  (" << estimate.ratioLow << " - " << estimate.ratioHigh << ")\n"
+            << " Output  " << GUI::drawSizeField(static_cast<size_t>(estimate.outputSize))
+            << "  (" << GUI::drawSizeField(static_cast<size_t>(estimate.outputLow)) << " - " << GUI::drawSizeField(static_cast<size_t>(estimate.outputHigh)) << ")\n"
+            << std::setprecision(2)
+            << " Time    " << estimate.seconds << " s  (" << estimate.secondsLow << " - " << estimate.secondsHigh << " s)\n"
+            << " Sample  " << estimate.samples << " blocks, " << GUI::drawSizeField(static_cast<size_t>(estimate.sampledBytes))
+            << " in " << estimate.sampleSeconds << " s\n";
+        return oss.str();
+    }
+
+private:
+    // Half-width of the confidence interval of sum(y) / sum(x) over a sample of 'population' units
+    static double margin(const std::vector<double>& x, const std::vector<double>& y, uint64_t population, double z) {
+        size_t n = x.size();
+        if (n < 2) return 0.0;
+
+        double ratio = std::accumulate(y.begin(), y.end(), 0.0) / std::accumulate(x.begin(), x.end(), 0.0);
+        double meanX = std::accumulate(x.begin(), x.end(), 0.0) / n;
+        double residuals = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double residual = y[i] - ratio * x[i];
+            residuals += residual * residual;
+        }
+
+        double variance = residuals / (n - 1) / (n * meanX * meanX);
+        double correction = population > n ? 1.0 - static_cast<double>(n) / population : 0.0;
+        return z * std::sqrt(variance * correction);
+    }
+};
+
+// Class to manage thread-safe access to shared resources using a mutex lock
+class SharedResource {
+
+public:
+#ifdef _WIN32
+    // Outputs a message to the console at a specific position
+    // Ensures that multiple threads do not write to the console simultaneously
+    // by acquiring a mutex lock before printing.
+    // This prevents interleaved or garbled output from concurrent threads.
+    // 
+    // Parameters:
+    // - message: The string message to be printed.
+    // - position: The console coordinates where the message will be displayed.
+    static void printMessage(const std::string& message, COORD position) {
+        // Lock the mutex to ensure exclusive access to the console output
+        std::lock_guard<std::mutex> guard(mutex_);
+        Cursor::goTo(position.X, position.Y); // Move cursor to the specified position
+        std::cout << message; // Print the message to the console
+    }
+#endif
+
+    // Reset the std::once_flag
+    static void resetOnceFlag() {
+        // Destroy the current once_flag and reinitialize it
+        flag_.~once_flag();             // Explicitly call destructor
+        new (&flag_) std::once_flag();  // Placement new to reconstruct the flag
+    }
+
+    // Static members to manage synchronization
+    static std::mutex mutex_;  // Mutex to control access to the shared resource
+    static std::once_flag flag_; // Flag for ensuring single-time initialization with std::call_once
+};
+// Static member definitions
+std::mutex SharedResource::mutex_; // Definition of the static mutex for controlling access
+std::once_flag SharedResource::flag_; // Definition of the static once_flag for one-time initialization
+
+#ifdef _WIN32
+// Singleton class to manage and track progress updates
+class ProgressTracker {
+
+public:
+    // Get the singleton instance of ProgressTracker
+    // Ensures that only one instance of ProgressTracker exists
+    static ProgressTracker& getInstance() {
+        static ProgressTracker instance; // Static instance for singleton pattern
+        return instance;
+    }
+
+    // Delete copy constructor and assignment operator to prevent copying
+    // Ensures that the singleton instance cannot be copied or assigned
+    ProgressTracker(const ProgressTracker&) = delete;
+    ProgressTracker& operator=(const ProgressTracker&) = delete;
+
+    // Start the progress tracking process
+    // Adds the current instance to the list of active trackers
+    // Ensures that progress can be updated if the tracker is running
+    void start() {
+        if (running) return;  // Exit if the tracker is already running
+
+        running = true;
+        std::lock_guard<std::mutex> lock(instancesMutex); // Lock to protect concurrent access
+        instances.push_back(this); // Add this instance to the list of active trackers
+    }
+
+    // Stop the progress tracking process
+    // Disables further progress updates
+    void stop() {
+        running = false;
+    }
+
+    // Update the displayed progress value
+    // Only updates if the tracker is currently running
+    // Displays a progress bar in the console at the location of the "Progress: " text
+    // 
+    // Parameters:
+    // - progress: A double value representing the current progress (0.0 to 1.0)
+    void updateProgress(double progress) {
+        if (!running) return;  // Only update if the tracker is running
+
+        COORD progressField = Cursor::findTextInConsole("Progress: "); // Find the location to update
+        SharedResource::printMessage(GUI::drawProgressBar(progress), progressField); // Update progress display
+    }
+
+    // Stop and clean up all active progress trackers
+    // Ensures that all trackers are stopped and removed from the list
+    // This method should be called to clean up before program exit or when trackers are no longer needed
+    static void shutdownAll() {
+        std::lock_guard<std::mutex> lock(instancesMutex); // Lock to protect concurrent access
+        for (auto* tracker : instances) {
+            tracker->stop(); // Stop each tracker
+        }
+        instances.clear(); // Clear the list of trackers
+    }
+
+    // Destructor
+    // Ensures proper cleanup of all active trackers when the instance is destroyed
+    ~ProgressTracker() {
+        shutdownAll(); // Clean up all trackers
+    }
+
+private:
+    ProgressTracker() : running(false) {} // Constructor initializes the tracker as not running
+    std::atomic<bool> running; // Atomic flag to indicate if the tracker is currently running
+
+    static std::vector<ProgressTracker*> instances; // Static list of active ProgressTracker instances
+    static std::mutex instancesMutex; // Mutex to synchronize access to the static list
+};
+// Static member definitions
+std::vector<ProgressTracker*> ProgressTracker::instances; // Define the static list of instances
+std::mutex ProgressTracker::instancesMutex; // Define the static mutex
+
+// Manages and tracks elapsed time in a separate thread
+class Timer {
+
+public:
+    // Constructor
+    // Initializes the timer and adds it to the static list of instances
+    Timer() : running(false), stop_thread(false) {
+        std::lock_guard<std::mutex> lock(instancesMutex); // Lock to ensure thread-safe access to static members
+        instances.push_back(this); // Add this instance to the list of active timers
+    }
+
+    // Destructor
+    // Ensures proper cleanup by stopping the timer and cleaning up resources
+    ~Timer() {
+        shutdown(); // Stop the timer if running
+    }
+
+    // Start the timer
+    // Begins tracking elapsed time in a new thread if not already running
+    void start() {
+        if (running) return; // Exit if the timer is already running
+
+        running = true;
+        timerThread = std::thread(&Timer::printElapsedTime, this); // Launch the timer thread
+    }
+
+    // Stop the timer
+    // Stops the elapsed time tracking and joins the timer thread
+    void stop() {
+        running = false; // Stop the timer thread from running
+        if (timerThread.joinable()) {
+            timerThread.join(); // Wait for the timer thread to finish
+        }
+    }
+
+    // Restart the timer
+    // Stops the current timer and starts a new one
+    void restart() {
+        stop(); // Stop the current timer
+        start(); // Start a new timer
+    }
+
+    // Shutdown the timer
+    // Alias for stop, to stop the timer and clean up resources
+    void shutdown() {
+        stop(); // Stop the timer and wait for the thread to join
+    }
+
+    // Stop and clean up all active timers
+    // Sets the stop flag and stops each timer, then clears the list of timers
+    static void shutdownAll() {
+        std::lock_guard<std::mutex> lock(instancesMutex); // Lock to ensure thread-safe access
+        for (auto* timer : instances) {
+            timer->stop_thread = true; // Signal all timers to stop
+            timer->stop(); // Stop the timer
+        }
+        instances.clear(); // Clear the list of active timers
+    }
+
+    // Getter for the duration in seconds
+    long getDuration() const {
+        return duration;
+    }
+
+private:
+    std::atomic<bool> running; // Flag to indicate if the timer is running
+    std::atomic<bool> stop_thread; // Flag to signal the timer thread to stop
+    std::thread timerThread; // Thread for tracking elapsed time
+    static std::vector<Timer*> instances; // Static list of active Timer instances
+    static std::mutex instancesMutex; // Mutex to synchronize access to the list of instances
+    std::atomic<long> duration; // Variable to store the duration in seconds
+
+    // Function executed by the timer thread to track and display elapsed time
+    void printElapsedTime() {
+        using namespace std::chrono;
+        auto start = steady_clock::now(); // Record the start time
+
+        while (running && !stop_thread) {
+            auto now = steady_clock::now(); // Get the current time
+            auto elapsed = duration_cast<seconds>(now - start).count(); // Calculate elapsed time in seconds
+
+            // Find the location in the console to display the time
+            COORD sizeFieldCoord = Cursor::findTextInConsole("Time: ");
+
+            // Format the elapsed time as HH:MM:SS
+            std::ostringstream oss;
+            oss << std::setw(2) << std::setfill('0') << elapsed / 3600 << ":"        // Hours
+                << std::setw(2) << std::setfill('0') << (elapsed % 3600) / 60 << ":" // Minutes
+                << std::setw(2) << std::setfill('0') << elapsed % 60;                // Seconds
+
+            std::string formattedTime = oss.str(); // Get the formatted time string
+            SharedResource::printMessage(formattedTime, sizeFieldCoord); // Update the console display
+
+            std::this_thread::sleep_for(seconds(1)); // Wait for one second before updating again
+        }
+        duration = duration_cast<seconds>(steady_clock::now() - start).count() - 1; // Calculate elapsed time in milliseconds ( -1 to remove the last second of sleep)
+    }
+};
+// Static member definitions for Timer
+std::vector<Timer*> Timer::instances; // Initialize the static list of Timer instances
+std::mutex Timer::instancesMutex; // Initialize the static mutex for synchronizing access to the list
+#endif
+
+// Manages exception handling and error behavior
+class ExceptionHandler {
+
+public:
+    // Handles exceptions by logging the error and performing necessary cleanups
+    static void ExceptionHandle(const std::exception& e) {
+        // Ensure that error handling occurs only once to avoid redundant outputs
+        std::call_once(SharedResource::flag_, [&]() {
+            // Lock to ensure thread-safe access to shared resources
+            std::lock_guard<std::mutex> guard(SharedResource::mutex_);
+
+#ifdef _WIN32
+            if (interactive()) {
+                // Get the current cursor position and move to a new line for error output
+                COORD pos = Cursor::getLastConsoleChar();
+                Cursor::goTo(0, pos.Y + 2);
+
+                // Convert exception message to a Unicode string and print it at the console
+                Cursor::writeOutputStream(Utility::stringToU32String(e.what()), 58, errorCallback());
+
+                // Shut down all active timers and progress trackers
+                Timer::shutdownAll();
+                ProgressTracker::shutdownAll();
+
+                // Pause the cursor to stop any further console updates
+                Cursor::pause();
+                return;
+            }
+#endif
+            // Without the console screens the error goes to the standard error stream
+            std::cerr << "Error: " << e.what() << "\n";
+            });
+    }
+
+    // True while the console screens are in use: errors are shown there and the job carries on to them
+    // Otherwise (command line, daemon, library) a failing block fails the whole call.
+    static bool& interactive() {
+        static bool value = false;
+        return value;
+    }
+
+    // Configures settings to suppress assertion pop-ups in debug builds
+    static void DisableAssertionPopups() {
+#ifdef _WIN32
+        // Set a custom report hook to handle CRT reports
+        _CrtSetReportHook(CustomReportHook);
+
+        // Set report modes to redirect CRT assertions and errors to a file instead of showing pop-ups
+        _CrtSetReportMode(_CRT_ASSERT, _CRTDBG_MODE_FILE);
+        _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
+        _CrtSetReportMode(_CRT_WARN, _CRTDBG_MODE_FILE);
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    // Custom report hook function to handle CRT reports
+    static int CustomReportHook(int reportType, char* message, int* returnValue) {
+        // Create an exception from the report message and handle it
+        std::exception e(message);
+        ExceptionHandle(e);
+
+        return 1; // Return 1 to indicate that the report was handled
+    }
+
+    // Creates a callback function to update the console display with error information
+    static std::function<void()> errorCallback() {
+        // Get the current end position of the console and move to a new line
+        COORD endOfConsole = Cursor::getLastConsoleChar();
+        Cursor::goTo(0, endOfConsole.Y + 1);
+
+        // Draw an error screen to provide visual feedback on the error
+        std::cout << GUI::drawErrorScreen();
+
+        // Locate the error field in the console and move the cursor to it
+        COORD errorField = Cursor::findTextInConsole("Error: ");
+        Cursor::goTo(errorField.X, errorField.Y);
+
+        // Define a lambda function to update the console display for the output field
+        auto lineChangeCallbackOutput = []() {
+            std::string screenUpdate = {
+                    "\n |                                                                  |"
+                    "\n \\__________________________________________________________________/"
+            };
+            std::cout << screenUpdate; // Output the update to the console
+        };
+
+        return lineChangeCallbackOutput; // Return the lambda function as the callback
+    }
+#endif
+};
+
+// Options for placing worker threads on processors and NUMA nodes
+struct ParallelOptions {
+    bool numaAware = true; // Spread workers over NUMA nodes, keep them on their node and queue blocks per node
+    bool pinWorkers = false; // Bind every worker to a single logical processor
+    uint64_t affinityMask = 0; // Logical processors workers may use (bit i = processor i), 0 allows all
+};
+
+// Logical processors grouped by NUMA node
+class Topology {
+
+public:
+    // Returns the topology of this machine, discovered on first use
+    static const Topology& getInstance() {
+        static Topology instance; // Static instance for singleton pattern
+        return instance;
+    }
+
+    Topology(const Topology&) = delete;
+    Topology& operator=(const Topology&) = delete;
+
+    int nodeCount() const {
+        return static_cast<int>(nodes.size());
+    }
+
+    // Number of logical processors
+    int processorCount() const {
+        size_t count = 0;
+        for (const std::vector<int>& node : nodes) count += node.size();
+        return static_cast<int>(count);
+    }
+
+    // Size in bytes of one data (or unified) cache of the given level (1-3), 0 if unknown
+    size_t cacheSize(int level) const {
+        return level >= 1 && level <= 3 ? caches[level] : 0;
+    }
+
+    // Logical processors of a node allowed by the mask (0 allows all) and by 'permitted' (see processAffinity, empty when unknown)
+    std::vector<int> processorsOf(int node, uint64_t affinityMask, const std::vector<int>& permitted) const {
+        std::vector<int> allowed;
+        for (int processor : nodes[node]) {
+            if (affinityMask != 0 && (processor >= 64 || !((affinityMask >> processor) & 1))) continue;
+            if (!permitted.empty() && !std::binary_search(permitted.begin(), permitted.end(), processor)) continue;
+            allowed.push_back(processor);
+        }
+        return allowed;
+    }
+
+    // Logical processors the calling thread may run on, sorted; empty when the system does not say
+    // Workers are bound within this set, so a job started under taskset or a restricted mask stays inside it.
+    static std::vector<int> processAffinity() {
+        std::vector<int> processors;
+#if defined(_WIN32)
+        GROUP_AFFINITY group;
+        DWORD_PTR processMask = 0, systemMask = 0;
+        if (GetThreadGroupAffinity(GetCurrentThread(), &group) && GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) && processMask != 0) {
+            for (int bit = 0; bit < 64; ++bit) {
+                if ((static_cast<uint64_t>(processMask) >> bit) & 1) processors.push_back(group.Group * 64 + bit);
+            }
+        }
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int processor = 0; processor < CPU_SETSIZE; ++processor) {
+                if (CPU_ISSET(processor, &set)) processors.push_back(processor);
+            }
+        }
+#endif
+        return processors;
+    }
+
+    // Restricts the calling thread to a set of logical processors
+    static bool bindCurrentThread(const std::vector<int>& processors) {
+        if (processors.empty()) return false;
+#if defined(_WIN32)
+        // A thread runs in one processor group, so bind to the processors of the first one
+        GROUP_AFFINITY affinity;
+        memset(&affinity, 0, sizeof(affinity));
+        affinity.Group = static_cast<WORD>(processors[0] / 64);
+        for (int processor : processors) {
+            if (processor / 64 == affinity.Group) affinity.Mask |= static_cast<KAFFINITY>(1) << (processor % 64);
+        }
+        return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int processor : processors) {
+            if (processor < CPU_SETSIZE) CPU_SET(processor, &set);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        return false;
+#endif
+    }
+
+private:
+    std::vector<std::vector<int>> nodes; // Logical processors of each node
+    size_t caches[4] = {}; // Cache size per level (index 1-3)
+
+    Topology() {
+        discoverCaches();
+
+#if defined(_WIN32)
+        ULONG highestNode = 0;
+        if (GetNumaHighestNodeNumber(&highestNode)) {
+            for (ULONG node = 0; node <= highestNode; ++node) {
+                GROUP_AFFINITY affinity;
+                if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)) continue;
+
+                std::vector<int> processors;
+                for (int bit = 0; bit < 64; ++bit) {
+                    if ((affinity.Mask >> bit) & 1) processors.push_back(affinity.Group * 64 + bit);
+                }
+                if (!processors.empty()) nodes.push_back(processors);
+            }
+        }
+#elif defined(__linux__)
+        for (int node = 0; ; ++node) {
+            std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!cpulist) break;
+
+            std::string list;
+            std::getline(cpulist, list);
+            std::vector<int> processors = parseProcessorList(list);
+            if (!processors.empty()) nodes.push_back(processors);
+        }
+#endif
+        // Without NUMA information, treat the machine as a single node
+        if (nodes.empty()) {
+            unsigned count = std::thread::hardware_concurrency();
+            nodes.push_back(std::vector<int>());
+            for (unsigned i = 0; i < (count ? count : 1); ++i) nodes[0].push_back(static_cast<int>(i));
+        }
+    }
+
+    // Reads the cache sizes of the first processor
+    void discoverCaches() {
+#if defined(_WIN32)
+        DWORD length = 0;
+        GetLogicalProcessorInformation(nullptr, &length);
+        std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+        if (info.empty() || !GetLogicalProcessorInformation(info.data(), &length)) return;
+
+        for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& entry : info) {
+            if (entry.Relationship != RelationCache || entry.Cache.Level < 1 || entry.Cache.Level > 3) continue;
+            if (entry.Cache.Type != CacheData && entry.Cache.Type != CacheUnified) continue;
+            caches[entry.Cache.Level] = entry.Cache.Size;
+        }
+#elif defined(__linux__)
+        for (int index = 0; ; ++index) {
+            std::string directory = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+            std::ifstream levelFile(directory + "level"), typeFile(directory + "type"), sizeFile(directory + "size");
+            if (!levelFile || !typeFile || !sizeFile) break;
+
+            int level = 0;
+            std::string type, size;
+            levelFile >> level;
+            typeFile >> type;
+            sizeFile >> size;
+            if (level < 1 || level > 3 || type == "Instruction" || size.empty()) continue;
+
+            // Sizes look like "48K" or "32M"
+            size_t bytes = std::stoul(size);
+            char unit = size.back();
+            bytes <<= unit == 'K' ? 10 : (unit == 'M' ? 20 : (unit == 'G' ? 30 : 0));
+            caches[level] = bytes;
+        }
+#endif
+    }
+
+    // Parses a Linux processor list such as "0-7,16-23"
+    static std::vector<int> parseProcessorList(const std::string& list) {
+        std::vector<int> processors;
+        std::istringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            if (range.empty()) continue;
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int processor = first; processor <= last; ++processor) processors.push_back(processor);
+        }
+        return processors;
+    }
+};
+
+// Fixed set of worker threads with one task queue per NUMA node
+// Workers take tasks from their own node's queue first and steal from other nodes when it runs dry.
+class WorkerPool {
+
+public:
+    WorkerPool(int threads, const ParallelOptions& options = ParallelOptions()) : pending(0), stopping(false) {
+        const Topology& topology = Topology::getInstance();
+        int nodes = options.numaAware ? topology.nodeCount() : 1;
+        queues.resize(nodes);
+        std::vector<int> permitted = Topology::processAffinity();
+
+        for (int i = 0; i < (threads > 0 ? threads : 1); ++i) {
+            int node = i % nodes; // Spread workers evenly over the nodes
+
+            // Processors this worker may run on: its node's share of the mask, or one of them when pinned
+            std::vector<int> processors;
+            if (options.numaAware || options.pinWorkers || options.affinityMask != 0) {
+                if (options.numaAware) {
+                    processors = topology.processorsOf(node, options.affinityMask, permitted);
+                }
+                else {
+                    for (int n = 0; n < topology.nodeCount(); ++n) {
+                        std::vector<int> nodeProcessors = topology.processorsOf(n, options.affinityMask, permitted);
+                        processors.insert(processors.end(), nodeProcessors.begin(), nodeProcessors.end());
+                    }
+                }
+                if (options.pinWorkers && !processors.empty()) {
+                    int processor = processors[(i / nodes) % processors.size()];
+                    processors.assign(1, processor);
+                }
+
+                // Binding to everything the thread may already use restricts nothing
+                std::sort(processors.begin(), processors.end());
+                if (!permitted.empty() && processors == permitted) processors.clear();
+            }
+
+            workers.emplace_back(&WorkerPool::run, this, node, processors);
+        }
+    }
+
+    // Waits for queued tasks and stops the workers
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskAvailable.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int nodeCount() const {
+        return static_cast<int>(queues.size());
+    }
+
+    int threadCount() const {
+        return static_cast<int>(workers.size());
+    }
+
+    // Queues a task on a node's queue (wrapped around the node count)
+    void submit(std::function<void()> task, int node = 0) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queues[node % queues.size()].push_back(std::move(task));
+            pending++;
+        }
+        taskAvailable.notify_all();
+    }
+
+    // Blocks until every submitted task has finished, rethrowing the first exception a task threw
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [this]() { return pending == 0; });
+
+        if (failure) {
+            std::exception_ptr error = failure;
+            failure = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Node of the calling worker thread, 0 outside the pool
+    static int currentNode() {
+        return workerNode();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::vector<std::deque<std::function<void()>>> queues; // One queue per NUMA node
+    std::mutex mutex; // Guards the queues and counters
+    std::condition_variable taskAvailable;
+    std::condition_variable allDone;
+    size_t pending; // Tasks queued or running
+    bool stopping;
+    std::exception_ptr failure; // First exception thrown by a task
+
+    static int& workerNode() {
+        static thread_local int node = 0;
+        return node;
+    }
+
+    // Worker loop: bind to the node's processors, then run tasks until the pool stops
+    void run(int node, std::vector<int> processors) {
+        workerNode() = node;
+        Topology::bindCurrentThread(processors);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            // Own node first, then the others in order
+            std::function<void()> task;
+            for (size_t i = 0; i < queues.size() && !task; ++i) {
+                auto& queue = queues[(node + i) % queues.size()];
+                if (!queue.empty()) {
+                    task = std::move(queue.front());
+                    queue.pop_front();
+                }
+            }
+
+            if (!task) {
+                if (stopping) return;
+                taskAvailable.wait(lock);
+                continue;
+            }
+
+            lock.unlock();
+            try {
+                Throttle::Turn turn(Throttle::getInstance()); // Waits for a free slot; the task idles for the duty cycle at its checkpoints
+                task();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (!failure) failure = std::current_exception();
+            }
+            lock.lock();
+
+            if (--pending == 0) allDone.notify_all();
+        }
+    }
+};
+
+// Checksums for archive metadata and block contents
+class Checksum {
+
+public:
+    // CRC-32 (IEEE 802.3, reflected), continuing from a previous value when 'crc' is given
+    static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+        static const std::vector<uint32_t> table = makeTable();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    // Fast non-cryptographic 128-bit hash (two multiply-rotate lanes over 8-byte words), for cache keys
+    static std::array<uint64_t, 2> fastHash(const uint8_t* data, size_t size) {
+        const uint64_t prime1 = 0x87C37B91114253D5ULL;
+        const uint64_t prime2 = 0x4CF5AD432745937FULL;
+        uint64_t low = 0x9E3779B97F4A7C15ULL ^ size;
+        uint64_t high = 0xC2B2AE3D27D4EB4FULL ^ (static_cast<uint64_t>(size) << 1);
+
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            low = rotateLeft(low ^ (rotateLeft(word * prime1, 31) * prime2), 27) * 5 + 0x52DCE729;
+            high = rotateLeft(high ^ (rotateLeft(word * prime2, 33) * prime1), 31) * 5 + 0x38495AB5;
+        }
+        uint64_t tail = 0;
+        for (size_t shift = 0; i < size; ++i, shift += 8) {
+            tail |= static_cast<uint64_t>(data[i]) << shift;
+        }
+        low ^= rotateLeft(tail * prime1, 31) * prime2;
+        high ^= rotateLeft(tail * prime2, 33) * prime1;
+
+        low += high;
+        high += low;
+        return { { mix(low), mix(high) } };
+    }
+
+    using Digest = std::array<uint8_t, 32>;
+
+    // SHA-256 (FIPS 180-4), used to recognise identical blocks
+    static Digest sha256(const uint8_t* data, size_t size) {
+        static const uint32_t k[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+        uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+        // Whole 64-byte blocks straight from the input, then the padded remainder
+        size_t wholeBlocks = size / 64;
+        for (size_t i = 0; i < wholeBlocks; ++i) {
+            sha256Block(state, data + i * 64, k);
+        }
+
+        uint8_t last[128] = {};
+        size_t remainder = size - wholeBlocks * 64;
+        if (remainder > 0) memcpy(last, data + wholeBlocks * 64, remainder);
+        last[remainder] = 0x80;
+        size_t lastSize = remainder < 56 ? 64 : 128;
+        uint64_t bitLength = static_cast<uint64_t>(size) * 8;
+        for (int i = 0; i < 8; ++i) {
+            last[lastSize - 1 - i] = static_cast<uint8_t>(bitLength >> (8 * i));
+        }
+        for (size_t offset = 0; offset < lastSize; offset += 64) {
+            sha256Block(state, last + offset, k);
+        }
+
+        Digest digest;
+        for (int i = 0; i < 32; ++i) {
+            digest[i] = static_cast<uint8_t>(state[i / 4] >> (24 - 8 * (i % 4)));
+        }
+        return digest;
+    }
+
+private:
+    static uint64_t rotateLeft(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // Final avalanche of a 64-bit lane
+    static uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDULL;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ULL;
+        return value ^ (value >> 33);
+    }
+
+    static uint32_t rotateRight(uint32_t value, int bits) {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    // Compresses one 64-byte block into the SHA-256 state
+    static void sha256Block(uint32_t* state, const uint8_t* block, const uint32_t* k) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t(block[4 * i]) << 24) | (uint32_t(block[4 * i + 1]) << 16) | (uint32_t(block[4 * i + 2]) << 8) | block[4 * i + 3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+    static std::vector<uint32_t> makeTable() {
+        std::vector<uint32_t> table(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            }
+            table[i] = value;
+        }
+        return table;
+    }
+};
+
+// Bloom filter of the 4-byte sequences of a block, kept in the archive index so searches can skip blocks
+// A pattern can only occur in a block whose filter has the bits of all its sequences. Each sequence sets
+// one bit; the filter starts with room for every sequence and is folded in half while it stays at most half full.
+// The first and last bytes of the block come with it, so matches crossing a boundary can be ruled out exactly.
+class SearchFilter {
+
+public:
+    static const size_t sequence = 4; // Bytes per hashed sequence; shorter patterns never rule a block out
+    static const size_t edgeBytes = 32; // Bytes kept from each end of the block
+
+    // Filter of 'size' bytes: [log2 of the bit count 1B][edge length 1B][first bytes][last bytes][bits, 8 per byte]
+    static std::vector<uint8_t> build(const uint8_t* data, size_t size) {
+        int bits = minBits;
+        while (bits < maxBits && (static_cast<size_t>(1) << bits) < size * 2) ++bits;
+        std::vector<uint64_t> words(static_cast<size_t>(1) << (bits - 6), 0);
+        uint64_t mask = (static_cast<uint64_t>(1) << bits) - 1;
+        for (size_t i = 0; i + sequence <= size; ++i) {
+            uint64_t bit = hash(data + i) & mask;
+            words[bit >> 6] |= static_cast<uint64_t>(1) << (bit & 63);
+        }
+
+        // Halve the filter while the folded one would be at most half full
+        while (bits > minBits) {
+            size_t half = words.size() / 2;
+            size_t set = 0;
+            for (size_t i = 0; i < half; ++i) set += std::bitset<64>(words[i] | words[i + half]).count();
+            if (set * 2 > half * 64) break;
+            for (size_t i = 0; i < half; ++i) words[i] |= words[i + half];
+            words.resize(half);
+            --bits;
+        }
+
+        size_t edge = std::min(size, edgeBytes);
+        std::vector<uint8_t> filter;
+        filter.push_back(static_cast<uint8_t>(bits));
+        filter.push_back(static_cast<uint8_t>(edge));
+        filter.insert(filter.end(), data, data + edge);
+        filter.insert(filter.end(), data + size - edge, data + size);
+        for (uint64_t word : words) {
+            for (int shift = 0; shift < 64; shift += 8) filter.push_back(static_cast<uint8_t>(word >> shift));
+        }
+        return filter;
+    }
+
+    // False when 'pattern' cannot occur in the block of 'filter'; an empty or unknown filter rules nothing out
+    static bool mayContain(const std::vector<uint8_t>& filter, const uint8_t* pattern, size_t size) {
+        if (!isValid(filter)) return true;
+        int bits = filter[0];
+        const uint8_t* set = filter.data() + 2 + 2 * filter[1];
+        uint64_t mask = (static_cast<uint64_t>(1) << bits) - 1;
+        for (size_t i = 0; i + sequence <= size; ++i) {
+            uint64_t bit = hash(pattern + i) & mask;
+            if ((set[bit >> 3] & (1 << (bit & 7))) == 0) return false;
+        }
+        return true;
+    }
+
+    // First ('last' false) or last bytes of the block, all of it when it is at most edgeBytes long; empty for an unknown filter
+    static std::vector<uint8_t> edge(const std::vector<uint8_t>& filter, bool last) {
+        if (!isValid(filter)) return {};
+        const uint8_t* begin = filter.data() + 2 + (last ? filter[1] : 0);
+        return std::vector<uint8_t>(begin, begin + filter[1]);
+    }
+
+    // Whether 'filter' has the layout build writes
+    static bool isValid(const std::vector<uint8_t>& filter) {
+        if (filter.size() < 2 || filter[0] < minBits || filter[0] > maxBits) return false;
+        return filter.size() == 2 + 2 * static_cast<size_t>(filter[1]) + (static_cast<size_t>(1) << (filter[0] - 3));
+    }
+
+private:
+    static const int minBits = 10; // Smallest filter, 128 bytes
+    static const int maxBits = 24; // Largest filter, 2 MB
+
+    static uint64_t hash(const uint8_t* data) {
+        uint64_t value = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint64_t>(data[3]) << 24); // The same on every host
+        return (value * 0x9E3779B97F4A7C15ull) >> 32;
+    }
+};
+
+// Options for choosing block boundaries
+struct ChunkingOptions {
+    bool contentDefined = false; // Cut blocks where the content says so and store repeated blocks once
+    size_t blockSize = 0; // Size of fixed blocks, 0 cuts the input into one block per thread
+    size_t minSize = 16 * 1024; // Smallest content-defined block
+    size_t averageSize = 64 * 1024; // Typical content-defined block
+    size_t maxSize = 256 * 1024; // Largest content-defined block
+};
+
+// Splits data into blocks at positions chosen by a rolling (gear) hash of the preceding bytes
+// Boundaries depend only on nearby content, so an insertion moves the boundaries around it and
+// identical regions anywhere in the data produce identical blocks
+class ContentChunker {
+
+public:
+    // Returns the end offset of every block
+    static std::vector<size_t> split(const uint8_t* data, size_t size, const ChunkingOptions& options) {
+        return splitWith([data](size_t position) { return data[position]; }, size, options);
+    }
+
+    // Same for data held in fragments; the boundaries do not depend on where the fragments end
+    static std::vector<size_t> split(const InputSpans& input, const ChunkingOptions& options) {
+        if (const uint8_t* data = input.contiguous(0, input.size())) return split(data, input.size(), options);
+        return splitWith(InputSpans::Cursor(input), input.size(), options);
+    }
+
+private:
+    // Cuts 'size' bytes read through 'byteAt' (called with increasing positions)
+    template <class ByteAt>
+    static std::vector<size_t> splitWith(ByteAt byteAt, size_t size, const ChunkingOptions& options) {
+        const std::vector<uint64_t>& gear = gearTable();
+        size_t minSize = options.minSize > 0 ? options.minSize : 1;
+        size_t maxSize = options.maxSize > minSize ? options.maxSize : minSize;
+
+        // A boundary is expected every 2^bits bytes after the minimum size
+        size_t spread = options.averageSize > minSize ? options.averageSize - minSize : 1;
+        int bits = 0;
+        while ((size_t(2) << bits) <= spread && bits < 40) bits++;
+        const uint64_t mask = bits > 0 ? ~uint64_t(0) << (64 - bits) : 0;
+
+        std::vector<size_t> ends;
+        size_t start = 0;
+        while (start < size) {
+            size_t limit = size - start < maxSize ? size : start + maxSize;
+            size_t position = size - start <= minSize ? size : start + minSize;
+            uint64_t hash = 0;
+
+            // The top bits of the hash depend on the last 64 bytes only
+            for (; position < limit; ++position) {
+                hash = (hash << 1) + gear[byteAt(position)];
+                if ((hash & mask) == 0) {
+                    ++position;
+                    break;
+                }
+            }
+
+            ends.push_back(position);
+            start = position;
+        }
+        return ends;
+    }
+
+    // Fixed pseudo-random value per byte (splitmix64), the same in every build
+    static const std::vector<uint64_t>& gearTable() {
+        static const std::vector<uint64_t> table = []() {
+            std::vector<uint64_t> values(256);
+            uint64_t seed = 0x4C5A57707047656FULL;
+            for (uint64_t& value : values) {
+                uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                value = z ^ (z >> 31);
+            }
+            return values;
+        }();
+        return table;
+    }
+};
+
+// Container of encoded blocks with an index at the end of the file
+// Layout: [block]...[block][index][index size 4B][index CRC-32 4B][magic 4B]
+// Index: [version 1B][extension length 2B][extension][entry size 1B][block count 4B][entries]
+// Entry: [file offset 8B][encoded size 4B][decoded size 4B], then optionally [SHA-256 32B] when blocks
+// were hashed, then [CRC-32 4B][flags 1B] when decoded blocks carry a checksum
+// Entries of repeated blocks point at the same encoded bytes
+// Appends write new blocks and a new index after the current tail, so a crash leaves the old
+// index intact; readers use the last tail whose CRC checks out. Archives written before the
+// index existed ([blocks][sizes 4B each][count 1B][extension]) are still read.
+class Archive {
+
+public:
+    struct Entry {
+        uint64_t offset = 0; // Position of the encoded block in the file
+        uint32_t size = 0; // Encoded size in bytes
+        uint32_t rawSize = 0; // Decoded size in bytes (0 when unknown, in old archives)
+        Checksum::Digest hash{}; // SHA-256 of the decoded block, all zero when not hashed
+        uint32_t crc = 0; // CRC-32 of the decoded block
+        bool hasCrc = false; // Whether 'crc' was stored (archives before checksums lack it)
+        std::vector<uint8_t> filter; // SearchFilter of the decoded block, empty when none was stored
+    };
+
+    // Encoded block ready to be stored
+    struct Block {
+        std::vector<uint8_t> data; // Encoded bytes, empty for a duplicate
+        size_t rawSize = 0; // Decoded size in bytes
+        Checksum::Digest hash{}; // SHA-256 of the decoded block, all zero when not hashed
+        int64_t duplicateOf = -1; // Index entry already holding the same content, or -1
+        uint32_t crc = 0; // CRC-32 of the decoded block
+        std::vector<uint8_t> filter; // SearchFilter of the decoded block, empty for none
+    };
+
+    struct Index {
+        std::vector<uint8_t> extension; // Extension of the original file, including the dot
+        std::vector<Entry> entries; // Blocks in the order of the original data
+        uint64_t end = 0; // File offset just past the index tail, where appends start
+        bool legacy = false; // Archive predates the index
+    };
+
+    static const size_t tailSize = 12;
+    static const size_t maxBlockSize = LZW_MAX_BLOCK_SIZE; // Largest block cut by default; index entries hold 32-bit sizes
+
+    // Builds a complete archive from encoded blocks
+    static std::vector<uint8_t> build(const std::vector<Block>& blocks, const std::vector<uint8_t>& extension) {
+        std::vector<uint8_t> archive;
+        Index index;
+        index.extension = extension;
+        archive.reserve(buildBound(blocks, extension));
+        addBlocks(archive, 0, blocks, index);
+        Utility::appendVector(archive, serialize(index));
+        return archive;
+    }
+
+    // Same, freeing each block once it is copied so the encoded data is never held twice
+    static std::vector<uint8_t> build(std::vector<Block>&& blocks, const std::vector<uint8_t>& extension) {
+        std::vector<uint8_t> archive;
+        Index index;
+        index.extension = extension;
+        archive.reserve(buildBound(blocks, extension)); // Never reallocated, which would hold the data twice after all
+        for (Block& block : blocks) {
+            addBlock(archive, 0, block, index);
+            std::vector<uint8_t>().swap(block.data);
+        }
+        Utility::appendVector(archive, serialize(index));
+        return archive;
+    }
+
+    // Reads the index of an archive held in memory
+    static Index readIndex(const std::vector<uint8_t>& data) {
+        return readIndex(data.data(), data.size());
+    }
+
+    static Index readIndex(const uint8_t* data, size_t size) {
+        Index index;
+
+        // Fast path: the file ends with a valid tail
+        if (parseAt(data, size, size, index)) return index;
+
+        // An interrupted append leaves a partial write after the last good tail: look for it
+        for (size_t end = size; end >= tailSize; --end) {
+            if (memcmp(data + end - 4, magic(), 4) == 0 && parseAt(data, size, end, index)) {
+                return index;
+            }
+        }
+
+        if (!parseLegacy(data, size, 0, index)) {
+            throw std::runtime_error("Bad compressed file.");
+        }
+        return index;
+    }
+
+    // Appends encoded blocks to an archive file, reading only its index
+    // Duplicates may refer to entries already in the archive
+    static void append(const std::u32string& path, const std::vector<Block>& blocks) {
+        IOBackend& io = IOBackend::getInstance();
+        Index index = readIndexFromFile(path);
+
+        // New blocks and the new index go after the current tail, leaving everything before it untouched
+        std::vector<uint8_t> appended;
+        addBlocks(appended, index.end, blocks, index);
+        Utility::appendVector(appended, serialize(index));
+        io.writeAt(path, index.end, appended);
+    }
+
+    // Reads the index of an archive file without loading its blocks
+    static Index readIndexFromFile(const std::u32string& path) {
+        IOBackend& io = IOBackend::getInstance();
+        uint64_t fileSize = io.fileSize(path);
+        Index index;
+
+        if (fileSize >= tailSize) {
+            std::vector<uint8_t> tail;
+            io.readRange(path, fileSize - tailSize, tailSize, tail);
+            uint32_t indexSize = static_cast<uint32_t>(readLE(tail.data(), 4));
+
+            if (memcmp(tail.data() + 8, magic(), 4) == 0 && indexSize + tailSize <= fileSize) {
+                std::vector<uint8_t> region;
+                io.readRange(path, fileSize - tailSize - indexSize, indexSize + tailSize, region);
+                if (parseAt(region.data(), region.size(), region.size(), index, fileSize - region.size())) {
+                    return index;
+                }
+            }
+        }
+
+        // Old archives keep their chunk sizes and extension in the last few kilobytes
+        size_t regionSize = static_cast<size_t>(fileSize < legacyTailRegion ? fileSize : legacyTailRegion);
+        std::vector<uint8_t> region;
+        io.readRange(path, fileSize - regionSize, regionSize, region);
+        if (parseLegacy(region.data(), region.size(), fileSize - regionSize, index)) return index;
+
+        // Damaged tail after an interrupted append: fall back to scanning the whole file
+        std::vector<uint8_t> data;
+        io.readFile(path, data);
+        return readIndex(data);
+    }
+
+    // Index and tail that close an archive whose blocks are already written
+    static std::vector<uint8_t> indexBytes(const Index& index) {
+        return serialize(index);
+    }
+
+    // Size of the index and tail for 'count' checked entries and an extension of 'extensionSize' bytes
+    static size_t indexSize(size_t count, size_t extensionSize) {
+        return 8 + extensionSize + count * checkedEntrySize + tailSize;
+    }
+
+    // Little-endian integer helpers
+    static void writeLE(std::vector<uint8_t>& output, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) output.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    static uint64_t readLE(const uint8_t* data, int bytes) {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(data[i]) << (8 * i);
+        return value;
+    }
+
+private:
+    static const uint8_t version = 1;
+    static const size_t entrySize = 16;
+    static const size_t hashedEntrySize = 48;
+    static const size_t checkedEntrySize = 53;
+    static const uint8_t entryHasCrc = 0x01; // Entry flag: the CRC-32 field is valid
+    static const uint8_t filterSection = 'F'; // Index section: the SearchFilter of every entry
+    static const size_t legacyTailRegion = 64 * 1024;
+
+    static const uint8_t* magic() {
+        static const uint8_t bytes[4] = { 0x89, 'L', 'Z', 'W' };
+        return bytes;
+    }
+
+    // Appends blocks to 'output' (which starts at file offset 'base') and records them in the index
+    static void addBlocks(std::vector<uint8_t>& output, uint64_t base, const std::vector<Block>& blocks, Index& index) {
+        output.reserve(output.size() + encodedSize(blocks));
+        for (const Block& block : blocks) {
+            addBlock(output, base, block, index);
+        }
+    }
+
+    static void addBlock(std::vector<uint8_t>& output, uint64_t base, const Block& block, Index& index) {
+        Entry entry;
+        if (block.duplicateOf >= 0 && static_cast<size_t>(block.duplicateOf) < index.entries.size()) {
+            entry = index.entries[static_cast<size_t>(block.duplicateOf)]; // Share the stored copy
+        }
+        else {
+            if (block.data.size() > std::numeric_limits<uint32_t>::max()) throw std::runtime_error("Encoded block is too large for the archive index.");
+            entry.offset = base + output.size();
+            entry.size = static_cast<uint32_t>(block.data.size());
+            Utility::appendVector(output, block.data);
+        }
+        if (block.rawSize > std::numeric_limits<uint32_t>::max()) throw std::runtime_error("Block is too large for the archive index.");
+        entry.rawSize = static_cast<uint32_t>(block.rawSize);
+        entry.hash = block.hash;
+        entry.crc = block.crc;
+        entry.hasCrc = true;
+        if (!block.filter.empty()) entry.filter = block.filter;
+        index.entries.push_back(entry);
+    }
+
+    // Bytes of the blocks' encoded data
+    static size_t encodedSize(const std::vector<Block>& blocks) {
+        size_t size = 0;
+        for (const Block& block : blocks) size += block.data.size();
+        return size;
+    }
+
+    // Largest archive build can make of 'blocks': their data, the widest entries with their filters, and the rest of the index
+    static size_t buildBound(const std::vector<Block>& blocks, const std::vector<uint8_t>& extension) {
+        size_t size = encodedSize(blocks) + extension.size() + 64;
+        for (const Block& block : blocks) size += checkedEntrySize + 4 + block.filter.size();
+        return size;
+    }
+
+    static bool isHashed(const Entry& entry) {
+        for (uint8_t byte : entry.hash) {
+            if (byte != 0) return true;
+        }
+        return false;
+    }
+
+    // Serializes the index followed by its tail
+    static std::vector<uint8_t> serialize(const Index& index) {
+        std::vector<uint8_t> body;
+        body.push_back(static_cast<uint8_t>(version));
+        writeLE(body, index.extension.size(), 2);
+        Utility::appendVector(body, index.extension);
+        bool checked = std::any_of(index.entries.begin(), index.entries.end(), [](const Entry& entry) { return entry.hasCrc; });
+        bool hashed = checked || std::any_of(index.entries.begin(), index.entries.end(), isHashed);
+        body.push_back(static_cast<uint8_t>(checked ? checkedEntrySize : (hashed ? hashedEntrySize : entrySize)));
+        writeLE(body, index.entries.size(), 4);
+        for (const Entry& entry : index.entries) {
+            writeLE(body, entry.offset, 8);
+            writeLE(body, entry.size, 4);
+            writeLE(body, entry.rawSize, 4);
+            if (hashed) body.insert(body.end(), entry.hash.begin(), entry.hash.end());
+            if (checked) {
+                writeLE(body, entry.crc, 4);
+                body.push_back(entry.hasCrc ? entryHasCrc : 0);
+            }
+        }
+
+        // Sections after the entries: [tag 1B][size 4B][bytes], skipped by readers that do not know them
+        if (std::any_of(index.entries.begin(), index.entries.end(), [](const Entry& entry) { return !entry.filter.empty(); })) {
+            std::vector<uint8_t> filters;
+            for (const Entry& entry : index.entries) {
+                writeLE(filters, entry.filter.size(), 4);
+                Utility::appendVector(filters, entry.filter);
+            }
+            body.push_back(static_cast<uint8_t>(filterSection));
+            writeLE(body, filters.size(), 4);
+            Utility::appendVector(body, filters);
+        }
+
+        std::vector<uint8_t> result(body);
+        writeLE(result, body.size(), 4);
+        writeLE(result, Checksum::crc32(body.data(), body.size()), 4);
+        result.insert(result.end(), magic(), magic() + 4);
+        return result;
+    }
+
+    // Parses the index whose tail ends at 'end' in a buffer holding file bytes from 'base' on
+    static bool parseAt(const uint8_t* data, size_t size, size_t end, Index& index, uint64_t base = 0) {
+        if (end < tailSize || end > size || memcmp(data + end - 4, magic(), 4) != 0) return false;
+
+        size_t bodySize = static_cast<size_t>(readLE(data + end - tailSize, 4));
+        uint32_t crc = static_cast<uint32_t>(readLE(data + end - 8, 4));
+        if (bodySize + tailSize > end) return false;
+
+        const uint8_t* body = data + end - tailSize - bodySize;
+        if (Checksum::crc32(body, bodySize) != crc || bodySize < 8 || body[0] != version) return false;
+
+        // Header
+        size_t position = 1;
+        size_t extensionLength = static_cast<size_t>(readLE(body + position, 2));
+        position += 2;
+        if (position + extensionLength + 5 > bodySize) return false;
+        Index parsed;
+        parsed.extension.assign(body + position, body + position + extensionLength);
+        position += extensionLength;
+        size_t storedEntrySize = body[position++];
+        size_t count = static_cast<size_t>(readLE(body + position, 4));
+        position += 4;
+        if (storedEntrySize < entrySize || position + count * storedEntrySize > bodySize) return false;
+
+        // Entries (later versions may append fields, which are skipped)
+        uint64_t indexStart = base + (end - tailSize - bodySize);
+        for (size_t i = 0; i < count; ++i, position += storedEntrySize) {
+            Entry entry;
+            entry.offset = readLE(body + position, 8);
+            entry.size = static_cast<uint32_t>(readLE(body + position + 8, 4));
+            entry.rawSize = static_cast<uint32_t>(readLE(body + position + 12, 4));
+            if (storedEntrySize >= hashedEntrySize) memcpy(entry.hash.data(), body + position + 16, entry.hash.size());
+            if (storedEntrySize >= checkedEntrySize) {
+                entry.crc = static_cast<uint32_t>(readLE(body + position + 48, 4));
+                entry.hasCrc = (body[position + 52] & entryHasCrc) != 0;
+            }
+            if (entry.offset + entry.size > indexStart) return false;
+            parsed.entries.push_back(entry);
+        }
+
+        // Sections
+        while (position + 5 <= bodySize) {
+            uint8_t tag = body[position];
+            size_t sectionSize = static_cast<size_t>(readLE(body + position + 1, 4));
+            position += 5;
+            if (sectionSize > bodySize - position) return false;
+            if (tag == filterSection) {
+                const uint8_t* section = body + position;
+                size_t read = 0;
+                for (Entry& entry : parsed.entries) {
+                    if (sectionSize - read < 4) return false;
+                    size_t filterSize = static_cast<size_t>(readLE(section + read, 4));
+                    read += 4;
+                    if (filterSize > sectionSize - read) return false;
+                    entry.filter.assign(section + read, section + read + filterSize);
+                    read += filterSize;
+                }
+            }
+            position += sectionSize;
+        }
+
+        parsed.end = base + end;
+        index = parsed;
+        return true;
+    }
+
+    // Parses the metadata of an archive without an index from a buffer holding its last bytes
+    static bool parseLegacy(const uint8_t* data, size_t size, uint64_t base, Index& index) {
+        // The extension starts at the last dot
+        size_t dot = size;
+        while (dot > 0 && data[dot - 1] != '.') --dot;
+        if (dot < 2) return false;
+        dot--;
+
+        // Chunk count and sizes precede the extension
+        size_t count = data[dot - 1];
+        if (dot < count * 4 + 1) return false;
+        size_t sizesStart = dot - 1 - count * 4;
+
+        Index parsed;
+        parsed.legacy = true;
+        parsed.extension.assign(data + dot, data + size);
+        parsed.end = base + size;
+
+        // Sizes must add up to exactly where the metadata starts
+        uint64_t offset = 0;
+        for (size_t i = 0; i < count; ++i) {
+            Entry entry;
+            entry.offset = offset;
+            entry.size = static_cast<uint32_t>(readLE(data + sizesStart + i * 4, 4));
+            offset += entry.size;
+            parsed.entries.push_back(entry);
+        }
+        if (offset != base + sizesStart) return false;
+
+        index = parsed;
+        return true;
+    }
+};
+
+// Settings of the encoded block cache
+struct CacheOptions {
+    std::u32string directory; // Where cached blocks and the manifest are kept
+    uint64_t maxBytes = 1ULL << 30; // Total size of cached blocks before the least recently used are evicted
+};
+
+// On-disk cache of encoded blocks, keyed by a hash of the decoded block and the encoding parameters
+// A repeated job over unchanged data copies cached blocks instead of encoding them again.
+// Each block is a file named after its key ([CRC-32 4B][encoded block]); the manifest lists the
+// keys and sizes from least to most recently used and is rewritten by flush()
+// get() and put() may be called from several workers at once
+class BlockCache {
+
+public:
+    explicit BlockCache(const CacheOptions& options) : options(options) {
+        IOBackend& io = IOBackend::getInstance();
+        io.createDirectory(options.directory);
+
+        // Load the manifest (missing or unreadable means an empty cache)
+        std::vector<uint8_t> manifest;
+        try {
+            io.readFile(manifestPath(), manifest);
+        }
+        catch (const std::exception&) {
+            manifest.clear();
+        }
+        std::istringstream lines(std::string(manifest.begin(), manifest.end()));
+        std::string key;
+        uint64_t size;
+        while (lines >> key >> size) {
+            if (index.count(key)) continue;
+            order.push_back({ key, size });
+            index[key] = std::prev(order.end());
+            totalBytes += size;
+        }
+    }
+
+    ~BlockCache() {
+        try {
+            flush();
+        }
+        catch (const std::exception&) {
+            // The cache is only an optimization, a stale manifest is harmless
+        }
+    }
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    // Key of a decoded block encoded with 'options'
+    static std::string makeKey(const uint8_t* data, size_t size, const EncodeOptions& options) {
+        std::array<uint64_t, 2> hash = Checksum::fastHash(data, size);
+        std::ostringstream key;
+        key << std::hex << std::setfill('0') << std::setw(16) << hash[0] << std::setw(16) << hash[1]
+            << std::dec << '-' << size << "-v" << formatVersion
+            << (options.entropyCoding ? "e" : "") << (options.growingWidth ? "g" : "") << (options.longRepeats ? "r" : "") << 'm' << options.maxCodeBits;
+        if (options.filters != 0) key << 'f' << static_cast<int>(options.filters) << 'w' << options.elementWidth;
+        return key.str();
+    }
+
+    // Looks up an encoded block, marking it as recently used
+    bool get(const std::string& key, std::vector<uint8_t>& block) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = index.find(key);
+            if (found == index.end()) {
+                misses++;
+                return false;
+            }
+            order.splice(order.end(), order, found->second);
+            dirty = true;
+        }
+
+        // A missing or damaged file is dropped from the cache
+        std::vector<uint8_t> stored;
+        try {
+            IOBackend::getInstance().readFile(blockPath(key), stored);
+        }
+        catch (const std::exception&) {
+            stored.clear();
+        }
+        if (stored.size() < 4 || Archive::readLE(stored.data(), 4) != Checksum::crc32(stored.data() + 4, stored.size() - 4)) {
+            erase(key);
+            std::lock_guard<std::mutex> lock(mutex);
+            misses++;
+            return false;
+        }
+
+        block.assign(stored.begin() + 4, stored.end());
+        std::lock_guard<std::mutex> lock(mutex);
+        hits++;
+        return true;
+    }
+
+    // Stores an encoded block, evicting the least recently used blocks above the size limit
+    void put(const std::string& key, const std::vector<uint8_t>& block) {
+        IOBackend& io = IOBackend::getInstance();
+        std::vector<uint8_t> stored;
+        stored.reserve(block.size() + 4);
+        Archive::writeLE(stored, Checksum::crc32(block.data(), block.size()), 4);
+        Utility::appendVector(stored, block);
+
+        // Written under a temporary name, so a reader never sees a partial block
+        // A failed write (full disk, permissions) only means the block is not cached
+        std::u32string temporary = blockPath(key) + U"." + Utility::stringToU32String(std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())));
+        try {
+            io.writeFile(temporary, stored);
+            io.renameFile(temporary, blockPath(key));
+        }
+        catch (const std::exception&) {
+            io.removeFile(temporary);
+            return;
+        }
+
+        std::vector<std::string> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (index.count(key) == 0) {
+                order.push_back({ key, stored.size() });
+                index[key] = std::prev(order.end());
+                totalBytes += stored.size();
+            }
+            while (totalBytes > options.maxBytes && order.size() > 1) {
+                evicted.push_back(order.front().key);
+                totalBytes -= order.front().size;
+                index.erase(order.front().key);
+                order.pop_front();
+            }
+            dirty = true;
+        }
+
+        for (const std::string& victim : evicted) {
+            io.removeFile(blockPath(victim));
+        }
+    }
+
+    // Writes the manifest if anything changed since the last flush
+    void flush() {
+        std::string manifest;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!dirty) return;
+            for (const Item& item : order) {
+                manifest += item.key + " " + std::to_string(item.size) + "\n";
+            }
+            dirty = false;
+        }
+
+        IOBackend& io = IOBackend::getInstance();
+        io.writeFile(manifestPath() + U".tmp", std::vector<uint8_t>(manifest.begin(), manifest.end()));
+        io.renameFile(manifestPath() + U".tmp", manifestPath());
+    }
+
+    uint64_t hitCount() const { return hits; }
+    uint64_t missCount() const { return misses; }
+
+private:
+    struct Item {
+        std::string key;
+        uint64_t size;
+    };
+
+    static const int formatVersion = 1; // Changes whenever the encoded block format does
+
+    CacheOptions options;
+    std::list<Item> order; // Least recently used first
+    std::unordered_map<std::string, std::list<Item>::iterator> index;
+    uint64_t totalBytes = 0;
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+    bool dirty = false;
+    std::mutex mutex;
+
+    std::u32string blockPath(const std::string& key) const {
+        return options.directory + U"/" + Utility::stringToU32String(key) + U".lzb";
+    }
+
+    std::u32string manifestPath() const {
+        return options.directory + U"/manifest";
+    }
+
+    void erase(const std::string& key) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = index.find(key);
+            if (found == index.end()) return;
+            totalBytes -= found->second->size;
+            order.erase(found->second);
+            index.erase(found);
+            dirty = true;
+        }
+        IOBackend::getInstance().removeFile(blockPath(key));
+    }
+};
+
+// Settings of deadline-aware encoding
+struct DeadlineOptions {
+    double seconds = 0; // Time budget of the whole job, counted from the creation of the Deadline
+    double safety = 0.9; // Share of the budget that is planned for; the rest covers the index, the writes and misjudged blocks
+    size_t blockSize = 1 << 20; // Block size for jobs that set none, so that there are enough blocks to steer with
+    size_t sampleSize = 64 * 1024; // Bytes encoded with each tier up front to know its speed before any block finishes
+};
+
+// Keeps an encode within a time budget by downgrading the blocks that would not finish in time
+// Before a block starts, the time the bytes not yet started need at each tier's throughput is compared
+// with the time left. The block is encoded as asked while that fits, with the fast settings (no entropy
+// stage, filter search or priming, dictionary reset at 14 bits) while those fit, and stored as is
+// otherwise. Throughputs are measured on the blocks already done, and on a small sample before that.
+// Decisions are made per block, so the blocks have to be much smaller than the job.
+class Deadline {
+
+public:
+    enum Tier : uint8_t {
+        Full = 0, // Encoded with the job's settings
+        Fast = 1, // Encoded with fastOptions
+        Stored = 2 // Copied into a stored block
+    };
+
+    explicit Deadline(const DeadlineOptions& options) : options(options), started(std::chrono::steady_clock::now()) {}
+
+    Deadline(const Deadline&) = delete;
+    Deadline& operator=(const Deadline&) = delete;
+
+    const DeadlineOptions& settings() const {
+        return options;
+    }
+
+    // Prepares for 'count' blocks of 'input' encoded with 'encodeOptions' on 'threads' threads
+    void start(const InputSpans& input, size_t count, const EncodeOptions& encodeOptions, int threads) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tiers.assign(count, Full);
+        totalBytes = input.size();
+        startedBytes = 0;
+        this->threads = threads > 0 ? threads : 1;
+
+        // Time both tiers on a sample from the middle of the input
+        size_t size = input.size() < options.sampleSize ? input.size() : options.sampleSize;
+        std::vector<uint8_t> sample(size);
+        input.gather((input.size() - size) / 2, size, sample.data());
+        std::vector<uint8_t> encoded;
+        HashDictionary dictionary;
+        for (Tier tier : { Full, Fast }) {
+            auto begun = std::chrono::steady_clock::now();
+            LZW::encodeInto(sample.data(), sample.size(), encoded, dictionary, nullptr, tier == Full ? encodeOptions : fastOptions(encodeOptions));
+            calibrated[tier] = rate(sample.size(), std::chrono::duration<double>(std::chrono::steady_clock::now() - begun).count());
+        }
+    }
+
+    // Tier of a block of 'size' bytes that is about to be encoded
+    Tier begin(size_t index, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        double left = options.seconds * options.safety - elapsed();
+        uint64_t remaining = totalBytes - startedBytes; // This block and the ones not started
+        startedBytes += size;
+
+        Tier tier = Stored;
+        for (Tier candidate : { Full, Fast }) {
+            double bytesPerSecond = measuredBytes[candidate] > 0 ? rate(measuredBytes[candidate], measuredSeconds[candidate]) : calibrated[candidate];
+            double needed = std::max(remaining / (threads * bytesPerSecond), size / bytesPerSecond);
+            if (bytesPerSecond <= 0 || needed <= left) {
+                tier = candidate;
+                break;
+            }
+        }
+        if (index < tiers.size()) tiers[index] = tier;
+        return tier;
+    }
+
+    // Records how long a block of 'size' bytes took with 'tier'
+    void end(size_t size, Tier tier, double seconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        measuredBytes[tier] += size;
+        measuredSeconds[tier] += seconds;
+    }
+
+    // Tier each block was given
+    std::vector<Tier> blockTiers() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return tiers;
+    }
+
+    // Seconds since the Deadline was created
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    // Cheaper settings derived from the job's
+    static EncodeOptions fastOptions(const EncodeOptions& options) {
+        EncodeOptions fast = options;
+        fast.entropyCoding = false;
+        if (fast.filters & BlockFilter::Auto) fast.filters = 0;
+        fast.primeBytes = 0;
+        fast.maxCodeBits = options.maxCodeBits > 0 && options.maxCodeBits < 14 ? options.maxCodeBits : 14; // Small dictionaries stay in cache
+        return fast;
+    }
+
+    // Names of the tiers, for reports
+    static const char* tierName(Tier tier) {
+        return tier == Full ? "full" : (tier == Fast ? "fast" : "stored");
+    }
+
+private:
+    DeadlineOptions options;
+    std::chrono::steady_clock::time_point started;
+    mutable std::mutex mutex; // Guards everything below
+    std::vector<Tier> tiers; // Tier of each block
+    uint64_t totalBytes = 0; // Bytes of the job
+    uint64_t startedBytes = 0; // Bytes of the blocks begun so far
+    int threads = 1; // Blocks encoded at once
+    double calibrated[2] = { 0, 0 }; // Bytes per second of the Full and Fast tiers on the sample
+    uint64_t measuredBytes[2] = { 0, 0 }; // Bytes of the finished blocks of each tier
+    double measuredSeconds[2] = { 0, 0 }; // Time those blocks took
+
+    // Bytes per second, with a floor for immeasurably short runs
+    static double rate(uint64_t bytes, double seconds) {
+        return bytes / std::max(seconds, 1e-6);
+    }
+};
+
+// Memory budget shared by every job in the process
+struct MemoryOptions {
+    uint64_t budget = 0; // Bytes the inputs, outputs and block buffers of all jobs may take together, 0 for no limit
+    int minCodeBits = 14; // Narrowest dictionary reset width MemoryGovernor::plan lowers maxCodeBits to
+    size_t minBlockSize = 1 << 20; // Smallest block MemoryGovernor::plan shrinks blocks to
+
+    // LZWPP_MEMORY_MB sets the budget; "auto" takes three quarters of the container's memory limit,
+    // leaving the rest for the allocator's overhead and the memory no job accounts for
+    static MemoryOptions fromEnvironment() {
+        MemoryOptions options;
+        const char* value = std::getenv("LZWPP_MEMORY_MB");
+        if (value && std::string(value) == "auto") options.budget = containerLimit() / 4 * 3;
+        else if (value) options.budget = std::strtoull(value, nullptr, 10) << 20;
+        return options;
+    }
+
+    // Memory limit of the control group the process runs in (cgroup v2, then v1), 0 when there is none
+    static uint64_t containerLimit() {
+        for (const char* path : { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes" }) {
+            std::ifstream file(path);
+            std::string text;
+            if (file >> text && text != "max") {
+                uint64_t limit = std::strtoull(text.c_str(), nullptr, 10);
+                if (limit > 0 && limit < (static_cast<uint64_t>(1) << 60)) return limit; // v1 reports no limit as a huge number
+            }
+        }
+        return 0;
+    }
+};
+
+// Process-wide account of the memory held by encodes and decodes, admitting blocks while they fit
+// Jobs hold their input and finished outputs at their exact sizes, and reserve an estimate of each
+// block's working memory (chunk copy, dictionary, code stream) before starting it. A block that does
+// not fit waits until other blocks release theirs, so workers stall instead of the host running out of
+// memory; a block is always admitted when no other block is working, so every job makes progress.
+// Before an encode, plan() lowers the dictionary reset width and then halves the block size until a
+// block per thread fits in what the budget leaves.
+class MemoryGovernor {
+
+public:
+    static MemoryGovernor& getInstance() {
+        static MemoryGovernor instance; // Static instance for singleton pattern
+        return instance;
+    }
+
+    MemoryGovernor(const MemoryGovernor&) = delete;
+    MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+    // Applies a new budget, waking blocks that may now fit
+    void configure(const MemoryOptions& newOptions) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            options = newOptions;
+        }
+#ifdef __GLIBC__
+        // glibc otherwise raises its mmap threshold as buffers are freed and keeps later ones in its arenas,
+        // so the memory of finished blocks would stay with the process instead of going back to the system
+        if (newOptions.budget > 0) mallopt(M_MMAP_THRESHOLD, 256 * 1024);
+#endif
+        released.notify_all();
+    }
+
+    MemoryOptions getOptions() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return options;
+    }
+
+    // Memory taken from the budget until the reservation is destroyed or replaced
+    class Reservation {
+
+    public:
+        Reservation() {}
+
+        Reservation(Reservation&& other) noexcept : governor(other.governor), bytes(other.bytes), working(other.working) {
+            other.governor = nullptr;
+        }
+
+        Reservation& operator=(Reservation&& other) noexcept {
+            if (this != &other) {
+                release();
+                governor = other.governor;
+                bytes = other.bytes;
+                working = other.working;
+                other.governor = nullptr;
+            }
+            return *this;
+        }
+
+        ~Reservation() {
+            release();
+        }
+
+    private:
+        friend class MemoryGovernor;
+
+        Reservation(MemoryGovernor* governor, uint64_t bytes, bool working) : governor(governor), bytes(bytes), working(working) {}
+
+        void release() {
+            if (governor) governor->give(bytes, working);
+            governor = nullptr;
+        }
+
+        MemoryGovernor* governor = nullptr; // Null once released
+        uint64_t bytes = 0;
+        bool working = false; // Working memory of a block, which admit() waits on
+    };
+
+    // Waits until 'bytes' of a block's working memory fit in the budget, then takes them
+    Reservation admit(uint64_t bytes) {
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [&]() { return options.budget == 0 || working == 0 || used + bytes <= options.budget; });
+        return take(bytes, true);
+    }
+
+    // Takes 'bytes' that are already allocated (an input, a finished block) without waiting
+    Reservation hold(uint64_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return take(bytes, false);
+    }
+
+    // Most memory accounted at once since the process started
+    uint64_t peak() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return highest;
+    }
+
+    // Shrinks the dictionaries and blocks of an encode of 'inputSize' bytes on 'threads' threads to the budget
+    // The reset width is lowered down to minCodeBits, then fixed blocks are halved down to minBlockSize, until
+    // 'threads' blocks fit in what is left after the memory already held and room for the outputs. Narrower
+    // dictionaries cost little ratio, smaller blocks lose the long-range repeats. Content-defined blocks
+    // are small already and keep their size. 'share' is the data's sampleShare.
+    void plan(uint64_t inputSize, int threads, EncodeOptions& encodeOptions, ChunkingOptions& chunking, double share = 1.0) {
+        MemoryOptions settings = getOptions();
+        if (settings.budget == 0 || inputSize == 0) return;
+        threads = threads > 0 ? threads : 1;
+
+        uint64_t reserved;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            reserved = used + static_cast<uint64_t>((inputSize + inputSize / 4) * share); // Room for the outputs
+        }
+        uint64_t perBlock = (settings.budget > reserved ? settings.budget - reserved : 0) / threads;
+
+        size_t size = chunking.contentDefined ? chunking.maxSize : (chunking.blockSize > 0 ? chunking.blockSize : static_cast<size_t>((inputSize + threads - 1) / threads));
+        EncodeOptions narrowed = encodeOptions;
+        if (narrowed.maxCodeBits == 0) {
+            narrowed.maxCodeBits = 9;
+            while (narrowed.maxCodeBits < 30 && (static_cast<uint64_t>(1) << narrowed.maxCodeBits) < codeCount(size, share) + 256) ++narrowed.maxCodeBits;
+        }
+        while (narrowed.maxCodeBits > settings.minCodeBits && encodeMemory(size, narrowed, share) > perBlock) --narrowed.maxCodeBits;
+        if (encodeMemory(size, narrowed, share) < encodeMemory(size, encodeOptions, share)) encodeOptions.maxCodeBits = narrowed.maxCodeBits;
+
+        size_t planned = size;
+        while (!chunking.contentDefined && planned > settings.minBlockSize && encodeMemory(planned, encodeOptions, share) > perBlock) {
+            planned = std::max(planned / 2, settings.minBlockSize);
+        }
+        if (planned != size) chunking.blockSize = planned;
+    }
+
+    // Share of the worst case (random data) that encoding 'input' is expected to take, from a sample in its middle
+    // Small samples compress worse than whole blocks, which keeps the estimate on the safe side.
+    static double sampleShare(const InputSpans& input) {
+        size_t size = input.size() < 64 * 1024 ? input.size() : 64 * 1024;
+        if (size < 4096) return 1.0;
+        std::vector<uint8_t> sample(size);
+        input.gather((input.size() - size) / 2, size, sample.data());
+        EncodeOptions plain;
+        plain.longRepeats = false; // Repeats shorten what is coded, but not reliably across a whole input
+        std::vector<uint8_t> encoded;
+        HashDictionary dictionary;
+        LZW::encodeInto(sample.data(), sample.size(), encoded, dictionary, nullptr, plain);
+        double share = encoded.size() / (size * 1.25);
+        return share < 0.25 ? 0.25 : (share > 1.0 ? 1.0 : share);
+    }
+
+    // Working memory of encoding a block of 'size' bytes whose data takes 'share' of the worst case (see sampleShare)
+    static uint64_t encodeMemory(size_t size, const EncodeOptions& encodeOptions, double share = 1.0) {
+        uint64_t codes = codeCount(size, share);
+        uint64_t entries = codes;
+        if (encodeOptions.maxCodeBits > 0) entries = std::min(entries, (static_cast<uint64_t>(1) << encodeOptions.maxCodeBits) - 256);
+        uint64_t slots = 1 << 12;
+        while (slots < entries * 2) slots <<= 1; // HashDictionary keeps its load at or below 1/2
+
+        uint64_t bytes = size // Chunk copy
+            + static_cast<uint64_t>((size + size / 4) * share) // Code stream, a quarter longer than the block on random data
+            + slots * 16 * 3 / 2; // Slots of 16 bytes, plus the old table while it grows
+        if (encodeOptions.filters != 0) bytes += size; // Filtered copy
+        if (encodeOptions.entropyCoding) bytes += codes * 4 + size; // Codes and the Huffman coded stream
+        return bytes + encodeOptions.primeBytes;
+    }
+
+    // Working memory of decoding a block of 'encodedSize' bytes into 'rawSize' bytes (0 when the index does not say)
+    static uint64_t decodeMemory(size_t encodedSize, size_t rawSize) {
+        uint64_t decoded = rawSize > 0 ? rawSize : static_cast<uint64_t>(encodedSize) * 8;
+        uint64_t entries = encodedSize; // Every code takes at least 8 bits
+        return encodedSize // Chunk copy
+            + decoded * 2 // Decoded data, and the copy a filtered block decodes into first
+            + entries * 14; // Prefix, suffix, first byte and length of each entry, and the codes of an entropy coded stream
+    }
+
+private:
+    MemoryGovernor() {}
+
+    std::mutex mutex; // Guards everything below
+    std::condition_variable released; // Notified when memory is given back or the budget changes
+    MemoryOptions options;
+    uint64_t used = 0; // Bytes accounted now
+    uint64_t highest = 0; // Most bytes accounted at once
+    int working = 0; // Blocks holding working memory
+
+    // LZW codes cover two bytes or more even on random data, except in tiny blocks
+    static uint64_t codeCount(size_t size, double share) {
+        return static_cast<uint64_t>(size / 2 * share) + 256;
+    }
+
+    // Called with the mutex held
+    Reservation take(uint64_t bytes, bool isWorking) {
+        used += bytes;
+        highest = std::max(highest, used);
+        if (isWorking) working++;
+        return Reservation(this, bytes, isWorking);
+    }
+
+    void give(uint64_t bytes, bool isWorking) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            used -= bytes;
+            if (isWorking) working--;
+        }
+        released.notify_all();
+    }
+};
+
+// Aho-Corasick automaton: finds every occurrence of several patterns in one pass over the data
+// The transitions of every state are filled in for all 256 bytes, so scanning costs one table lookup per byte.
+class AhoCorasick {
+
+public:
+    static const int32_t start = 0; // State before any data
+
+    explicit AhoCorasick(const std::vector<std::string>& patterns) {
+        addState();
+        for (size_t p = 0; p < patterns.size(); ++p) {
+            if (patterns[p].empty()) throw std::runtime_error("Empty search pattern.");
+            int32_t state = start;
+            for (unsigned char byte : patterns[p]) {
+                if (next[state * 256 + byte] < 0) {
+                    int32_t added = addState(); // Grows 'next', so the slot is looked up again
+                    next[state * 256 + byte] = added;
+                }
+                state = next[state * 256 + byte];
+            }
+            found[state].push_back(static_cast<int32_t>(p));
+            lengths.push_back(patterns[p].size());
+        }
+
+        // Breadth first, each state takes the missing transitions and the patterns of its longest proper suffix
+        std::vector<int32_t> fail(found.size(), start);
+        std::deque<int32_t> queue;
+        for (int byte = 0; byte < 256; ++byte) {
+            int32_t& target = next[byte];
+            if (target < 0) target = start;
+            else queue.push_back(target);
+        }
+        while (!queue.empty()) {
+            int32_t state = queue.front();
+            queue.pop_front();
+            const std::vector<int32_t>& inherited = found[fail[state]];
+            found[state].insert(found[state].end(), inherited.begin(), inherited.end());
+            for (int byte = 0; byte < 256; ++byte) {
+                int32_t& target = next[state * 256 + byte];
+                int32_t fallback = next[fail[state] * 256 + byte];
+                if (target < 0) {
+                    target = fallback;
+                }
+                else {
+                    fail[target] = fallback;
+                    queue.push_back(target);
+                }
+            }
+        }
+        for (size_t state = 0; state < found.size(); ++state) terminal.push_back(!found[state].empty());
+    }
+
+    // Runs the data through the automaton from 'state' and returns the state after it
+    // 'report(pattern, end)' is called for every occurrence, 'end' being the offset just past it.
+    template <class Report>
+    int32_t scan(const uint8_t* data, size_t size, int32_t state, Report report) const {
+        for (size_t i = 0; i < size; ++i) {
+            state = next[state * 256 + data[i]];
+            if (terminal[state]) {
+                for (int32_t pattern : found[state]) report(pattern, i + 1);
+            }
+        }
+        return state;
+    }
+
+    size_t length(int32_t pattern) const { return lengths[pattern]; }
+
+    // Length of the longest pattern
+    size_t longest() const {
+        return lengths.empty() ? 0 : *std::max_element(lengths.begin(), lengths.end());
+    }
+
+private:
+    std::vector<int32_t> next; // Transition of every state for every byte
+    std::vector<std::vector<int32_t>> found; // Patterns ending at every state
+    std::vector<uint8_t> terminal; // Whether any pattern ends at a state
+    std::vector<size_t> lengths; // Length of every pattern
+
+    int32_t addState() {
+        next.insert(next.end(), 256, -1);
+        found.emplace_back();
+        return static_cast<int32_t>(found.size() - 1);
+    }
+};
+
+// Settings of Parallelization::parallelSearch
+struct SearchOptions {
+    size_t contextBytes = 80; // Bytes of a match's line kept on each side of it, at most
+    size_t maxMatches = 0; // Matches to report, the first ones by offset; 0 for all of them
+    bool useFilters = true; // Skip blocks whose SearchFilter rules out every pattern
+};
+
+// Provides multi-threaded functionality for encoding and decoding algorithms
+class Parallelization {
+
+public:
+    using ProgressCallback = std::function<void(double)>;
+
+    // Parallel encoding of a Unicode string
+    // Splits the input into chunks, encodes each chunk in parallel, and returns them as an archive
+    // O(n) where n is the number of threads
+    static std::vector<uint8_t> parallelEncode(const std::vector<uint8_t>& input, int n, ProgressCallback progressCallback = nullptr, const EncodeOptions& options = EncodeOptions(), const ParallelOptions& parallelOptions = ParallelOptions(), const std::vector<uint8_t>& extension = {}, const ChunkingOptions& chunking = ChunkingOptions(), BlockCache* cache = nullptr, Deadline* deadline = nullptr) {
+        return Archive::build(encodeBlocks(input, n, progressCallback, options, parallelOptions, chunking, {}, cache, deadline), extension);
+    }
+
+    // Same for input held in fragments, read as one stream without gathering it first
+    static std::vector<uint8_t> parallelEncode(const InputSpans& input, int n, ProgressCallback progressCallback = nullptr, const EncodeOptions& options = EncodeOptions(), const ParallelOptions& parallelOptions = ParallelOptions(), const std::vector<uint8_t>& extension = {}, const ChunkingOptions& chunking = ChunkingOptions(), BlockCache* cache = nullptr, Deadline* deadline = nullptr) {
+        return Archive::build(encodeBlocks(input, n, progressCallback, options, parallelOptions, chunking, {}, cache, deadline), extension);
+    }
+
+    // Encodes the input into independent blocks on 'n' threads
+    // Without content-defined chunking the input is cut into 'n' equal blocks (or blocks of the
+    // configured size). With it, blocks are
+    // hashed first and only the first copy of each content is encoded; the others (and blocks already
+    // in 'existing', the index of an archive being appended to) become references
+    // Blocks found in 'cache' are copied from it, newly encoded blocks are added to it
+    // With a 'deadline' each block may be downgraded to keep within its budget (blocks default to the deadline's size)
+    // Each worker copies its own chunk, so the copy and the encoder's buffers are allocated on the worker's NUMA node
+    // Under a memory budget the blocks and dictionaries are planned to fit it, and each block waits for the
+    // MemoryGovernor to admit its working memory before it starts
+    static std::vector<Archive::Block> encodeBlocks(const std::vector<uint8_t>& input, int n, ProgressCallback progressCallback = nullptr, const EncodeOptions& options = EncodeOptions(), const ParallelOptions& parallelOptions = ParallelOptions(), const ChunkingOptions& chunking = ChunkingOptions(), const std::vector<Archive::Entry>& existing = {}, BlockCache* cache = nullptr, Deadline* deadline = nullptr) {
+        return encodeBlocks(InputSpans(input.data(), input.size()), n, progressCallback, options, parallelOptions, chunking, existing, cache, deadline);
+    }
+
+    // Same for input held in fragments; that copy is where a block spanning several fragments is gathered
+    static std::vector<Archive::Block> encodeBlocks(const InputSpans& input, int n, ProgressCallback progressCallback = nullptr, const EncodeOptions& requested = EncodeOptions(), const ParallelOptions& parallelOptions = ParallelOptions(), const ChunkingOptions& chunking = ChunkingOptions(), const std::vector<Archive::Entry>& existing = {}, BlockCache* cache = nullptr, Deadline* deadline = nullptr) {
+        MemoryGovernor& governor = MemoryGovernor::getInstance();
+        MemoryGovernor::Reservation inputHeld = governor.hold(input.size()); // The input stays in memory for the whole encode
+
+        // Split input into chunks
+        ChunkingOptions layout = chunking;
+        EncodeOptions options = requested;
+        if (deadline && !layout.contentDefined && layout.blockSize == 0) layout.blockSize = deadline->settings().blockSize;
+        double share = governor.getOptions().budget > 0 ? MemoryGovernor::sampleShare(input) : 1.0;
+        governor.plan(input.size(), n, options, layout, share);
+        std::vector<size_t> ends = blockEnds(input, n, layout);
+        int count = static_cast<int>(ends.size());
+
+        std::vector<Archive::Block> blocks(count);
+        std::vector<MemoryGovernor::Reservation> held(count); // Encoded blocks, until they are handed to the caller
+        for (int i = 0; i < count; ++i) {
+            blocks[i].rawSize = ends[i] - (i > 0 ? ends[i - 1] : 0);
+        }
+
+        WorkerPool pool(n, parallelOptions);
+        if (deadline) deadline->start(input, ends.size(), options, pool.threadCount());
+        auto submitAll = [&](const std::function<void(int)>& task) {
+            for (int i = 0; i < count; ++i) {
+                pool.submit([&task, i]() { task(i); }, i * pool.nodeCount() / count); // Queue neighbouring chunks on the same node
+            }
+            pool.wait();
+        };
+
+        // Hash the chunks and keep the first occurrence of each content
+        if (chunking.contentDefined) {
+            submitAll([&](int index) {
+                size_t start = ends[index] - blocks[index].rawSize;
+                std::vector<uint8_t> scratch;
+                blocks[index].hash = Checksum::sha256(input.read(start, blocks[index].rawSize, scratch), blocks[index].rawSize);
+            });
+
+            std::map<Checksum::Digest, int64_t> seen;
+            for (size_t i = 0; i < existing.size(); ++i) {
+                seen.emplace(existing[i].hash, static_cast<int64_t>(i));
+            }
+            for (int i = 0; i < count; ++i) {
+                auto inserted = seen.emplace(blocks[i].hash, static_cast<int64_t>(existing.size()) + i);
+                if (!inserted.second) blocks[i].duplicateOf = inserted.first->second;
+            }
+        }
+
+        // Lambda function to encode each chunk
+        ProgressCallback blockProgress = blockProgressCallback(count, n, progressCallback);
+        submitAll([&](int index) {
+            MemoryGovernor::Reservation working = governor.admit(blocks[index].duplicateOf < 0 ? MemoryGovernor::encodeMemory(blocks[index].rawSize, options, share) : blocks[index].rawSize);
+            size_t start = ends[index] - blocks[index].rawSize;
+            std::vector<uint8_t> chunk;
+            const uint8_t* data = input.read(start, blocks[index].rawSize, chunk); // In place, or gathered into 'chunk'
+            bool gathered = !chunk.empty();
+            blocks[index].crc = Checksum::crc32(data, blocks[index].rawSize); // Lets verify work without the source
+            if (options.searchFilters) blocks[index].filter = SearchFilter::build(data, blocks[index].rawSize);
+            if (blocks[index].duplicateOf < 0) {
+                Deadline::Tier tier = deadline ? deadline->begin(index, blocks[index].rawSize) : Deadline::Full;
+                auto begun = std::chrono::steady_clock::now();
+                if (tier == Deadline::Stored) {
+                    LZW::store(data, blocks[index].rawSize, blocks[index].data);
+                }
+                else {
+                    const EncodeOptions blockOptions = tier == Deadline::Fast ? Deadline::fastOptions(options) : options;
+
+                    // Primed blocks depend on their neighbour's bytes, which the cache key does not cover; downgraded ones are not cached
+                    size_t window = layout.contentDefined ? 0 : LZW::primeWindow(index, ends, blockOptions, n);
+                    BlockCache* blockCache = window == 0 && tier == Deadline::Full ? cache : nullptr;
+                    std::string key = blockCache ? BlockCache::makeKey(data, blocks[index].rawSize, blockOptions) : std::string();
+                    if (!blockCache || !blockCache->get(key, blocks[index].data)) {
+                        if (!gathered) chunk.assign(data, data + blocks[index].rawSize); // First touch on this node
+                        std::vector<uint8_t> primeScratch;
+                        const uint8_t* prime = window > 0 ? input.read(start - window, window, primeScratch) : nullptr;
+                        blocks[index].data = encodeChunk(chunk, count <= n && index == count - 1 ? progressCallback : nullptr, blockOptions, prime, window);
+                        if (blockCache && !blocks[index].data.empty()) blockCache->put(key, blocks[index].data);
+                    }
+                }
+                if (deadline) deadline->end(blocks[index].rawSize, tier, std::chrono::duration<double>(std::chrono::steady_clock::now() - begun).count());
+                blocks[index].data.shrink_to_fit(); // The code stream grew by doubling
+                held[index] = governor.hold(blocks[index].data.size());
+            }
+            if (blockProgress) blockProgress(index);
+        });
+
+        return blocks;
+    }
+
+    // End offset of every block the input is cut into for 'n' threads
+    static std::vector<size_t> blockEnds(const std::vector<uint8_t>& input, int n, const ChunkingOptions& chunking) {
+        return blockEnds(InputSpans(input.data(), input.size()), n, chunking);
+    }
+
+    static std::vector<size_t> blockEnds(const InputSpans& input, int n, const ChunkingOptions& chunking) {
+        std::vector<size_t> ends;
+        if (chunking.contentDefined) {
+            ends = ContentChunker::split(input, chunking);
+        }
+        else if (chunking.blockSize > 0) {
+            for (size_t end = chunking.blockSize; end < input.size(); end += chunking.blockSize) ends.push_back(end);
+            ends.push_back(input.size());
+        }
+        else {
+            // One block per thread, or more when those would exceed Archive::maxBlockSize
+            size_t count = static_cast<size_t>(n > 0 ? n : 1);
+            size_t needed = (input.size() + Archive::maxBlockSize - 1) / Archive::maxBlockSize;
+            if (needed > count) count = needed;
+            size_t chunkSize = input.size() / count;
+            for (size_t i = 1; i < count; ++i) ends.push_back(i * chunkSize);
+            ends.push_back(input.size());
+        }
+        return ends;
+    }
+
+    // Groups the blocks to decode ('unique' entries, in archive order) into chains that start with an unprimed block
+    // Returns the position in 'unique' where each chain starts, followed by unique.size().
+    static std::vector<int> decodeChains(const std::vector<uint8_t>& input, const std::vector<Archive::Entry>& entries, const std::vector<int>& unique) {
+        std::vector<int> starts;
+        for (size_t task = 0; task < unique.size(); ++task) {
+            const Archive::Entry& entry = entries[unique[task]];
+            bool primed = false;
+            if (entry.offset <= input.size() && entry.size <= input.size() - entry.offset) {
+                try {
+                    primed = LzwDecoder::isPrimed(input.data() + entry.offset, entry.size);
+                }
+                catch (const std::exception&) {} // Reported when the block is decoded
+            }
+
+            // A primed block continues the chain of the entry right before it
+            if (!primed || task == 0 || unique[task - 1] != unique[task] - 1) starts.push_back(static_cast<int>(task));
+        }
+        starts.push_back(static_cast<int>(unique.size()));
+        return starts;
+    }
+
+    // Parallel decoding of a binary vector
+    // Splits the input into chunks, decodes each chunk in parallel, and combines the results
+    // Blocks stored once for several entries are decoded once
+    // O(n) where n is the number of threads
+    // With 'zeroRuns', the page-aligned runs of zeros in the result are found block by block on the workers
+    // (see ZeroRuns), ready for IOBackend::writeSparseFile.
+    static std::vector<uint8_t> parallelDecode(const std::vector<uint8_t>& input, int n, ProgressCallback progressCallback = nullptr, const ParallelOptions& parallelOptions = ParallelOptions(),
+        std::vector<ZeroRuns::Run>* zeroRuns = nullptr) {
+        MemoryGovernor& governor = MemoryGovernor::getInstance();
+        MemoryGovernor::Reservation inputHeld = governor.hold(input.size());
+
+        // Locate the chunks through the archive index
+        std::vector<Archive::Entry> entries = Archive::readIndex(input).entries;
+
+        // Entries sharing their encoded bytes are decoded through the first of them
+        std::vector<int> source(entries.size());
+        std::vector<int> unique;
+        std::unordered_map<uint64_t, int> firstAt;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto inserted = firstAt.emplace(entries[i].offset, static_cast<int>(i));
+            source[i] = inserted.first->second;
+            if (inserted.second) unique.push_back(static_cast<int>(i));
+        }
+
+        // Primed blocks decode after the block before them, so each task is a chain
+        std::vector<int> chains = decodeChains(input, entries, unique);
+        int count = static_cast<int>(chains.size()) - 1;
+
+        std::vector<std::vector<uint8_t>> results(entries.size());
+        std::vector<MemoryGovernor::Reservation> held(entries.size()); // Decoded blocks, until they are copied into the result
+        WorkerPool pool(n, parallelOptions);
+        ProgressCallback blockProgress = blockProgressCallback(count, n, progressCallback);
+
+        // Lambda function to decode each chain of chunks
+        auto processTask = [&](int task) {
+            for (int position = chains[task]; position < chains[task + 1]; ++position) {
+                const Archive::Entry& entry = entries[unique[position]];
+                MemoryGovernor::Reservation working = governor.admit(MemoryGovernor::decodeMemory(entry.size, entry.rawSize));
+                const std::vector<uint8_t>* previous = position > chains[task] ? &results[unique[position - 1]] : nullptr;
+                std::vector<uint8_t> chunk(input.begin() + entry.offset, input.begin() + entry.offset + entry.size); // First touch on this node
+                results[unique[position]] = decodeChunk(chunk, count <= n && task == count - 1 && position + 1 == chains[task + 1] ? progressCallback : nullptr,
+                    previous ? previous->data() : nullptr, previous ? previous->size() : 0);
+                checkBlock(entry, unique[position], results[unique[position]]);
+                held[unique[position]] = governor.hold(results[unique[position]].capacity());
+            }
+            if (blockProgress) blockProgress(task);
+        };
+
+        // Queue neighbouring chunks on the same node
+        for (int i = 0; i < count; ++i) {
+            pool.submit([&processTask, i]() { processTask(i); }, i * pool.nodeCount() / count);
+        }
+
+        // Wait for all chunks to complete
+        pool.wait();
+
+        // Zero runs of every entry, found where it lands in the output; each entry is a separate task since deduplicated blocks land at several offsets
+        if (zeroRuns) {
+            std::vector<std::vector<ZeroRuns::Run>> runs(entries.size());
+            uint64_t start = 0;
+            for (size_t i = 0; i < entries.size(); ++i) {
+                const std::vector<uint8_t>& block = results[source[i]];
+                pool.submit([&runs, &block, start, i]() { ZeroRuns::find(block.data(), block.size(), start, runs[i]); }, static_cast<int>(i * pool.nodeCount() / entries.size()));
+                start += block.size();
+            }
+            pool.wait();
+            zeroRuns->clear();
+            for (const std::vector<ZeroRuns::Run>& entryRuns : runs) zeroRuns->insert(zeroRuns->end(), entryRuns.begin(), entryRuns.end());
+        }
+
+        // Combine all decoded results into a final std::vector<uint8_t>, freeing each block after its last copy
+        // so the decoded data is not held twice
+        std::vector<size_t> lastUse(entries.size(), 0);
+        uint64_t total = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            lastUse[source[i]] = i;
+            total += results[source[i]].size();
+        }
+        MemoryGovernor::Reservation resultHeld = governor.hold(total);
+        std::vector<uint8_t> finalResult;
+        finalResult.reserve(static_cast<size_t>(total));
+        for (size_t i = 0; i < entries.size(); ++i) {
+            Utility::appendVector(finalResult, results[source[i]]);
+            if (lastUse[source[i]] == i) {
+                std::vector<uint8_t>().swap(results[source[i]]);
+                held[source[i]] = MemoryGovernor::Reservation();
+            }
+        }
+        if (zeroRuns) ZeroRuns::merge(*zeroRuns, finalResult.data());
+
+        return finalResult;
+    }
+
+    // Parallel decoding into fragments of memory, written as one stream without building the whole output first
+    // Each block is scattered to its place as soon as it decodes. Returns the decoded size.
+    // Archives that predate decoded sizes in the index cannot place blocks early and are decoded whole first.
+    static size_t parallelDecodeInto(const std::vector<uint8_t>& input, int n, const OutputSpans& output, ProgressCallback progressCallback = nullptr, const ParallelOptions& parallelOptions = ParallelOptions()) {
+        Archive::Index index = Archive::readIndex(input);
+        const std::vector<Archive::Entry>& entries = index.entries;
+        if (index.legacy) {
+            std::vector<uint8_t> decoded = parallelDecode(input, n, progressCallback, parallelOptions);
+            if (decoded.size() > output.size()) throw std::runtime_error("Output spans are too small.");
+            output.scatter(0, decoded.data(), decoded.size());
+            return decoded.size();
+        }
+
+        // Decoded offset of every entry
+        std::vector<uint64_t> starts(entries.size() + 1, 0);
+        for (size_t i = 0; i < entries.size(); ++i) starts[i + 1] = starts[i] + entries[i].rawSize;
+        if (starts.back() > output.size()) throw std::runtime_error("Output spans are too small.");
+
+        // Entries sharing their encoded bytes are decoded once and written for each of them
+        std::vector<int> unique;
+        std::vector<std::vector<int>> users;
+        std::unordered_map<uint64_t, int> firstAt;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto inserted = firstAt.emplace(entries[i].offset, static_cast<int>(unique.size()));
+            if (inserted.second) {
+                unique.push_back(static_cast<int>(i));
+                users.emplace_back();
+            }
+            users[inserted.first->second].push_back(static_cast<int>(i));
+        }
+        std::vector<int> chains = decodeChains(input, entries, unique);
+        int count = static_cast<int>(chains.size()) - 1;
+
+        MemoryGovernor& governor = MemoryGovernor::getInstance();
+        MemoryGovernor::Reservation inputHeld = governor.hold(input.size());
+        WorkerPool pool(n, parallelOptions);
+        ProgressCallback blockProgress = blockProgressCallback(count, n, progressCallback);
+
+        // Each task decodes a chain of blocks, primed blocks decoding with the one before them
+        auto processTask = [&](int task) {
+            std::vector<uint8_t> previous;
+            for (int position = chains[task]; position < chains[task + 1]; ++position) {
+                const Archive::Entry& entry = entries[unique[position]];
+                MemoryGovernor::Reservation working = governor.admit(MemoryGovernor::decodeMemory(entry.size, entry.rawSize));
+                std::vector<uint8_t> chunk(input.begin() + entry.offset, input.begin() + entry.offset + entry.size); // First touch on this node
+                std::vector<uint8_t> decoded = decodeChunk(chunk, count <= n && task == count - 1 && position + 1 == chains[task + 1] ? progressCallback : nullptr,
+                    position > chains[task] ? previous.data() : nullptr, previous.size());
+                if (decoded.size() != entry.rawSize) throw std::runtime_error("Size of block " + std::to_string(unique[position]) + " does not match the index.");
+                checkBlock(entry, unique[position], decoded);
+                for (int user : users[position]) output.scatter(static_cast<size_t>(starts[user]), decoded.data(), decoded.size());
+                previous = std::move(decoded);
+            }
+            if (blockProgress) blockProgress(task);
+        };
+
+        // Queue neighbouring chunks on the same node
+        for (int i = 0; i < count; ++i) {
+            pool.submit([&processTask, i]() { processTask(i); }, i * pool.nodeCount() / count);
+        }
+        pool.wait();
+        return static_cast<size_t>(starts.back());
+    }
+
+    // Outcome of a verification
+    struct VerifyResult {
+        bool ok = true; // Every block decoded and matched
+        uint64_t mismatchOffset = 0; // First offset of the decoded data that failed (when not ok)
+        std::string reason; // Why that offset failed
+        size_t blocks = 0; // Index entries checked
+        uint64_t bytes = 0; // Decoded bytes checked
+        bool againstSource = false; // Compared with the original data rather than only the stored checksums
+        size_t unchecked = 0; // Entries only decoded: no source and no stored checksum to compare them with
+
+        // Everything decoded, but nothing could be compared (an archive without checksums and no source)
+        bool nothingChecked() const {
+            return ok && blocks > 0 && unchecked == blocks;
+        }
+    };
+
+    // Reads 'length' bytes at 'offset' of the original data
+    using SourceReader = std::function<void(uint64_t offset, size_t length, std::vector<uint8_t>& data)>;
+
+    // Decodes every block in parallel and checks it without writing anything
+    // Blocks are compared with 'source' when given (the first differing byte is reported), otherwise
+    // with the CRC-32 stored in the index (the start of the failing block is reported).
+    // Blocks are checked as soon as they decode unless the archive predates decoded sizes in the index,
+    // in which case the decoded blocks are kept until their offsets are known.
+    static VerifyResult parallelVerify(const std::vector<uint8_t>& input, int n, const SourceReader& source = nullptr, uint64_t sourceSize = 0, ProgressCallback progressCallback = nullptr, const ParallelOptions& parallelOptions = ParallelOptions()) {
+        Archive::Index index = Archive::readIndex(input);
+        const std::vector<Archive::Entry>& entries = index.entries;
+        const bool sizesKnown = !index.legacy;
+
+        // Entries sharing their encoded bytes are decoded once and checked for each of them
+        std::vector<int> unique;
+        std::vector<std::vector<int>> users;
+        std::unordered_map<uint64_t, int> firstAt;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto inserted = firstAt.emplace(entries[i].offset, static_cast<int>(unique.size()));
+            if (inserted.second) {
+                unique.push_back(static_cast<int>(i));
+                users.emplace_back();
+            }
+            users[inserted.first->second].push_back(static_cast<int>(i));
+        }
+        int count = static_cast<int>(unique.size());
+        std::vector<int> chains = decodeChains(input, entries, unique);
+        int chainCount = static_cast<int>(chains.size()) - 1;
+
+        // Decoded offset of every entry
+        std::vector<uint64_t> starts(entries.size() + 1, 0);
+        auto computeStarts = [&](const std::vector<uint64_t>& sizes) {
+            for (size_t i = 0; i < entries.size(); ++i) starts[i + 1] = starts[i] + sizes[i];
+        };
+        if (sizesKnown) {
+            std::vector<uint64_t> sizes;
+            for (const Archive::Entry& entry : entries) sizes.push_back(entry.rawSize);
+            computeStarts(sizes);
+        }
+
+        VerifyResult result;
+        result.blocks = entries.size();
+        result.againstSource = static_cast<bool>(source);
+        if (!source) result.unchecked = std::count_if(entries.begin(), entries.end(), [](const Archive::Entry& entry) { return !entry.hasCrc; });
+        std::mutex resultMutex;
+        auto fail = [&](uint64_t offset, const std::string& reason) {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            if (result.ok || offset < result.mismatchOffset) {
+                result.ok = false;
+                result.mismatchOffset = offset;
+                result.reason = reason;
+            }
+        };
+        auto beyondFailure = [&](uint64_t offset) {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            return !result.ok && offset >= result.mismatchOffset;
+        };
+
+        // Checks the decoded bytes of one entry
+        auto check = [&](int entryIndex, const std::vector<uint8_t>& decoded) {
+            const Archive::Entry& entry = entries[entryIndex];
+            uint64_t start = starts[entryIndex];
+            std::string block = "block " + std::to_string(entryIndex);
+
+            if (source) {
+                uint64_t available = start < sourceSize ? sourceSize - start : 0;
+                size_t length = static_cast<size_t>(std::min<uint64_t>(decoded.size(), available));
+                std::vector<uint8_t> original;
+                source(start, length, original);
+                auto difference = std::mismatch(original.begin(), original.end(), decoded.begin());
+                if (difference.first != original.end()) {
+                    fail(start + (difference.first - original.begin()), "Data differs in " + block + ".");
+                }
+                else if (length < decoded.size()) {
+                    fail(start + length, "Decoded data is longer than the source.");
+                }
+            }
+            else if (entry.hasCrc && Checksum::crc32(decoded.data(), decoded.size()) != entry.crc) {
+                fail(start, "Checksum of " + block + " does not match.");
+            }
+            if (sizesKnown && decoded.size() != entry.rawSize) {
+                fail(start + std::min<uint64_t>(decoded.size(), entry.rawSize), "Size of " + block + " does not match the index.");
+            }
+        };
+
+        std::vector<std::vector<uint8_t>> kept(sizesKnown ? 0 : count);
+        MemoryGovernor& governor = MemoryGovernor::getInstance();
+        MemoryGovernor::Reservation inputHeld = governor.hold(input.size());
+        WorkerPool pool(n, parallelOptions);
+        ProgressCallback blockProgress = blockProgressCallback(chainCount, n, progressCallback);
+
+        // Each task checks a chain of blocks, primed blocks decoding with the one before them
+        auto processTask = [&](int chain) {
+            std::vector<uint8_t> previous;
+            for (int task = chains[chain]; task < chains[chain + 1]; ++task) {
+                const Archive::Entry& entry = entries[unique[task]];
+                if (sizesKnown && beyondFailure(starts[unique[task]])) break; // The rest of the chain lies beyond it too
+
+                MemoryGovernor::Reservation working = governor.admit(MemoryGovernor::decodeMemory(entry.size, entry.rawSize));
+                std::vector<uint8_t> decoded;
+                try {
+                    std::vector<uint8_t> chunk(input.begin() + entry.offset, input.begin() + entry.offset + entry.size); // First touch on this node
+                    decoded = LZW::decode(chunk, chainCount <= n && chain == chainCount - 1 && task + 1 == chains[chain + 1] ? progressCallback : nullptr,
+                        task > chains[chain] ? previous.data() : nullptr, previous.size());
+                }
+                catch (const std::exception&) {
+                    fail(starts[unique[task]], "Block " + std::to_string(unique[task]) + " does not decode.");
+                }
+
+                if (sizesKnown) {
+                    for (int user : users[task]) check(user, decoded);
+                    previous = std::move(decoded);
+                }
+                else {
+                    if (task + 1 < chains[chain + 1]) previous = decoded;
+                    kept[task] = std::move(decoded);
+                }
+            }
+            if (blockProgress) blockProgress(chain);
+        };
+
+        // Queue neighbouring chunks on the same node
+        for (int i = 0; i < chainCount; ++i) {
+            pool.submit([&processTask, i]() { processTask(i); }, i * pool.nodeCount() / chainCount);
+        }
+        pool.wait();
+
+        // Old archives: place the decoded blocks, then check them
+        if (!sizesKnown) {
+            std::vector<uint64_t> sizes(entries.size());
+            for (int task = 0; task < count; ++task) {
+                for (int user : users[task]) sizes[user] = kept[task].size();
+            }
+            computeStarts(sizes);
+            for (int task = 0; task < count; ++task) {
+                pool.submit([&, task]() {
+                    for (int user : users[task]) check(user, kept[task]);
+                }, task * pool.nodeCount() / count);
+            }
+            pool.wait();
+        }
+
+        // The source must end where the archive does
+        result.bytes = starts.back();
+        if (source && sourceSize != result.bytes) {
+            fail(std::min(sourceSize, result.bytes), "Source and archive differ in length.");
+        }
+        return result;
+    }
+
+    // Formats a verification result for the console
+    static std::string drawVerifyResult(const VerifyResult& result) {
+        std::ostringstream oss;
+        if (result.nothingChecked()) {
+            oss << " Decoded " << result.blocks << " blocks, " << GUI::drawSizeField(static_cast<size_t>(result.bytes)) << "\n";
+        }
+        else {
+            oss << " Checked " << result.blocks << " blocks, " << GUI::drawSizeField(static_cast<size_t>(result.bytes))
+                << (result.againstSource ? " against the source file" : " against stored checksums") << "\n";
+        }
+        if (!result.ok) {
+            oss << " Mismatch at offset " << result.mismatchOffset << ": " << result.reason << "\n";
+        }
+        else if (result.nothingChecked()) {
+            oss << " Nothing to check against: the archive stores no checksums and the source file is missing\n";
+        }
+        else if (result.unchecked > 0) {
+            oss << " OK, but " << result.unchecked << " blocks without stored checksums were only decoded\n";
+        }
+        else {
+            oss << " OK\n";
+        }
+        return oss.str();
+    }
+
+    // One occurrence of a pattern in the decoded data
+    struct SearchMatch {
+        uint64_t offset = 0; // Position of its first byte
+        int32_t pattern = 0; // Index of the pattern
+        std::string line; // Line holding it, cut to SearchOptions::contextBytes on each side
+    };
+
+    // Outcome of a search
+    struct SearchResult {
+        std::vector<SearchMatch> matches; // By offset, then pattern
+        size_t blocks = 0; // Index entries
+        size_t skipped = 0; // Entries not decoded because their search filters ruled every pattern out
+        bool truncated = false; // More than SearchOptions::maxMatches were found
+    };
+
+    // Decodes the blocks in parallel and streams each one through an AhoCorasick matcher, keeping only the matches
+    // Of every block only its ends are kept once it is scanned, to find the matches that cross into the next block.
+    // When the index holds search filters (EncodeOptions::searchFilters), blocks that cannot hold a match or either
+    // part of one crossing their boundaries are not decoded, unless a primed block after them in its chain is.
+    static SearchResult parallelSearch(const std::vector<uint8_t>& input, const std::vector<std::string>& patterns, int n, const SearchOptions& searchOptions = SearchOptions(), ProgressCallback progressCallback = nullptr, const ParallelOptions& parallelOptions = ParallelOptions()) {
+        Archive::Index index = Archive::readIndex(input);
+        const std::vector<Archive::Entry>& entries = index.entries;
+        AhoCorasick matcher(patterns);
+        const size_t overlap = matcher.longest() > 0 ? matcher.longest() - 1 : 0; // Bytes of a match that can lie before a boundary
+        const size_t keep = std::max(overlap, searchOptions.contextBytes); // Bytes kept from each end of a block
+
+        SearchResult result;
+        result.blocks = entries.size();
+
+        // Entries sharing their encoded bytes are decoded once and searched for each of them
+        std::vector<int> unique;
+        std::vector<int> source(entries.size());
+        std::vector<std::vector<int>> users;
+        std::unordered_map<uint64_t, int> firstAt;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto inserted = firstAt.emplace(entries[i].offset, static_cast<int>(unique.size()));
+            if (inserted.second) {
+                unique.push_back(static_cast<int>(i));
+                users.emplace_back();
+            }
+            source[i] = inserted.first->second;
+            users[inserted.first->second].push_back(static_cast<int>(i));
+        }
+
+        // Entries that may hold a match; blocks at least 'overlap' long keep a crossing match to two of them
+        std::vector<bool> needed(entries.size(), true);
+        bool filtered = searchOptions.useFilters && !index.legacy && std::all_of(entries.begin(), entries.end(), [&](const Archive::Entry& entry) {
+            return SearchFilter::isValid(entry.filter) && entry.rawSize >= overlap;
+        });
+        if (filtered) {
+            auto mayContain = [&](size_t entry, const std::string& pattern, size_t from, size_t to) {
+                return SearchFilter::mayContain(entries[entry].filter, reinterpret_cast<const uint8_t*>(pattern.data()) + from, to - from);
+            };
+            for (size_t i = 0; i < entries.size(); ++i) {
+                needed[i] = std::any_of(patterns.begin(), patterns.end(), [&](const std::string& pattern) { return mayContain(i, pattern, 0, pattern.size()); });
+            }
+            // Crossing matches: exact when the ends kept with the filters are long enough, otherwise every split of a pattern is tried
+            for (size_t i = 1; i < entries.size(); ++i) {
+                std::vector<uint8_t> text = SearchFilter::edge(entries[i - 1].filter, true);
+                std::vector<uint8_t> after = SearchFilter::edge(entries[i].filter, false);
+                size_t boundary = text.size();
+                if (boundary >= overlap && after.size() >= overlap) {
+                    text.insert(text.end(), after.begin(), after.end());
+                    matcher.scan(text.data(), text.size(), AhoCorasick::start, [&](int32_t pattern, size_t end) {
+                        if (end - matcher.length(pattern) < boundary && end > boundary) needed[i - 1] = needed[i] = true;
+                    });
+                    continue;
+                }
+                for (const std::string& pattern : patterns) {
+                    for (size_t split = 1; split < pattern.size() && !(needed[i - 1] && needed[i]); ++split) {
+                        if (mayContain(i - 1, pattern, 0, split) && mayContain(i, pattern, split, pattern.size())) needed[i - 1] = needed[i] = true;
+                    }
+                }
+            }
+        }
+
+        // What is left of every decoded block
+        struct Scanned {
+            bool decoded = false;
+            size_t size = 0; // Decoded size
+            std::vector<uint8_t> head, tail; // First and last 'keep' bytes
+            std::vector<SearchMatch> matches; // Offsets within the block
+            bool truncated = false; // Matches were dropped for SearchOptions::maxMatches
+        };
+        std::vector<Scanned> scanned(unique.size());
+        std::vector<int> chains = decodeChains(input, entries, unique);
+        int count = static_cast<int>(chains.size()) - 1;
+
+        MemoryGovernor& governor = MemoryGovernor::getInstance();
+        MemoryGovernor::Reservation inputHeld = governor.hold(input.size());
+        WorkerPool pool(n, parallelOptions);
+        ProgressCallback blockProgress = blockProgressCallback(count, n, progressCallback);
+
+        // Each task scans a chain up to its last needed block, primed blocks decoding with the one before them
+        auto processTask = [&](int chain) {
+            int last = chains[chain] - 1;
+            for (int position = chains[chain]; position < chains[chain + 1]; ++position) {
+                for (int user : users[position]) {
+                    if (needed[user]) last = position;
+                }
+            }
+
+            LzwDecoder::Workspace workspace;
+            std::vector<uint8_t> current, previous;
+            for (int position = chains[chain]; position <= last; ++position) {
+                const Archive::Entry& entry = entries[unique[position]];
+                MemoryGovernor::Reservation working = governor.admit(MemoryGovernor::decodeMemory(entry.size, entry.rawSize));
+                current.clear();
+                LzwDecoder::decodeInto(input.data() + entry.offset, entry.size, current, workspace, count <= n && chain == count - 1 && position == last ? progressCallback : nullptr,
+                    position > chains[chain] ? previous.data() : nullptr, previous.size());
+
+                Scanned& block = scanned[position];
+                matcher.scan(current.data(), current.size(), AhoCorasick::start, [&](int32_t pattern, size_t end) {
+                    if (searchOptions.maxMatches > 0 && block.matches.size() >= searchOptions.maxMatches) {
+                        block.truncated = true;
+                        return;
+                    }
+                    size_t begin = end - matcher.length(pattern);
+                    block.matches.push_back({ begin, pattern, matchLine(current.data(), current.size(), begin, end, searchOptions.contextBytes) });
+                });
+                size_t ends = std::min(keep, current.size());
+                block.head.assign(current.begin(), current.begin() + ends);
+                block.tail.assign(current.end() - ends, current.end());
+                block.size = current.size();
+                block.decoded = true;
+                std::swap(previous, current);
+            }
+            if (blockProgress) blockProgress(chain);
+        };
+
+        // Queue neighbouring chunks on the same node
+        for (int i = 0; i < count; ++i) {
+            pool.submit([&processTask, i]() { processTask(i); }, i * pool.nodeCount() / count);
+        }
+        pool.wait();
+
+        // Decoded offset of every entry (old archives have every block decoded, so their sizes are known now)
+        std::vector<uint64_t> starts(entries.size() + 1, 0);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            starts[i + 1] = starts[i] + (index.legacy ? scanned[source[i]].size : entries[i].rawSize);
+            if (!scanned[source[i]].decoded) result.skipped++;
+        }
+
+        // Matches inside blocks, once for every entry of the block
+        for (size_t position = 0; position < unique.size(); ++position) {
+            result.truncated = result.truncated || scanned[position].truncated;
+            for (int user : users[position]) {
+                for (const SearchMatch& match : scanned[position].matches) {
+                    result.matches.push_back({ starts[user] + match.offset, match.pattern, match.line });
+                }
+            }
+        }
+
+        // Matches that start in entry i - 1 and end after it: search the end of the data before the boundary
+        // followed by the start of the data after it (several blocks' worth when blocks are short)
+        for (size_t i = 1; i < entries.size() && overlap > 0; ++i) {
+            if (!scanned[source[i - 1]].decoded || !scanned[source[i]].decoded) continue;
+
+            std::vector<uint8_t> text;
+            for (size_t j = i; j-- > 0;) {
+                const Scanned& block = scanned[source[j]];
+                if (!block.decoded) break;
+                text.insert(text.begin(), block.tail.begin(), block.tail.end());
+                if (block.tail.size() < block.size || text.size() >= keep) break;
+            }
+            size_t boundary = text.size();
+            size_t previousStart = boundary - scanned[source[i - 1]].tail.size(); // Where entry i - 1 (or the part of it kept) starts
+            for (size_t j = i; j < entries.size(); ++j) {
+                const Scanned& block = scanned[source[j]];
+                if (!block.decoded) break;
+                text.insert(text.end(), block.head.begin(), block.head.end());
+                if (block.head.size() < block.size || text.size() - boundary >= keep) break;
+            }
+
+            matcher.scan(text.data(), text.size(), AhoCorasick::start, [&](int32_t pattern, size_t end) {
+                size_t begin = end - matcher.length(pattern);
+                if (begin >= previousStart && begin < boundary && end > boundary) {
+                    result.matches.push_back({ starts[i] - boundary + begin, pattern, matchLine(text.data(), text.size(), begin, end, searchOptions.contextBytes) });
+                }
+            });
+        }
+
+        std::sort(result.matches.begin(), result.matches.end(), [](const SearchMatch& a, const SearchMatch& b) {
+            return a.offset != b.offset ? a.offset < b.offset : a.pattern < b.pattern;
+        });
+        if (searchOptions.maxMatches > 0 && result.matches.size() > searchOptions.maxMatches) {
+            result.matches.resize(searchOptions.maxMatches);
+            result.truncated = true;
+        }
+        return result;
+    }
+
+    // Formats the matches of a search like grep -b: the offset of each match and its line
+    static std::string drawSearchResult(const SearchResult& result) {
+        std::ostringstream oss;
+        for (const SearchMatch& match : result.matches) {
+            oss << match.offset << ":" << match.line << "\n";
+        }
+        return oss.str();
+    }
+
+private:
+    // Encodes a single chunk of input data
+    static std::vector<uint8_t> encodeChunk(std::vector<uint8_t>& chunk, ProgressCallback progressCallback = nullptr, const EncodeOptions& options = EncodeOptions(), const uint8_t* prime = nullptr, size_t primeSize = 0) {
+        try {
+            return LZW::encode(chunk, progressCallback, options, prime, primeSize);
+        }
+        catch (const std::exception& e) {
+            if (!ExceptionHandler::interactive()) throw; // Fails the job instead of leaving the block empty
+            ExceptionHandler::ExceptionHandle(e);
+            return {}; // Return empty vector in case of error
+        }
+    }
+
+    // With more blocks than threads progress is counted in finished blocks, otherwise the last
+    // block reports its own progress; returns nullptr in that case
+    static ProgressCallback blockProgressCallback(int count, int threads, ProgressCallback progressCallback) {
+        if (!progressCallback || count <= threads) return nullptr;
+
+        auto finished = std::make_shared<std::atomic<int>>(0);
+        return [finished, count, progressCallback](double) {
+            progressCallback(static_cast<double>(++*finished) / count);
+        };
+    }
+
+    // The line around bytes [begin, end) of 'data', at most 'context' bytes on either side
+    static std::string matchLine(const uint8_t* data, size_t size, size_t begin, size_t end, size_t context) {
+        size_t from = begin;
+        size_t to = end;
+        while (from > 0 && begin - from < context && data[from - 1] != '\n') --from;
+        while (to < size && to - end < context && data[to] != '\n' && data[to] != '\r') ++to;
+        return std::string(data + from, data + to);
+    }
+
+    // Decodes a single chunk of encoded data
+    static std::vector<uint8_t> decodeChunk(std::vector<uint8_t>& chunk, ProgressCallback progressCallback = nullptr, const uint8_t* prime = nullptr, size_t primeSize = 0) {
+        try {
+            return LZW::decode(chunk, progressCallback, prime, primeSize);
+        }
+        catch (const std::exception& e) {
+            if (!ExceptionHandler::interactive()) throw; // Fails the job instead of leaving the block empty
+            ExceptionHandler::ExceptionHandle(e);
+            return {}; // Return empty string in case of error
+        }
+    }
+
+    // Rejects a decoded block that does not match the CRC-32 stored for it in the index
+    static void checkBlock(const Archive::Entry& entry, int index, const std::vector<uint8_t>& decoded) {
+        if (!entry.hasCrc || Checksum::crc32(decoded.data(), decoded.size()) == entry.crc) return;
+        std::runtime_error error("Checksum of block " + std::to_string(index) + " does not match.");
+        if (!ExceptionHandler::interactive()) throw error; // Fails the job instead of writing damaged data
+        ExceptionHandler::ExceptionHandle(error);
+    }
+};
+
+// Settings of the statistics dump
+struct StatisticsOptions {
+    size_t windowSize = 64 * 1024; // Decoded bytes per point of the ratio curve
+    double degradation = 0.10; // A window this much worse than the best window of its block so far is reported as a degradation
+};
+
+// Dictionary and code-stream statistics of every block of an archive, written as JSON for charting
+// Each block is decoded with an observer that sees every code, so the figures describe the stream
+// as stored: phrase lengths, how many bits of each code carry information, how often codes are
+// reused, how large the dictionary grew and where the ratio got worse. Histograms use power of two
+// buckets and are written as [bucket start, count] pairs. Code bits are the widths codes are
+// written with (the growing width for entropy coded blocks, whose Huffman bits are not counted),
+// and offsets of filtered blocks refer to the filtered data.
+class CodeStatistics {
+
+public:
+    // Window whose ratio exceeded the best earlier window of its block by more than the tolerance
+    struct Degradation {
+        uint64_t offset = 0; // Start of the window in the block
+        double ratio = 0; // Ratio of the window
+        double best = 0; // Best ratio of the windows before it
+    };
+
+    struct Block {
+        size_t entry = 0; // First index entry of the block
+        uint64_t offset = 0; // Position of the block in the decoded data
+        size_t rawSize = 0; // Decoded bytes
+        size_t encodedSize = 0; // Stored bytes, trailer included
+        BlockTrailer trailer; // Width, reset, filter and priming settings of the block
+        uint64_t codes = 0; // Codes in the stream
+        uint64_t literalCodes = 0; // Codes for single bytes
+        int32_t finalDictSize = 0; // Entries when the block ended
+        int32_t peakDictSize = 0; // Most entries at any point
+        size_t resets = 0; // Dictionary resets within the block
+        std::vector<uint64_t> phraseLengths; // Codes by length of the phrase they stand for
+        std::vector<uint64_t> unusedBits; // Codes by written width minus significant bits (exact, not bucketed)
+        uint64_t writtenBits = 0; // Bits the codes are written with
+        uint64_t significantBits = 0; // Bits the code values need
+        std::vector<uint64_t> codeUses; // Distinct codes of an epoch by the number of times each was emitted
+        uint64_t distinctCodes = 0; // Distinct codes summed over the epochs
+        std::vector<std::pair<uint64_t, double>> curve; // Start and ratio of each window
+        std::vector<Degradation> degradations;
+    };
+
+    struct Report {
+        uint64_t archiveSize = 0; // Bytes of the archive
+        size_t entries = 0; // Index entries, duplicates included
+        size_t windowSize = 0; // Decoded bytes per curve point
+        std::vector<Block> blocks; // Blocks stored in the archive, duplicates once
+    };
+
+    // Decodes every block of 'archive' on 'n' threads and collects its statistics
+    static Report analyze(const std::vector<uint8_t>& archive, int n, const StatisticsOptions& options = StatisticsOptions()) {
+        std::vector<Archive::Entry> entries = Archive::readIndex(archive).entries;
+
+        // Entries sharing their encoded bytes are analysed once
+        std::vector<int> unique;
+        std::vector<int> source(entries.size());
+        std::unordered_map<uint64_t, int> firstAt;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto inserted = firstAt.emplace(entries[i].offset, static_cast<int>(unique.size()));
+            source[i] = inserted.first->second;
+            if (inserted.second) unique.push_back(static_cast<int>(i));
+        }
+
+        Report report;
+        report.archiveSize = archive.size();
+        report.entries = entries.size();
+        report.windowSize = options.windowSize;
+        report.blocks.resize(unique.size());
+
+        // Primed blocks need the block before them, so each task is a chain
+        std::vector<int> chains = Parallelization::decodeChains(archive, entries, unique);
+        WorkerPool pool(n);
+        for (size_t task = 0; task + 1 < chains.size(); ++task) {
+            pool.submit([&, task]() {
+                LzwDecoder::Workspace workspace;
+                std::vector<uint8_t> previous, decoded;
+                for (int position = chains[task]; position < chains[task + 1]; ++position) {
+                    const Archive::Entry& entry = entries[unique[position]];
+                    if (entry.offset > archive.size() || entry.size > archive.size() - entry.offset) {
+                        throw std::runtime_error("Bad compressed file.");
+                    }
+
+                    Block& block = report.blocks[position];
+                    block.entry = static_cast<size_t>(unique[position]);
+                    block.encodedSize = entry.size;
+                    block.trailer = BlockTrailer::read(archive.data() + entry.offset, entry.size);
+
+                    Collector collector(block, options);
+                    decoded.clear();
+                    LzwDecoder::decodeObserved(archive.data() + entry.offset, entry.size, decoded, workspace, collector, nullptr,
+                        position > chains[task] ? previous.data() : nullptr, position > chains[task] ? previous.size() : 0);
+                    collector.finish();
+                    block.rawSize = decoded.size();
+                    previous.swap(decoded);
+                }
+            }, static_cast<int>(task));
+        }
+        pool.wait();
+
+        // Offsets follow the entries, where duplicates take the size of the block they share
+        uint64_t offset = 0;
+        std::vector<bool> placed(unique.size(), false);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            Block& block = report.blocks[source[i]];
+            if (!placed[source[i]]) {
+                block.offset = offset;
+                placed[source[i]] = true;
+            }
+            offset += block.rawSize;
+        }
+        return report;
+    }
+
+    // Writes the report as a JSON document: totals over all blocks (dictionary sizes are the largest), then one object per block
+    static std::string toJson(const Report& report) {
+        Block totals;
+        size_t degradations = 0;
+        for (const Block& block : report.blocks) {
+            totals.rawSize += block.rawSize;
+            totals.encodedSize += block.encodedSize;
+            totals.codes += block.codes;
+            totals.literalCodes += block.literalCodes;
+            totals.finalDictSize = std::max(totals.finalDictSize, block.finalDictSize);
+            totals.peakDictSize = std::max(totals.peakDictSize, block.peakDictSize);
+            totals.resets += block.resets;
+            totals.writtenBits += block.writtenBits;
+            totals.significantBits += block.significantBits;
+            totals.distinctCodes += block.distinctCodes;
+            addHistogram(totals.phraseLengths, block.phraseLengths);
+            addHistogram(totals.unusedBits, block.unusedBits);
+            addHistogram(totals.codeUses, block.codeUses);
+            degradations += block.degradations.size();
+        }
+
+        std::ostringstream json;
+        json << std::setprecision(6);
+        json << "{\n  \"archiveSize\": " << report.archiveSize << ",\n  \"rawSize\": " << totals.rawSize
+            << ",\n  \"ratio\": " << ratio(report.archiveSize, totals.rawSize)
+            << ",\n  \"entries\": " << report.entries << ",\n  \"windowSize\": " << report.windowSize
+            << ",\n  \"totals\": {" << counters(totals) << ", \"degradations\": " << degradations << "},\n  \"blocks\": [";
+        for (size_t i = 0; i < report.blocks.size(); ++i) {
+            const Block& block = report.blocks[i];
+            const BlockTrailer& trailer = block.trailer;
+            json << (i ? "," : "") << "\n    {\"entry\": " << block.entry << ", \"offset\": " << block.offset
+                << ", \"width\": \"" << (trailer.flags & BlockTrailer::GrowingWidth ? "growing" : "final") << "\", \"bitWidth\": " << trailer.bitWidth
+                << ", \"reset\": " << boolean(trailer.flags & BlockTrailer::DictionaryReset)
+                << ", \"entropyCoded\": " << boolean(trailer.flags & BlockTrailer::EntropyCoded) << ", \"stored\": " << boolean(trailer.flags & BlockTrailer::Stored)
+                << ", \"filters\": " << static_cast<int>(trailer.filters) << ", \"elementWidth\": " << static_cast<int>(trailer.elementWidth)
+                << ", \"primedEntries\": " << trailer.primedEntries << ", " << counters(block) << ", \"curve\": [";
+            for (size_t j = 0; j < block.curve.size(); ++j) {
+                json << (j ? ", " : "") << "[" << block.curve[j].first << ", " << block.curve[j].second << "]";
+            }
+            json << "], \"degradations\": [";
+            for (size_t j = 0; j < block.degradations.size(); ++j) {
+                const Degradation& degradation = block.degradations[j];
+                json << (j ? ", " : "") << "{\"offset\": " << degradation.offset << ", \"ratio\": " << degradation.ratio << ", \"best\": " << degradation.best << "}";
+            }
+            json << "]}";
+        }
+        json << "\n  ]\n}\n";
+        return json.str();
+    }
+
+    // Formats a short summary for the console
+    static std::string drawReport(const Report& report) {
+        size_t degradations = 0;
+        uint64_t rawSize = 0, writtenBits = 0, significantBits = 0;
+        int32_t peakDictSize = 0;
+        for (const Block& block : report.blocks) {
+            degradations += block.degradations.size();
+            rawSize += block.rawSize;
+            writtenBits += block.writtenBits;
+            significantBits += block.significantBits;
+            peakDictSize = std::max(peakDictSize, block.peakDictSize);
+        }
+
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(4)
+            << " Blocks       " << report.blocks.size() << " (" << report.entries << " entries), " << GUI::drawSizeField(static_cast<size_t>(rawSize)) << "\n"
+            << " Ratio        " << ratio(report.archiveSize, rawSize) << "\n"
+            << " Dictionary   " << peakDictSize << " entries at most\n"
+            << " Code bits    " << ratio(significantBits, writtenBits) << " used\n"
+            << " Degradations " << degradations << "\n";
+        return oss.str();
+    }
+
+private:
+    // Observer of the decoder that fills one Block
+    class Collector {
+
+    public:
+        Collector(Block& block, const StatisticsOptions& options) : block(block), options(options), finalWidth(!(block.trailer.flags & (BlockTrailer::GrowingWidth | BlockTrailer::EntropyCoded))) {}
+
+        void code(int32_t code, uint32_t length, size_t index) {
+            // Index 0 after the first code means the dictionary was just reset
+            if (index == 0 && block.codes > 0) {
+                endEpoch();
+                block.resets++;
+            }
+
+            int width = finalWidth ? block.trailer.bitWidth : GrowingWidth::widthAt(index, 8);
+            int significant = 1;
+            while ((static_cast<uint32_t>(code) >> significant) != 0) ++significant;
+
+            block.codes++;
+            if (code < 256) block.literalCodes++;
+            count(block.phraseLengths, bucket(length));
+            count(block.unusedBits, static_cast<size_t>(width > significant ? width - significant : 0));
+            block.writtenBits += width;
+            block.significantBits += significant;
+
+            if (static_cast<size_t>(code) >= uses.size()) uses.resize(static_cast<size_t>(code) + 1, 0);
+            uses[code]++;
+            dictSize = static_cast<int32_t>(256 + index);
+            block.peakDictSize = std::max(block.peakDictSize, dictSize);
+
+            windowBits += width;
+            windowBytes += length;
+            if (windowBytes >= options.windowSize) endWindow();
+        }
+
+        void finish() {
+            endWindow();
+            endEpoch();
+            block.finalDictSize = dictSize;
+        }
+
+    private:
+        Block& block;
+        const StatisticsOptions& options;
+        bool finalWidth; // Every code has the trailer's width
+        std::vector<uint32_t> uses; // Times each code was emitted in the current epoch
+        int32_t dictSize = 256; // Entries after the last code
+        uint64_t position = 0; // Decoded bytes before the current window
+        uint64_t windowBits = 0, windowBytes = 0; // Code bits and decoded bytes of the current window
+        double best = 0; // Best window ratio so far, 0 before the first window
+        bool degraded = false; // The previous window was already reported
+
+        void endWindow() {
+            if (windowBytes == 0) return;
+            double windowRatio = ratio(windowBits, windowBytes * 8);
+            block.curve.emplace_back(position, windowRatio);
+
+            // Report the first window of each stretch that is worse than the best so far
+            bool worse = best > 0 && windowRatio > best * (1.0 + options.degradation);
+            if (worse && !degraded) {
+                Degradation degradation;
+                degradation.offset = position;
+                degradation.ratio = windowRatio;
+                degradation.best = best;
+                block.degradations.push_back(degradation);
+            }
+            degraded = worse;
+            best = best > 0 && best < windowRatio ? best : windowRatio;
+
+            position += windowBytes;
+            windowBits = 0;
+            windowBytes = 0;
+        }
+
+        // The dictionary starts over: count how often its codes were used
+        void endEpoch() {
+            for (uint32_t used : uses) {
+                if (used == 0) continue;
+                block.distinctCodes++;
+                count(block.codeUses, bucket(used));
+            }
+            uses.clear();
+        }
+    };
+
+    // Power of two bucket of a positive value: 1, 2-3, 4-7, ...
+    static size_t bucket(uint64_t value) {
+        size_t index = 0;
+        while (value >>= 1) ++index;
+        return index;
+    }
+
+    static void count(std::vector<uint64_t>& histogram, size_t index) {
+        if (index >= histogram.size()) histogram.resize(index + 1, 0);
+        histogram[index]++;
+    }
+
+    static void addHistogram(std::vector<uint64_t>& total, const std::vector<uint64_t>& histogram) {
+        if (histogram.size() > total.size()) total.resize(histogram.size(), 0);
+        for (size_t i = 0; i < histogram.size(); ++i) total[i] += histogram[i];
+    }
+
+    static double ratio(uint64_t numerator, uint64_t denominator) {
+        return denominator > 0 ? static_cast<double>(numerator) / denominator : 0.0;
+    }
+
+    static const char* boolean(bool value) {
+        return value ? "true" : "false";
+    }
+
+    // Histogram as [bucket start, count] pairs; 'exact' buckets start at their index instead of a power of two
+    static std::string histogram(const std::vector<uint64_t>& counts, bool exact) {
+        std::ostringstream json;
+        json << "[";
+        for (size_t i = 0; i < counts.size(); ++i) {
+            json << (i ? ", " : "") << "[" << (exact ? static_cast<uint64_t>(i) : static_cast<uint64_t>(1) << i) << ", " << counts[i] << "]";
+        }
+        json << "]";
+        return json.str();
+    }
+
+    // Fields shared by the totals and the blocks
+    static std::string counters(const Block& block) {
+        std::ostringstream json;
+        json << std::setprecision(6)
+            << "\"rawSize\": " << block.rawSize << ", \"encodedSize\": " << block.encodedSize
+            << ", \"ratio\": " << ratio(block.encodedSize, block.rawSize)
+            << ", \"dictionary\": {\"final\": " << block.finalDictSize << ", \"peak\": " << block.peakDictSize << ", \"resets\": " << block.resets << "}"
+            << ", \"codes\": " << block.codes << ", \"literalCodes\": " << block.literalCodes
+            << ", \"phraseLengths\": " << histogram(block.phraseLengths, false)
+            << ", \"codeWidth\": {\"writtenBits\": " << block.writtenBits << ", \"significantBits\": " << block.significantBits
+            << ", \"utilisation\": " << ratio(block.significantBits, block.writtenBits) << ", \"unusedBits\": " << histogram(block.unusedBits, true) << "}"
+            << ", \"codeFrequency\": {\"distinct\": " << block.distinctCodes << ", \"uses\": " << histogram(block.codeUses, false) << "}";
+        return json.str();
+    }
+};
+
+// Cancellation flag shared between the caller of an asynchronous operation and its blocks
+class CancellationToken {
+
+public:
+    CancellationToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() { *flag = true; }
+    bool cancelled() const { return *flag; }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// Thrown (or delivered) when an asynchronous operation was cancelled
+class OperationCancelled : public std::runtime_error {
+
+public:
+    OperationCancelled() : std::runtime_error("Operation cancelled.") {}
+};
+
+// Settings of an asynchronous operation
+struct AsyncOptions {
+    using Executor = std::function<void(std::function<void()>)>;
+
+    EncodeOptions encode; // How blocks are encoded (compression only)
+    ChunkingOptions chunking; // How the input is cut into blocks (compression only)
+    std::vector<uint8_t> extension; // Extension stored in the archive index (compression only)
+    CancellationToken cancellation; // Blocks not yet started are skipped once cancelled
+    std::function<void(size_t block, size_t blocks)> onBlock; // Called on a worker as each block (or chain of primed blocks when decoding) finishes
+    Executor executor; // Runs the completion (e.g. posts it to an event loop); inline on a worker when empty
+};
+
+// Non-blocking compression and decompression on a pool of workers shared by every operation
+// Operations return at once; the worker that finishes the last block assembles the result and
+// hands it to the completion (through the executor when one is set). With C++20 coroutines the
+// operations can also be awaited: co_await AsyncLzw::compress(std::move(data), options).
+class AsyncLzw {
+
+public:
+    using Completion = std::function<void(std::exception_ptr error, std::vector<uint8_t> result)>;
+
+    // Encodes 'input' into an archive and calls 'done' with it
+    static void compressAsync(std::vector<uint8_t> input, const AsyncOptions& options, Completion done) {
+        auto job = std::make_shared<Job>(options, std::move(done));
+        job->input = std::move(input);
+        std::vector<size_t> ends = Parallelization::blockEnds(job->input, pool().threadCount(), options.chunking);
+        job->blocks.resize(ends.size());
+        for (size_t i = 0; i < ends.size(); ++i) {
+            job->blocks[i].rawSize = ends[i] - (i > 0 ? ends[i - 1] : 0);
+        }
+
+        start(job, ends.size(), [job, ends](size_t index) {
+            static thread_local HashDictionary dictionary; // Stays allocated on each worker from block to block
+            Archive::Block& block = job->blocks[index];
+            const uint8_t* chunk = job->input.data() + ends[index] - block.rawSize;
+            block.crc = Checksum::crc32(chunk, block.rawSize);
+            if (job->options.chunking.contentDefined) block.hash = Checksum::sha256(chunk, block.rawSize);
+            size_t window = job->options.chunking.contentDefined ? 0 : LZW::primeWindow(index, ends, job->options.encode, pool().threadCount());
+            LZW::encodeInto(chunk, block.rawSize, block.data, dictionary, nullptr, job->options.encode, chunk - window, window);
+        }, [job]() {
+            // Repeated blocks are stored once
+            if (job->options.chunking.contentDefined) {
+                std::map<Checksum::Digest, int64_t> seen;
+                for (size_t i = 0; i < job->blocks.size(); ++i) {
+                    auto inserted = seen.emplace(job->blocks[i].hash, static_cast<int64_t>(i));
+                    if (!inserted.second) {
+                        job->blocks[i].duplicateOf = inserted.first->second;
+                        job->blocks[i].data.clear();
+                    }
+                }
+            }
+            return Archive::build(job->blocks, job->options.extension);
+        });
+    }
+
+    // Decodes an archive and calls 'done' with the original data
+    static void decompressAsync(std::vector<uint8_t> archive, const AsyncOptions& options, Completion done) {
+        auto job = std::make_shared<Job>(options, std::move(done));
+        job->input = std::move(archive);
+        try {
+            job->entries = Archive::readIndex(job->input).entries;
+        }
+        catch (...) {
+            job->finish(std::current_exception(), {});
+            return;
+        }
+        job->decoded.resize(job->entries.size());
+
+        // Primed blocks decode after the block before them, so a task is a chain of blocks
+        std::vector<int> all(job->entries.size());
+        std::iota(all.begin(), all.end(), 0);
+        std::vector<int> chains = Parallelization::decodeChains(job->input, job->entries, all);
+
+        start(job, chains.size() - 1, [job, chains](size_t chain) {
+            static thread_local LzwDecoder::Workspace workspace; // Stays allocated on each worker from block to block
+            for (int index = chains[chain]; index < chains[chain + 1]; ++index) {
+                const Archive::Entry& entry = job->entries[index];
+                if (entry.offset > job->input.size() || entry.size > job->input.size() - entry.offset) {
+                    throw std::runtime_error("Bad compressed file.");
+                }
+                const std::vector<uint8_t>* previous = index > chains[chain] ? &job->decoded[index - 1] : nullptr;
+                LzwDecoder::decodeInto(job->input.data() + entry.offset, entry.size, job->decoded[index], workspace, nullptr,
+                    previous ? previous->data() : nullptr, previous ? previous->size() : 0);
+                if (entry.hasCrc && Checksum::crc32(job->decoded[index].data(), job->decoded[index].size()) != entry.crc) {
+                    throw std::runtime_error("Checksum of block " + std::to_string(index) + " does not match.");
+                }
+            }
+        }, [job]() {
+            std::vector<uint8_t> output;
+            for (const std::vector<uint8_t>& block : job->decoded) {
+                Utility::appendVector(output, block);
+            }
+            return output;
+        });
+    }
+
+    // Future-returning forms
+    static std::future<std::vector<uint8_t>> compressAsync(std::vector<uint8_t> input, const AsyncOptions& options = AsyncOptions()) {
+        auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+        std::future<std::vector<uint8_t>> future = promise->get_future();
+        compressAsync(std::move(input), options, toPromise(promise));
+        return future;
     }
 
-    // Reset the std::once_flag
-    static void resetOnceFlag() {
-        // Destroy the current once_flag and reinitialize it
-        flag_.~once_flag();             // Explicitly call destructor
-        new (&flag_) std::once_flag();  // Placement new to reconstruct the flag
+    static std::future<std::vector<uint8_t>> decompressAsync(std::vector<uint8_t> archive, const AsyncOptions& options = AsyncOptions()) {
+        auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+        std::future<std::vector<uint8_t>> future = promise->get_future();
+        decompressAsync(std::move(archive), options, toPromise(promise));
+        return future;
     }
 
-    // Static members to manage synchronization
-    static std::mutex mutex_;  // Mutex to control access to the shared resource
-    static std::once_flag flag_; // Flag for ensuring single-time initialization with std::call_once
-};
-// Static member definitions
-std::mutex SharedResource::mutex_; // Definition of the static mutex for controlling access
-std::once_flag SharedResource::flag_; // Definition of the static once_flag for one-time initialization
+#if defined(__cpp_impl_coroutine)
+    // Awaitable operation: suspends the coroutine and resumes it (through the executor) when done
+    class Operation {
 
-// Singleton class to manage and track progress updates
-class ProgressTracker {
+    public:
+        using Starter = std::function<void(Completion)>;
 
-public:
-    // Get the singleton instance of ProgressTracker
-    // Ensures that only one instance of ProgressTracker exists
-    static ProgressTracker& getInstance() {
-        static ProgressTracker instance; // Static instance for singleton pattern
+        explicit Operation(Starter starter) : starter(std::move(starter)) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        // The starter may complete before it returns (nothing to do, unreadable index); whichever of the
+        // completion and await_suspend comes second resumes the coroutine, so it is never resumed inside the starter
+        bool await_suspend(std::coroutine_handle<> handle) {
+            starter([this, handle](std::exception_ptr error, std::vector<uint8_t> result) {
+                this->error = error;
+                this->result = std::move(result);
+                if (completed.exchange(true)) handle.resume();
+            });
+            return !completed.exchange(true);
+        }
+
+        std::vector<uint8_t> await_resume() {
+            if (error) std::rethrow_exception(error);
+            return std::move(result);
+        }
+
+    private:
+        Starter starter;
+        std::atomic<bool> completed{ false }; // Set by the first of the completion and await_suspend
+        std::exception_ptr error;
+        std::vector<uint8_t> result;
+    };
+
+    static Operation compress(std::vector<uint8_t> input, AsyncOptions options = AsyncOptions()) {
+        auto shared = std::make_shared<std::vector<uint8_t>>(std::move(input));
+        return Operation([shared, options](Completion done) { compressAsync(std::move(*shared), options, std::move(done)); });
+    }
+
+    static Operation decompress(std::vector<uint8_t> archive, AsyncOptions options = AsyncOptions()) {
+        auto shared = std::make_shared<std::vector<uint8_t>>(std::move(archive));
+        return Operation([shared, options](Completion done) { decompressAsync(std::move(*shared), options, std::move(done)); });
+    }
+#endif
+
+    // Pool shared by every asynchronous operation, one worker per processor
+    static WorkerPool& pool() {
+        static WorkerPool instance(Topology::getInstance().processorCount());
         return instance;
     }
 
-    // Delete copy constructor and assignment operator to prevent copying
-    // Ensures that the singleton instance cannot be copied or assigned
-    ProgressTracker(const ProgressTracker&) = delete;
-    ProgressTracker& operator=(const ProgressTracker&) = delete;
+private:
+    // State of one operation, kept alive by the tasks that refer to it
+    struct Job {
+        Job(const AsyncOptions& options, Completion done) : options(options), done(std::move(done)) {}
+
+        AsyncOptions options;
+        Completion done;
+        std::vector<uint8_t> input; // Data to encode, or the archive to decode
+        std::vector<Archive::Block> blocks; // Compression: encoded blocks
+        std::vector<Archive::Entry> entries; // Decompression: index of the archive
+        std::vector<std::vector<uint8_t>> decoded; // Decompression: decoded blocks
+        std::atomic<size_t> remaining{ 0 }; // Blocks not yet finished or skipped
+        std::atomic<size_t> finished{ 0 }; // Blocks finished, for onBlock
+        std::atomic<bool> stopped{ false }; // Set when a block failed; the other blocks are skipped
+        std::mutex errorMutex;
+        std::exception_ptr error; // First failure of a block
+
+        void fail(std::exception_ptr failure) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = failure;
+            stopped = true;
+        }
 
-    // Start the progress tracking process
-    // Adds the current instance to the list of active trackers
-    // Ensures that progress can be updated if the tracker is running
-    void start() {
-        if (running) return;  // Exit if the tracker is already running
+        // Hands the outcome to the completion, through the executor when there is one
+        void finish(std::exception_ptr failure, std::vector<uint8_t> result) {
+            if (!options.executor) {
+                done(failure, std::move(result));
+                return;
+            }
+            auto shared = std::make_shared<std::vector<uint8_t>>(std::move(result));
+            Completion completion = done;
+            options.executor([completion, failure, shared]() { completion(failure, std::move(*shared)); });
+        }
+    };
 
-        running = true;
-        std::lock_guard<std::mutex> lock(instancesMutex); // Lock to protect concurrent access
-        instances.push_back(this); // Add this instance to the list of active trackers
+    // Queues one task per block; the last one to finish assembles and delivers the result
+    static void start(const std::shared_ptr<Job>& job, size_t count, std::function<void(size_t)> runBlock, std::function<std::vector<uint8_t>()> assemble) {
+        if (count == 0) {
+            job->finish(nullptr, assemble());
+            return;
+        }
+
+        job->remaining = count;
+        WorkerPool& workers = pool();
+        for (size_t i = 0; i < count; ++i) {
+            workers.submit([job, i, count, runBlock, assemble]() {
+                bool skipped = job->stopped || job->options.cancellation.cancelled();
+                if (!skipped) {
+                    try {
+                        runBlock(i);
+                        size_t finished = ++job->finished;
+                        if (job->options.onBlock) job->options.onBlock(finished, count);
+                    }
+                    catch (...) {
+                        job->fail(std::current_exception()); // No point in running the other blocks
+                    }
+                }
+                if (--job->remaining > 0) return;
+
+                // Last block: assemble the result or report why there is none
+                std::exception_ptr failure;
+                {
+                    std::lock_guard<std::mutex> lock(job->errorMutex);
+                    failure = job->error;
+                }
+                if (!failure && job->options.cancellation.cancelled()) failure = std::make_exception_ptr(OperationCancelled());
+                std::vector<uint8_t> result;
+                if (!failure) {
+                    try {
+                        result = assemble();
+                    }
+                    catch (...) {
+                        failure = std::current_exception();
+                    }
+                }
+                job->finish(failure, std::move(result));
+            }, static_cast<int>(i * workers.nodeCount() / count));
+        }
     }
 
-    // Stop the progress tracking process
-    // Disables further progress updates
-    void stop() {
-        running = false;
+    static Completion toPromise(const std::shared_ptr<std::promise<std::vector<uint8_t>>>& promise) {
+        return [promise](std::exception_ptr error, std::vector<uint8_t> result) {
+            if (error) promise->set_exception(error);
+            else promise->set_value(std::move(result));
+        };
     }
+};
 
-    // Update the displayed progress value
-    // Only updates if the tracker is currently running
-    // Displays a progress bar in the console at the location of the "Progress: " text
-    // 
-    // Parameters:
-    // - progress: A double value representing the current progress (0.0 to 1.0)
-    void updateProgress(double progress) {
-        if (!running) return;  // Only update if the tracker is running
+// Job settings tuned for one machine, saved so later runs can load them
+struct TuneProfile {
+    std::string machine; // Signature of the machine the profile was tuned on
+    int threads = 0; // Worker threads
+    size_t blockSize = 0; // Size of fixed blocks, 0 for one block per thread
+    int maxCodeBits = 0; // Dictionary reset width, 0 never resets
+
+    // Processors, NUMA nodes and cache sizes; a profile from different hardware is not loaded
+    static std::string machineSignature() {
+        const Topology& topology = Topology::getInstance();
+        std::ostringstream signature;
+        signature << topology.processorCount() << "p" << topology.nodeCount() << "n"
+            << topology.cacheSize(1) << "-" << topology.cacheSize(2) << "-" << topology.cacheSize(3);
+        return signature.str();
+    }
 
-        COORD progressField = Cursor::findTextInConsole("Progress: "); // Find the location to update
-        SharedResource::printMessage(GUI::drawProgressBar(progress), progressField); // Update progress display
+    // Profile used when none was tuned for this machine: one thread per processor, one block per thread
+    static TuneProfile defaults() {
+        TuneProfile profile;
+        profile.machine = machineSignature();
+        profile.threads = Topology::getInstance().processorCount();
+        return profile;
     }
 
-    // Stop and clean up all active progress trackers
-    // Ensures that all trackers are stopped and removed from the list
-    // This method should be called to clean up before program exit or when trackers are no longer needed
-    static void shutdownAll() {
-        std::lock_guard<std::mutex> lock(instancesMutex); // Lock to protect concurrent access
-        for (auto* tracker : instances) {
-            tracker->stop(); // Stop each tracker
+    // Location of the profile: LZWPP_PROFILE, or LZWpp.profile in the working directory
+    static std::u32string defaultPath() {
+        const char* path = std::getenv("LZWPP_PROFILE");
+        return Utility::stringToU32String(path ? path : "LZWpp.profile");
+    }
+
+    // Loads the profile at 'path' if it exists and was tuned on this machine, otherwise returns the defaults
+    static TuneProfile load(const std::u32string& path = defaultPath()) {
+        std::vector<uint8_t> data;
+        try {
+            IOBackend::getInstance().readFile(path, data);
         }
-        instances.clear(); // Clear the list of trackers
+        catch (const std::exception&) {
+            return defaults();
+        }
+
+        TuneProfile profile;
+        std::istringstream lines(std::string(data.begin(), data.end()));
+        std::string line;
+        while (std::getline(lines, line)) {
+            size_t equals = line.find('=');
+            if (equals == std::string::npos) continue;
+            std::string key = line.substr(0, equals);
+            std::string value = line.substr(equals + 1);
+            if (key == "machine") profile.machine = value;
+            else if (key == "threads") profile.threads = std::atoi(value.c_str());
+            else if (key == "blockSize") profile.blockSize = std::min(static_cast<size_t>(std::strtoull(value.c_str(), nullptr, 10)), static_cast<size_t>(Archive::maxBlockSize));
+            else if (key == "maxCodeBits") profile.maxCodeBits = std::atoi(value.c_str());
+        }
+
+        if (profile.machine != machineSignature() || profile.threads < 1) return defaults();
+        return profile;
     }
 
-    // Destructor
-    // Ensures proper cleanup of all active trackers when the instance is destroyed
-    ~ProgressTracker() {
-        shutdownAll(); // Clean up all trackers
+    void save(const std::u32string& path = defaultPath()) const {
+        std::ostringstream text;
+        text << "machine=" << machine << "\n" << "threads=" << threads << "\n"
+            << "blockSize=" << blockSize << "\n" << "maxCodeBits=" << maxCodeBits << "\n";
+        std::string contents = text.str();
+        IOBackend::getInstance().writeFile(path, std::vector<uint8_t>(contents.begin(), contents.end()));
+    }
+};
+
+// Picks the reset width, block size and thread count by timing short encodes of a sample of the input
+// Each setting is tuned in turn with the ones before it fixed. The fastest reset width and block size
+// whose ratio is within 'ratioTolerance' of the best are taken, then the fewest threads within 5 % of
+// the fastest. Block sizes are tried around the sizes of the L2 and L3 caches.
+class Autotuner {
+
+public:
+    struct Trial {
+        std::string setting; // What was tried, e.g. "bits 16"
+        double ratio; // Encoded / sample size
+        double seconds; // Wall time of the encode
+    };
+
+    struct Result {
+        TuneProfile profile; // Chosen settings
+        std::vector<Trial> trials; // Every trial, in the order they ran
+        size_t sampleSize = 0; // Bytes of input each trial encoded
+    };
+
+    // Tunes on a file, reading only the sampled ranges
+    static Result tuneFile(const std::u32string& path, size_t sampleBudget = 8 << 20, double ratioTolerance = 0.02) {
+        IOBackend& io = IOBackend::getInstance();
+        uint64_t size = io.fileSize(path);
+
+        // Whole 1 MB pieces spread evenly over the file
+        const size_t pieceSize = 1 << 20;
+        std::vector<uint8_t> sample;
+        if (size <= sampleBudget) {
+            io.readFile(path, sample);
+        }
+        else {
+            uint64_t pieces = sampleBudget / pieceSize;
+            std::vector<uint8_t> piece;
+            for (uint64_t i = 0; i < pieces; ++i) {
+                io.readRange(path, (size - pieceSize) * i / (pieces > 1 ? pieces - 1 : 1), pieceSize, piece);
+                Utility::appendVector(sample, piece);
+            }
+        }
+        return tune(sample, ratioTolerance);
+    }
+
+    // Tunes on a sample held in memory
+    static Result tune(const std::vector<uint8_t>& sample, double ratioTolerance = 0.02) {
+        Result result;
+        result.sampleSize = sample.size();
+        result.profile = TuneProfile::defaults();
+        TuneProfile& profile = result.profile;
+        int processors = profile.threads;
+        if (sample.empty()) return result;
+
+        // Reset width, on blocks of 1 MB with every processor busy
+        profile.blockSize = std::min<size_t>(1 << 20, std::max<size_t>(sample.size() / processors, 64 * 1024));
+        std::vector<int> widths = { 12, 14, 16, 18, 20, 0 };
+        std::vector<Trial> widthTrials;
+        for (int bits : widths) {
+            profile.maxCodeBits = bits;
+            widthTrials.push_back(measure(sample, profile, bits ? "bits " + std::to_string(bits) : "no reset"));
+        }
+        profile.maxCodeBits = widths[pick(widthTrials, ratioTolerance)];
+        result.trials.insert(result.trials.end(), widthTrials.begin(), widthTrials.end());
+
+        // Block size, around one core's share of L2 and of L3
+        const Topology& topology = Topology::getInstance();
+        std::vector<size_t> sizes;
+        for (size_t base : { topology.cacheSize(2), topology.cacheSize(3) / processors, static_cast<size_t>(1 << 20) }) {
+            for (size_t size : { base / 2, base, base * 4 }) {
+                size = std::max<size_t>(size, 64 * 1024);
+                if (size <= sample.size() && std::find(sizes.begin(), sizes.end(), size) == sizes.end()) sizes.push_back(size);
+            }
+        }
+        if (sizes.empty()) sizes.push_back(sample.size());
+        std::vector<Trial> sizeTrials;
+        for (size_t size : sizes) {
+            profile.blockSize = size;
+            sizeTrials.push_back(measure(sample, profile, "block " + GUI::drawSizeField(size)));
+        }
+        profile.blockSize = sizes[pick(sizeTrials, ratioTolerance)];
+        result.trials.insert(result.trials.end(), sizeTrials.begin(), sizeTrials.end());
+
+        // Threads: powers of two up to the processor count
+        std::vector<int> counts;
+        for (int count = 1; count < processors; count *= 2) counts.push_back(count);
+        counts.push_back(processors);
+        std::vector<Trial> threadTrials;
+        for (int count : counts) {
+            profile.threads = count;
+            threadTrials.push_back(measure(sample, profile, std::to_string(count) + " threads"));
+        }
+        size_t fastest = 0;
+        for (size_t i = 1; i < threadTrials.size(); ++i) {
+            if (threadTrials[i].seconds < threadTrials[fastest].seconds) fastest = i;
+        }
+        size_t chosen = fastest;
+        for (size_t i = 0; i < fastest; ++i) {
+            if (threadTrials[i].seconds <= threadTrials[fastest].seconds * 1.05) {
+                chosen = i;
+                break;
+            }
+        }
+        profile.threads = counts[chosen];
+        result.trials.insert(result.trials.end(), threadTrials.begin(), threadTrials.end());
+
+        return result;
+    }
+
+    // Formats the trials and the chosen profile for the console
+    static std::string drawResult(const Result& result) {
+        std::ostringstream oss;
+        oss << " " << std::left << std::setw(24) << "Trial" << std::setw(9) << "Ratio" << "Speed\n";
+        for (const Trial& trial : result.trials) {
+            oss << " " << std::left << std::setw(24) << trial.setting
+                << std::setw(9) << std::fixed << std::setprecision(4) << trial.ratio
+                << GUI::drawSpeed(result.sampleSize, trial.seconds) << "\n";
+        }
+        oss << "\n Chosen: " << result.profile.threads << " threads, blocks of " << GUI::drawSizeField(result.profile.blockSize) << ", "
+            << (result.profile.maxCodeBits ? "reset at " + std::to_string(result.profile.maxCodeBits) + " bits" : std::string("no reset")) << "\n";
+        return oss.str();
     }
 
 private:
-    ProgressTracker() : running(false) {} // Constructor initializes the tracker as not running
-    std::atomic<bool> running; // Atomic flag to indicate if the tracker is currently running
+    // Encodes the sample with a profile's settings
+    static Trial measure(const std::vector<uint8_t>& sample, const TuneProfile& profile, const std::string& setting) {
+        using namespace std::chrono;
+        EncodeOptions options;
+        options.maxCodeBits = profile.maxCodeBits;
+        ChunkingOptions chunking;
+        chunking.blockSize = profile.blockSize;
+
+        auto start = steady_clock::now();
+        std::vector<Archive::Block> blocks = Parallelization::encodeBlocks(sample, profile.threads, nullptr, options, ParallelOptions(), chunking);
+        double seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+        size_t encoded = 0;
+        for (const Archive::Block& block : blocks) encoded += block.data.size();
+        return { setting, static_cast<double>(encoded) / sample.size(), seconds };
+    }
 
-    static std::vector<ProgressTracker*> instances; // Static list of active ProgressTracker instances
-    static std::mutex instancesMutex; // Mutex to synchronize access to the static list
+    // Fastest trial whose ratio is within 'tolerance' of the best ratio
+    static size_t pick(const std::vector<Trial>& trials, double tolerance) {
+        double bestRatio = trials[0].ratio;
+        for (const Trial& trial : trials) bestRatio = std::min(bestRatio, trial.ratio);
+
+        size_t chosen = trials.size();
+        for (size_t i = 0; i < trials.size(); ++i) {
+            if (trials[i].ratio > bestRatio * (1 + tolerance)) continue;
+            if (chosen == trials.size() || trials[i].seconds < trials[chosen].seconds) chosen = i;
+        }
+        return chosen;
+    }
 };
-// Static member definitions
-std::vector<ProgressTracker*> ProgressTracker::instances; // Define the static list of instances
-std::mutex ProgressTracker::instancesMutex; // Define the static mutex
 
-// Manages and tracks elapsed time in a separate thread
-class Timer {
+#ifndef _WIN32
+// Settings of the daemon, read from LZWPP_DAEMON (socket path), LZWPP_DAEMON_JOBS and LZWPP_DAEMON_QUEUE
+struct DaemonOptions {
+    std::string socketPath; // Unix domain socket the daemon listens on
+    int maxRunningJobs = 2; // Jobs processed at the same time; each one spreads its blocks over the shared pool
+    size_t maxQueuedJobs = 1024; // Jobs waiting beyond this are refused
+
+    static DaemonOptions fromEnvironment() {
+        DaemonOptions options;
+        if (std::getenv("LZWPP_DAEMON")) options.socketPath = std::getenv("LZWPP_DAEMON");
+        if (std::getenv("LZWPP_DAEMON_JOBS")) options.maxRunningJobs = std::max(1, std::atoi(std::getenv("LZWPP_DAEMON_JOBS")));
+        if (std::getenv("LZWPP_DAEMON_QUEUE")) options.maxQueuedJobs = std::strtoull(std::getenv("LZWPP_DAEMON_QUEUE"), nullptr, 10);
+        return options;
+    }
+};
+
+// Byte buffers handed back after a job so the next one reuses their memory
+class BufferPool {
 
 public:
-    // Constructor
-    // Initializes the timer and adds it to the static list of instances
-    Timer() : running(false), stop_thread(false) {
-        std::lock_guard<std::mutex> lock(instancesMutex); // Lock to ensure thread-safe access to static members
-        instances.push_back(this); // Add this instance to the list of active timers
+    explicit BufferPool(size_t maxBuffers) : maxBuffers(maxBuffers) {}
+
+    std::vector<uint8_t> acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (buffers.empty()) return std::vector<uint8_t>();
+        std::vector<uint8_t> buffer = std::move(buffers.back());
+        buffers.pop_back();
+        return buffer;
     }
 
-    // Destructor
-    // Ensures proper cleanup by stopping the timer and cleaning up resources
-    ~Timer() {
-        shutdown(); // Stop the timer if running
+    void release(std::vector<uint8_t>&& buffer) {
+        buffer.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (buffers.size() < maxBuffers && buffer.capacity() > 0) buffers.push_back(std::move(buffer));
     }
 
-    // Start the timer
-    // Begins tracking elapsed time in a new thread if not already running
-    void start() {
-        if (running) return; // Exit if the timer is already running
+private:
+    size_t maxBuffers; // Buffers kept at most
+    std::mutex mutex;
+    std::vector<std::vector<uint8_t>> buffers;
+};
 
-        running = true;
-        timerThread = std::thread(&Timer::printElapsedTime, this); // Launch the timer thread
-    }
+// Long-running server that takes jobs over a Unix domain socket
+// The worker pool (AsyncLzw::pool), the per-worker dictionaries and the buffers stay warm from job to job.
+// Requests are lines of tab-separated fields, answered with one line each on the same connection:
+//   <option>\t<priority>\t<input path>[\t<output path>]  option -c, -ce, -cf, -cd, -d or -v; higher priorities run first
+//   stats                                              counters of the daemon
+//   shutdown                                           finishes the queued jobs and exits
+// Answers start with "ok" or "error" followed by tab-separated key=value fields.
+class Daemon {
 
-    // Stop the timer
-    // Stops the elapsed time tracking and joins the timer thread
-    void stop() {
-        running = false; // Stop the timer thread from running
-        if (timerThread.joinable()) {
-            timerThread.join(); // Wait for the timer thread to finish
+public:
+    explicit Daemon(const DaemonOptions& options) : options(options), buffers(static_cast<size_t>(options.maxRunningJobs) * 2) {}
+
+    // Serves until a client sends "shutdown"
+    int run() {
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) throw std::runtime_error("Cannot create the daemon socket.");
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (options.socketPath.empty() || options.socketPath.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Daemon socket path not valid.");
+        }
+        std::memcpy(address.sun_path, options.socketPath.c_str(), options.socketPath.size() + 1);
+        unlink(options.socketPath.c_str()); // A socket left by an earlier run
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+            close(listener);
+            throw std::runtime_error("Cannot listen on the daemon socket.");
+        }
+
+        profile = TuneProfile::load();
+        startedAt = std::chrono::steady_clock::now();
+        AsyncLzw::pool(); // Start the workers before the first job arrives
+        for (int i = 0; i < options.maxRunningJobs; ++i) runners.emplace_back(&Daemon::runJobs, this);
+
+        // Accept until shutdown closes the listener; every connection gets its own thread
+        while (true) {
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                if (stopping) break;
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                break;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                close(client);
+                break;
+            }
+            reapConnections();
+            clients.insert(client);
+            uint64_t id = nextConnection++;
+            connections.emplace(id, std::thread(&Daemon::serve, this, client, id));
         }
+
+        // Connections waiting for a job keep the runners busy until their answers are sent
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+        for (int client : clients) ::shutdown(client, SHUT_RD); // Idle connections see the end of their input
+        jobAvailable.notify_all();
+        connectionClosed.wait(lock, [this]() { return clients.empty(); });
+        std::map<uint64_t, std::thread> open;
+        open.swap(connections);
+        lock.unlock();
+        for (auto& connection : open) connection.second.join(); // Past their last use of the daemon, so this is quick
+        for (auto& runner : runners) runner.join();
+        close(listener);
+        unlink(options.socketPath.c_str());
+        return 0;
     }
 
-    // Restart the timer
-    // Stops the current timer and starts a new one
-    void restart() {
-        stop(); // Stop the current timer
-        start(); // Start a new timer
+private:
+    struct Job {
+        uint64_t id = 0;
+        int priority = 0;
+        std::u32string option;
+        std::u32string inputPath;
+        std::u32string outputPath; // Empty: next to the input, named as the console does
+        std::chrono::steady_clock::time_point queuedAt;
+        std::promise<std::string> reply;
+    };
+
+    // Highest priority first, then in arrival order
+    struct LaterFirst {
+        bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const {
+            return a->priority != b->priority ? a->priority < b->priority : a->id > b->id;
+        }
+    };
+
+    DaemonOptions options;
+    TuneProfile profile;
+    BufferPool buffers;
+    int listener = -1;
+    std::chrono::steady_clock::time_point startedAt;
+    std::vector<std::thread> runners;
+
+    std::mutex mutex; // Guards the queue and counters
+    std::condition_variable jobAvailable;
+    std::condition_variable connectionClosed;
+    std::set<int> clients; // Open connections
+    std::map<uint64_t, std::thread> connections; // Thread serving each connection, joined once it has finished
+    std::vector<uint64_t> finishedConnections; // Connections whose thread is done with the daemon
+    uint64_t nextConnection = 1;
+    std::priority_queue<std::shared_ptr<Job>, std::vector<std::shared_ptr<Job>>, LaterFirst> queue;
+    std::atomic<bool> stopping{ false };
+    uint64_t nextId = 1;
+    int running = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+
+    // Joins the threads of finished connections; called with the mutex held
+    void reapConnections() {
+        for (uint64_t id : finishedConnections) {
+            auto connection = connections.find(id);
+            if (connection == connections.end()) continue;
+            connection->second.join();
+            connections.erase(connection);
+        }
+        finishedConnections.clear();
     }
 
-    // Shutdown the timer
-    // Alias for stop, to stop the timer and clean up resources
-    void shutdown() {
-        stop(); // Stop the timer and wait for the thread to join
+    // Answers the requests of one connection in order until the client closes it
+    void serve(int client, uint64_t id) {
+        std::string pending;
+        char chunk[4096];
+        while (true) {
+            size_t newline = pending.find('\n');
+            if (newline == std::string::npos) {
+                ssize_t received = recv(client, chunk, sizeof(chunk), 0);
+                if (received <= 0) break;
+                pending.append(chunk, static_cast<size_t>(received));
+                continue;
+            }
+
+            std::string line = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            std::string answer = handle(line) + "\n";
+            if (!sendAll(client, answer)) break;
+            if (line == "shutdown") break;
+        }
+
+        // The descriptor is closed only after it leaves the set, so accept cannot hand its number to a connection still listed
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.erase(client);
+        close(client);
+        finishedConnections.push_back(id);
+        connectionClosed.notify_all();
     }
 
-    // Stop and clean up all active timers
-    // Sets the stop flag and stops each timer, then clears the list of timers
-    static void shutdownAll() {
-        std::lock_guard<std::mutex> lock(instancesMutex); // Lock to ensure thread-safe access
-        for (auto* timer : instances) {
-            timer->stop_thread = true; // Signal all timers to stop
-            timer->stop(); // Stop the timer
+    std::string handle(const std::string& line) {
+        if (line == "stats") return stats();
+        if (line == "shutdown") {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!stopping) {
+                stopping = true;
+                ::shutdown(listener, SHUT_RDWR); // Wakes the accept loop
+            }
+            return "ok";
         }
-        instances.clear(); // Clear the list of active timers
+
+        std::vector<std::string> fields;
+        std::istringstream stream(line);
+        for (std::string field; std::getline(stream, field, '\t');) fields.push_back(field);
+        if (fields.size() < 3) return "error\tmessage=Expected option, priority and input path.";
+
+        auto job = std::make_shared<Job>();
+        job->option = Utility::stringToU32String(fields[0]);
+        job->priority = std::atoi(fields[1].c_str());
+        job->inputPath = Utility::stringToU32String(fields[2]);
+        if (fields.size() > 3) job->outputPath = Utility::stringToU32String(fields[3]);
+        if (!isDaemonOption(job->option)) return "error\tmessage=Option not valid.";
+
+        std::future<std::string> reply = job->reply.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return "error\tmessage=Daemon is shutting down.";
+            if (queue.size() >= options.maxQueuedJobs) return "error\tmessage=Queue is full.";
+            job->id = nextId++;
+            job->queuedAt = std::chrono::steady_clock::now();
+            queue.push(job);
+        }
+        jobAvailable.notify_one();
+        return reply.get();
     }
 
-    // Getter for the duration in seconds
-    long getDuration() const {
-        return duration;
+    static bool isDaemonOption(const std::u32string& option) {
+        return option == U"-c" || option == U"-ce" || option == U"-cf" || option == U"-cd" || option == U"-d" || option == U"-v";
     }
 
-private:
-    std::atomic<bool> running; // Flag to indicate if the timer is running
-    std::atomic<bool> stop_thread; // Flag to signal the timer thread to stop
-    std::thread timerThread; // Thread for tracking elapsed time
-    static std::vector<Timer*> instances; // Static list of active Timer instances
-    static std::mutex instancesMutex; // Mutex to synchronize access to the list of instances
-    std::atomic<long> duration; // Variable to store the duration in seconds
+    // Runner loop: at most maxRunningJobs of these take jobs off the queue
+    void runJobs() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            jobAvailable.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) return; // Stopping, and everything queued is done
 
-    // Function executed by the timer thread to track and display elapsed time
-    void printElapsedTime() {
-        using namespace std::chrono;
-        auto start = steady_clock::now(); // Record the start time
+            std::shared_ptr<Job> job = queue.top();
+            queue.pop();
+            running++;
+            lock.unlock();
 
-        while (running && !stop_thread) {
-            auto now = steady_clock::now(); // Get the current time
-            auto elapsed = duration_cast<seconds>(now - start).count(); // Calculate elapsed time in seconds
+            std::string answer = execute(*job);
 
-            // Find the location in the console to display the time
-            COORD sizeFieldCoord = Cursor::findTextInConsole("Time: ");
+            lock.lock();
+            running--;
+            job->reply.set_value(answer); // The counters already include this job when the client sees it
+        }
+    }
 
-            // Format the elapsed time as HH:MM:SS
-            std::ostringstream oss;
-            oss << std::setw(2) << std::setfill('0') << elapsed / 3600 << ":"        // Hours
-                << std::setw(2) << std::setfill('0') << (elapsed % 3600) / 60 << ":" // Minutes
-                << std::setw(2) << std::setfill('0') << elapsed % 60;                // Seconds
+    // Runs one job and formats its statistics
+    std::string execute(Job& job) {
+        using namespace std::chrono;
+        auto startedRun = steady_clock::now();
+        double queuedSeconds = duration<double>(startedRun - job.queuedAt).count();
+        std::ostringstream answer;
+
+        try {
+            IOBackend& io = IOBackend::getInstance();
+            std::vector<uint8_t> input = buffers.acquire();
+            io.readFile(job.inputPath, input);
+            size_t inputSize = input.size();
+            std::string detail;
+
+            AsyncOptions asyncOptions;
+            asyncOptions.encode.maxCodeBits = profile.maxCodeBits;
+            asyncOptions.chunking.blockSize = profile.blockSize;
+            std::vector<uint8_t> output;
+            std::u32string outputPath = job.outputPath;
+
+            if (job.option == U"-d" || job.option == U"-v") {
+                std::vector<uint8_t> extension = Archive::readIndex(input).extension;
+                std::u32string base = job.inputPath.size() > 4 && job.inputPath.compare(job.inputPath.size() - 4, 4, U".bin") == 0
+                    ? job.inputPath.substr(0, job.inputPath.size() - 4) : job.inputPath;
+                output = AsyncLzw::decompressAsync(std::move(input), asyncOptions).get();
+
+                if (job.option == U"-v") {
+                    // Compare with the original next to the archive (or the named one); the stored checksums were checked while decoding
+                    std::u32string sourcePath = outputPath.empty() ? base + Utility::bytesToString(extension) : outputPath;
+                    outputPath.clear();
+                    detail = "\tagainst=checksums";
+                    if (Utility::fileExists(sourcePath)) {
+                        std::vector<uint8_t> source = buffers.acquire();
+                        io.readFile(sourcePath, source);
+                        auto difference = std::mismatch(output.begin(), output.end(), source.begin(), source.end());
+                        if (difference.first != output.end() || difference.second != source.end()) {
+                            detail = "\tagainst=source\tmismatch=" + std::to_string(difference.first - output.begin());
+                        }
+                        else {
+                            detail = "\tagainst=source";
+                        }
+                        buffers.release(std::move(source));
+                    }
+                }
+                else if (outputPath.empty()) {
+                    outputPath = base + U" Decoded" + Utility::bytesToString(extension);
+                }
+            }
+            else {
+                asyncOptions.encode.entropyCoding = job.option == U"-ce";
+                asyncOptions.encode.filters = job.option == U"-cf" ? BlockFilter::Auto : 0;
+                asyncOptions.chunking.contentDefined = job.option == U"-cd";
+                size_t dot = job.inputPath.find_last_of(U'.');
+                size_t slash = job.inputPath.find_last_of(U"/\\");
+                if (dot != std::u32string::npos && (slash == std::u32string::npos || dot > slash)) {
+                    asyncOptions.extension = Utility::stringToBytes(job.inputPath.substr(dot));
+                }
+                if (outputPath.empty()) outputPath = (dot != std::u32string::npos && (slash == std::u32string::npos || dot > slash) ? job.inputPath.substr(0, dot) : job.inputPath) + U".bin";
+                output = AsyncLzw::compressAsync(std::move(input), asyncOptions).get();
+            }
+
+            if (!outputPath.empty()) io.writeFile(outputPath, output);
+            size_t outputSize = output.size();
+            buffers.release(std::move(output));
+
+            double runSeconds = duration<double>(steady_clock::now() - startedRun).count();
+            bool ok = detail.find("mismatch=") == std::string::npos;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                (ok ? completed : failed)++;
+                bytesIn += inputSize;
+                bytesOut += outputSize;
+            }
+            answer << (ok ? "ok" : "error") << "\tjob=" << job.id << "\toption=" << Utility::u32stringToString(job.option)
+                << "\tin=" << inputSize << "\tout=" << outputSize << std::fixed << std::setprecision(4)
+                << "\tratio=" << (inputSize ? static_cast<double>(outputSize) / inputSize : 0.0)
+                << std::setprecision(3) << "\tqueued_s=" << queuedSeconds << "\trun_s=" << runSeconds
+                << "\tmb_per_s=" << (runSeconds > 0 ? inputSize / runSeconds / (1024 * 1024) : 0.0) << detail;
+        }
+        catch (const std::exception& e) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed++;
+            }
+            answer << "error\tjob=" << job.id << "\tmessage=" << e.what();
+        }
+        return answer.str();
+    }
 
-            std::string formattedTime = oss.str(); // Get the formatted time string
-            SharedResource::printMessage(formattedTime, sizeFieldCoord); // Update the console display
+    std::string stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream answer;
+        answer << "ok\tqueued=" << queue.size() << "\trunning=" << running << "\tcompleted=" << completed << "\tfailed=" << failed
+            << "\tbytes_in=" << bytesIn << "\tbytes_out=" << bytesOut << "\tworkers=" << AsyncLzw::pool().threadCount()
+            << std::fixed << std::setprecision(0) << "\tuptime_s=" << std::chrono::duration<double>(std::chrono::steady_clock::now() - startedAt).count();
+        return answer.str();
+    }
 
-            std::this_thread::sleep_for(seconds(1)); // Wait for one second before updating again
+    static bool sendAll(int client, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t written = send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            sent += static_cast<size_t>(written);
         }
-        duration = duration_cast<seconds>(steady_clock::now() - start).count() - 1; // Calculate elapsed time in milliseconds ( -1 to remove the last second of sleep)
+        return true;
     }
 };
-// Static member definitions for Timer
-std::vector<Timer*> Timer::instances; // Initialize the static list of Timer instances
-std::mutex Timer::instancesMutex; // Initialize the static mutex for synchronizing access to the list
+#endif
+
+// State behind the C interface: options plus the buffers reused from call to call
+struct lzw_context {
+    EncodeOptions options;
+    size_t blockSize = LZW_DEFAULT_BLOCK_SIZE; // Bytes per block; large inputs are cut into many blocks, as on the command line
+    HashDictionary dictionary; // Encoder dictionary
+    LzwDecoder::Workspace workspace; // Decoder tables
+    std::vector<uint8_t> block; // Encoded block, or decoded block of an archive without sizes
+    Archive::Index index; // Entries of the archive being written
+};
 
-// Manages exception handling and error behavior
-class ExceptionHandler {
+// Implementation of the C interface declared in LZWpp.h
+// Exceptions never cross it: every failure becomes an lzw_status.
+class CInterface {
 
 public:
-    // Handles exceptions by logging the error and performing necessary cleanups
-    static void ExceptionHandle(const std::exception& e) {
-        // Ensure that error handling occurs only once to avoid redundant outputs
-        std::call_once(SharedResource::flag_, [&]() {
-            // Lock to ensure thread-safe access to shared resources
-            std::lock_guard<std::mutex> guard(SharedResource::mutex_);
+    static int compress(lzw_context& context, const uint8_t* src, size_t srclen, uint8_t* dst, size_t dstcap, size_t* dstlen) {
+        context.index.entries.clear();
+        size_t written = 0;
 
-            // Get the current cursor position and move to a new line for error output
-            COORD pos = Cursor::getLastConsoleChar();
-            Cursor::goTo(0, pos.Y + 2);
+        size_t start = 0;
+        size_t previous = 0; // Size of the block before this one
+        do {
+            size_t length = srclen - start < context.blockSize ? srclen - start : context.blockSize;
+
+            // Blocks are decoded one after another here, so every block but the first of a chain may be primed
+            size_t index = context.index.entries.size();
+            size_t window = 0;
+            if (context.options.primeBytes > 0 && index > 0 && (context.options.primeChain <= 0 || index % context.options.primeChain != 0)) {
+                window = previous < context.options.primeBytes ? previous : context.options.primeBytes;
+            }
+            LZW::encodeInto(src + start, length, context.block, context.dictionary, nullptr, context.options, src + start - window, window);
+            if (context.block.size() > dstcap - written) return LZW_ERROR_DST_TOO_SMALL;
+            if (!context.block.empty()) std::memcpy(dst + written, context.block.data(), context.block.size());
+
+            Archive::Entry entry;
+            entry.offset = written;
+            entry.size = static_cast<uint32_t>(context.block.size());
+            entry.rawSize = static_cast<uint32_t>(length);
+            entry.crc = Checksum::crc32(src + start, length);
+            entry.hasCrc = true;
+            context.index.entries.push_back(entry);
+            written += context.block.size();
+            start += length;
+            previous = length;
+        } while (start < srclen); // An empty input still gets one (empty) block
+
+        std::vector<uint8_t> index = Archive::indexBytes(context.index);
+        if (index.size() > dstcap - written) return LZW_ERROR_DST_TOO_SMALL;
+        std::memcpy(dst + written, index.data(), index.size());
+        *dstlen = written + index.size();
+        return LZW_OK;
+    }
 
-            // Convert exception message to a Unicode string and print it at the console
-            Cursor::writeOutputStream(Utility::stringToU32String(e.what()), 58, errorCallback());
+    static int decompress(lzw_context& context, const uint8_t* src, size_t srclen, uint8_t* dst, size_t dstcap, size_t* dstlen) {
+        Archive::Index index = Archive::readIndex(src, srclen);
+        size_t written = 0;
+        size_t previous = 0; // Size of the block before this one, already in 'dst'
+
+        for (const Archive::Entry& entry : index.entries) {
+            if (entry.offset > srclen || entry.size > srclen - entry.offset) return LZW_ERROR_CORRUPT;
+            const uint8_t* block = src + entry.offset;
+
+            // Known sizes let the block be checked against the space left before decoding it
+            if (!index.legacy && entry.rawSize > dstcap - written) return LZW_ERROR_DST_TOO_SMALL;
+
+            context.block.clear();
+            LzwDecoder::decodeInto(block, entry.size, context.block, context.workspace, nullptr, dst + written - previous, previous);
+            if (!index.legacy && context.block.size() != entry.rawSize) return LZW_ERROR_CORRUPT; // Damaged, not too big for 'dst'
+            if (context.block.size() > dstcap - written) return LZW_ERROR_DST_TOO_SMALL;
+            if (entry.hasCrc && Checksum::crc32(context.block.data(), context.block.size()) != entry.crc) return LZW_ERROR_CORRUPT;
+            if (!context.block.empty()) std::memcpy(dst + written, context.block.data(), context.block.size());
+            written += context.block.size();
+            previous = context.block.size();
+        }
 
-            // Shut down all active timers and progress trackers
-            Timer::shutdownAll();
-            ProgressTracker::shutdownAll();
+        *dstlen = written;
+        return LZW_OK;
+    }
 
-            // Pause the cursor to stop any further console updates
-            Cursor::pause();
-            });
+    // Runs 'operation', turning exceptions into status codes
+    template <class Operation>
+    static int guard(Operation operation) {
+        try {
+            return operation();
+        }
+        catch (const std::bad_alloc&) {
+            return LZW_ERROR_OUT_OF_MEMORY;
+        }
+        catch (const std::runtime_error&) {
+            return LZW_ERROR_CORRUPT; // Thrown by the index parser and the decoder on bad input
+        }
+        catch (...) {
+            return LZW_ERROR_INTERNAL;
+        }
     }
+};
 
-    // Configures settings to suppress assertion pop-ups in debug builds
-    static void DisableAssertionPopups() {
-        // Set a custom report hook to handle CRT reports
-        _CrtSetReportHook(CustomReportHook);
+extern "C" {
 
-        // Set report modes to redirect CRT assertions and errors to a file instead of showing pop-ups
-        _CrtSetReportMode(_CRT_ASSERT, _CRTDBG_MODE_FILE);
-        _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
-        _CrtSetReportMode(_CRT_WARN, _CRTDBG_MODE_FILE);
+LZWPP_API unsigned lzw_version(void) {
+    return LZWPP_API_VERSION;
+}
+
+LZWPP_API lzw_context* lzw_context_create(void) {
+    try {
+        return new lzw_context();
+    }
+    catch (...) {
+        return nullptr;
     }
+}
 
-private:
-    // Custom report hook function to handle CRT reports
-    static int CustomReportHook(int reportType, char* message, int* returnValue) {
-        // Create an exception from the report message and handle it
-        std::exception e(message);
-        ExceptionHandle(e);
+LZWPP_API void lzw_context_free(lzw_context* context) {
+    delete context;
+}
 
-        return 1; // Return 1 to indicate that the report was handled
+LZWPP_API int lzw_context_set_option(lzw_context* context, lzw_option option, long long value) {
+    if (!context) return LZW_ERROR_INVALID_ARGUMENT;
+    switch (option) {
+    case LZW_OPT_MAX_CODE_BITS:
+        if (value != 0 && (value < 9 || value > 30)) return LZW_ERROR_INVALID_ARGUMENT;
+        context->options.maxCodeBits = static_cast<int>(value);
+        return LZW_OK;
+    case LZW_OPT_GROWING_WIDTH:
+        context->options.growingWidth = value != 0;
+        return LZW_OK;
+    case LZW_OPT_ENTROPY_CODING:
+        context->options.entropyCoding = value != 0;
+        return LZW_OK;
+    case LZW_OPT_FILTERS:
+        if (value < 0 || value > (BlockFilter::Delta | BlockFilter::Shuffle | BlockFilter::RunLength | BlockFilter::Auto)) return LZW_ERROR_INVALID_ARGUMENT;
+        context->options.filters = static_cast<uint8_t>(value);
+        return LZW_OK;
+    case LZW_OPT_ELEMENT_WIDTH:
+        if (value < 1 || value > 255) return LZW_ERROR_INVALID_ARGUMENT;
+        context->options.elementWidth = static_cast<int>(value);
+        return LZW_OK;
+    case LZW_OPT_PRIME_BYTES:
+        if (value < 0 || value > LZW_MAX_BLOCK_SIZE) return LZW_ERROR_INVALID_ARGUMENT;
+        context->options.primeBytes = static_cast<size_t>(value);
+        return LZW_OK;
+    case LZW_OPT_PRIME_CHAIN:
+        if (value < 0 || value > std::numeric_limits<int>::max()) return LZW_ERROR_INVALID_ARGUMENT;
+        context->options.primeChain = static_cast<int>(value);
+        return LZW_OK;
+    case LZW_OPT_LONG_REPEATS:
+        context->options.longRepeats = value != 0;
+        return LZW_OK;
+    case LZW_OPT_BLOCK_SIZE:
+        if (value != 0 && (value < LZW_MIN_BLOCK_SIZE || value > LZW_MAX_BLOCK_SIZE)) return LZW_ERROR_INVALID_ARGUMENT;
+        context->blockSize = value != 0 ? static_cast<size_t>(value) : LZW_DEFAULT_BLOCK_SIZE;
+        return LZW_OK;
     }
+    return LZW_ERROR_INVALID_ARGUMENT;
+}
 
-    // Creates a callback function to update the console display with error information
-    static std::function<void()> errorCallback() {
-        // Get the current end position of the console and move to a new line
-        COORD endOfConsole = Cursor::getLastConsoleChar();
-        Cursor::goTo(0, endOfConsole.Y + 1);
+LZWPP_API size_t lzw_compress_bound(size_t srclen) {
+    // The run-length filter can add a byte per 128, then at most one code per byte,
+    // none wider than the dictionary can get: 256 + (filtered size) entries
+    size_t blocks = srclen / LZW_MIN_BLOCK_SIZE + 1;
+    uint64_t filtered = static_cast<uint64_t>(srclen) + srclen / 128 + blocks;
+    int width = 8;
+    while (width < 64 && filtered + 256 > (1ull << width)) ++width;
+    size_t codeBytes = static_cast<size_t>((filtered * width + 7) / 8);
+    return codeBytes + blocks * 25 + Archive::indexSize(blocks, 0); // A partial byte and a trailer of up to 24 bytes (BlockTrailer) per block
+}
 
-        // Draw an error screen to provide visual feedback on the error
-        std::cout << GUI::drawErrorScreen();
+LZWPP_API int lzw_compress(lzw_context* context, const void* src, size_t srclen, void* dst, size_t dstcap, size_t* dstlen) {
+    if (!context || (!src && srclen > 0) || (!dst && dstcap > 0) || !dstlen) return LZW_ERROR_INVALID_ARGUMENT;
+    return CInterface::guard([&]() {
+        return CInterface::compress(*context, static_cast<const uint8_t*>(src), srclen, static_cast<uint8_t*>(dst), dstcap, dstlen);
+    });
+}
 
-        // Locate the error field in the console and move the cursor to it
-        COORD errorField = Cursor::findTextInConsole("Error: ");
-        Cursor::goTo(errorField.X, errorField.Y);
+LZWPP_API int lzw_decompressed_size(const void* src, size_t srclen, unsigned long long* size) {
+    if (!src || !size) return LZW_ERROR_INVALID_ARGUMENT;
+    return CInterface::guard([&]() {
+        Archive::Index index = Archive::readIndex(static_cast<const uint8_t*>(src), srclen);
+        if (index.legacy) return static_cast<int>(LZW_ERROR_CORRUPT);
+        unsigned long long total = 0;
+        for (const Archive::Entry& entry : index.entries) total += entry.rawSize;
+        *size = total;
+        return static_cast<int>(LZW_OK);
+    });
+}
 
-        // Define a lambda function to update the console display for the output field
-        auto lineChangeCallbackOutput = []() {
-            std::string screenUpdate = {
-                    "\n |                                                                  |"
-                    "\n \\__________________________________________________________________/"
-            };
-            std::cout << screenUpdate; // Output the update to the console
-        };
+LZWPP_API int lzw_decompress(lzw_context* context, const void* src, size_t srclen, void* dst, size_t dstcap, size_t* dstlen) {
+    if (!context || !src || (!dst && dstcap > 0) || !dstlen) return LZW_ERROR_INVALID_ARGUMENT;
+    return CInterface::guard([&]() {
+        return CInterface::decompress(*context, static_cast<const uint8_t*>(src), srclen, static_cast<uint8_t*>(dst), dstcap, dstlen);
+    });
+}
 
-        return lineChangeCallbackOutput; // Return the lambda function as the callback
-    }
-};
+}
 
-// Provides multi-threaded functionality for encoding and decoding algorithms
-class Parallelization {
+#ifndef LZWPP_NO_MAIN
+// Command line front end for scripts and machines without a console
+// Runs the one job given as arguments and reports the result through the exit code:
+//   LZWpp <option> [-o OUTPUT] [--threads N] [--block-size BYTES] [--reset-bits N] [--deadline SECONDS] [--stats FILE] [--progress] [INPUT]
+// Options are those of the console screens. INPUT and OUTPUT may be "-" for the standard streams;
+// data read from the standard input goes to the standard output unless -o names a file. Settings
+// left out come from the tuned profile, as on the console.
+class CommandLine {
 
 public:
-    using ProgressCallback = std::function<void(double)>;
+    enum ExitCode {
+        Success = 0,
+        Failure = 1, // The job failed (missing file, corrupt archive, I/O error)
+        BadArguments = 2, // The arguments could not be understood
+        Mismatch = 3, // Verification found data that differs
+        NoMatch = 4, // A search found no pattern
+        Unverified = 5 // Verification had nothing to compare with (no stored checksums, no source file)
+    };
 
-    // Parallel encoding of a Unicode string
-    // Splits the input into chunks, encodes each chunk in parallel, and combines the results
-    // O(n) where n is the number of threads
-    static std::vector<uint8_t> parallelEncode(const std::vector<uint8_t>& input, int n, ProgressCallback progressCallback = nullptr) {
+    struct Arguments {
+        std::u32string option; // Job, one of Utility::isValidOption or -g (search, command line only)
+        std::u32string input = U"-"; // Input file, "-" for the standard input
+        std::u32string output; // Output file, "-" for the standard output, empty to name it after the input
+        std::u32string stats; // File for a JSON summary of the run, empty for none
+        int threads = 0; // Worker threads, 0 takes the profile's
+        size_t blockSize = 0; // Bytes per fixed block, 0 takes the profile's
+        int maxCodeBits = -1; // Dictionary reset width (0 never resets), -1 takes the profile's
+        double deadline = 0; // Seconds a compress job may take before blocks are downgraded (see Deadline), 0 none
+        bool progress = false; // Report progress on the standard error stream
+        std::vector<std::string> patterns; // Patterns to search for with -g
+        size_t maxMatches = 0; // Matches a search reports, 0 for all
+        bool searchIndex = false; // Store search filters in the index of a compressed archive
+        bool sparse = true; // Leave long runs of zeros in a decompressed file as holes (see ZeroRuns)
+        uint64_t memory = 0; // Memory budget in bytes (see MemoryGovernor), 0 takes LZWPP_MEMORY_MB
+    };
 
-        // Split input into chunks
-        std::vector<std::vector<uint8_t>> chunks(n);
-        size_t chunkSize = input.size() / n;
-        std::vector<std::vector<uint8_t>> encodedChunks(n);
-        size_t maxChunkSize = 0;
+    static int run(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            if (std::string(argv[i]) == "-h" || std::string(argv[i]) == "--help") {
+                std::cout << usage();
+                return Success;
+            }
+        }
 
-        for (int i = 0; i < n; ++i) {
-            size_t start = i * chunkSize;
-            size_t end = (i == n - 1) ? input.size() : start + chunkSize;
-            chunks[i] = std::vector<uint8_t>(input.begin() + start, input.begin() + end);
+        Arguments arguments;
+        try {
+            arguments = parse(argc, argv);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n" << usage();
+            return BadArguments;
         }
 
-        std::vector<std::thread> threads;
-        std::mutex resultMutex;
+        try {
+            return execute(arguments);
+        }
+        catch (const std::exception& e) {
+            ExceptionHandler::ExceptionHandle(e);
+            return Failure;
+        }
+    }
 
-        // Lambda function to encode each chunk
-        auto processTask = [&](int index) {
-            std::vector<uint8_t> encoded = encodeChunk(chunks[index], index == n - 1 ? progressCallback : nullptr);
-            std::lock_guard<std::mutex> lock(resultMutex);
-            encodedChunks[index] = encoded;
-            maxChunkSize = maxChunkSize > encoded.size() ? maxChunkSize : encoded.size(); // Track maximum chunk size
-        };
+    static Arguments parse(int argc, char* argv[]) {
+        Arguments arguments;
+        bool inputSet = false;
+        for (int i = 1; i < argc; ++i) {
+            std::string argument = argv[i];
+            auto value = [&]() {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value after " + argument + ".");
+                return std::string(argv[++i]);
+            };
 
-        // Launch encoding threads
-        for (int i = 0; i < n; ++i) {
-            threads.emplace_back(processTask, i);
+            if (argument == "-o" || argument == "--output") arguments.output = Utility::stringToU32String(value());
+            else if (argument == "--stats") arguments.stats = Utility::stringToU32String(value());
+            else if (argument == "--threads") arguments.threads = static_cast<int>(parseNumber(value(), 1, 4096));
+            else if (argument == "--block-size") arguments.blockSize = static_cast<size_t>(parseNumber(value(), 1, Archive::maxBlockSize));
+            else if (argument == "--reset-bits") arguments.maxCodeBits = static_cast<int>(parseNumber(value(), 0, 30));
+            else if (argument == "--deadline") arguments.deadline = parseSeconds(value());
+            else if (argument == "--progress") arguments.progress = true;
+            else if (argument == "--search-index") arguments.searchIndex = true;
+            else if (argument == "--no-sparse") arguments.sparse = false;
+            else if (argument == "--memory") arguments.memory = parseNumber(value(), 16 << 20, std::numeric_limits<uint64_t>::max());
+            else if (argument == "--max-matches") arguments.maxMatches = static_cast<size_t>(parseNumber(value(), 1, std::numeric_limits<uint32_t>::max()));
+            else if (argument == "-g" && (arguments.option.empty() || arguments.option == U"-g")) {
+                arguments.option = U"-g";
+                arguments.patterns.push_back(value());
+                if (arguments.patterns.back().empty()) throw std::runtime_error("Empty search pattern.");
+            }
+            else if (arguments.option.empty() && Utility::isValidOption(Utility::stringToU32String(argument))) arguments.option = Utility::stringToU32String(argument);
+            else if (!inputSet && (argument == "-" || argument[0] != '-')) {
+                arguments.input = Utility::stringToU32String(argument);
+                inputSet = true;
+            }
+            else throw std::runtime_error("Unknown argument " + argument + ".");
         }
 
-        // Wait for all threads to complete
-        for (auto& thread : threads) {
-            thread.join();
+        if (arguments.option.empty()) throw std::runtime_error("No option given.");
+        if (arguments.option == U"-a" && (arguments.output.empty() ? arguments.input == U"-" : arguments.output == U"-")) {
+            throw std::runtime_error("Appending needs an archive file.");
         }
+        return arguments;
+    }
 
-        // Combine all encoded chunks into a final result
-        std::vector<uint8_t> finalResult;
-        concatenateWithMetadata(encodedChunks, finalResult);
+    static std::string usage() {
+        return
+            "Usage: LZWpp <option> [-o OUTPUT] [--threads N] [--block-size BYTES] [--reset-bits N] [--deadline SECONDS] [--search-index] [--no-sparse] [--memory BYTES] [--stats FILE] [--progress] [INPUT]\n"
+            "       LZWpp -g PATTERN [-g PATTERN]... [--max-matches N] [-o OUTPUT] [--threads N] [ARCHIVE]\n"
+            "  -c   compress                 -d  decompress\n"
+            "  -ce  compress, entropy coded  -a  compress and append to OUTPUT\n"
+            "  -cf  compress, record filters -v  verify an archive\n"
+            "  -cp  compress, primed blocks  -b  benchmark the policies\n"
+            "  -cd  compress, deduplicated   -e  estimate ratio and time\n"
+            "  -s   code statistics as JSON  -t  tune a profile for this machine\n"
+            "  -g   search an archive for PATTERN, printing OFFSET:LINE per match\n"
+            "INPUT and OUTPUT default to the standard streams; sizes take K, M or G.\n"
+            "With --deadline, compression switches blocks to faster settings or stores them to finish in time.\n"
+            "With --search-index, the index keeps a filter per block that lets -g skip blocks without the patterns.\n"
+            "-d leaves runs of zeros of 64K or more as holes of a sparse file; --no-sparse writes them out.\n"
+            "With --memory, blocks wait for memory and shrink to fit the budget (LZWPP_MEMORY_MB=auto: the container's limit).\n"
+            "Exit codes: 0 success, 1 failure, 2 bad arguments, 3 verification mismatch, 4 no match found,\n"
+            "            5 nothing to verify against.\n";
+    }
 
-        return finalResult;
+    // Encoder settings of a compress option
+    static EncodeOptions encodeOptions(const std::u32string& option, const TuneProfile& profile) {
+        EncodeOptions options;
+        options.entropyCoding = option == U"-ce";
+        options.filters = option == U"-cf" ? BlockFilter::Auto : 0;
+        options.primeBytes = option == U"-cp" ? 32 * 1024 : 0;
+        options.maxCodeBits = profile.maxCodeBits;
+        return options;
     }
 
-    // Parallel decoding of a binary vector
-    // Splits the input into chunks, decodes each chunk in parallel, and combines the results
-    // O(n) where n is the number of threads
-    static std::vector<uint8_t> parallelDecode(const std::vector<uint8_t>& input, int n, ProgressCallback progressCallback = nullptr) {
+    // Block layout of a compress option
+    static ChunkingOptions chunkingOptions(const std::u32string& option, const TuneProfile& profile) {
+        ChunkingOptions chunking;
+        chunking.contentDefined = option == U"-cd" || option == U"-a";
+        chunking.blockSize = profile.blockSize;
+        return chunking;
+    }
 
-        std::vector<uint8_t> originalVec(input.begin(), input.end());
-        // Split input into chunks
-        std::vector<std::vector<uint8_t>> chunks(n);
-        splitWithMetadata(originalVec, chunks);
+    static bool isCompressOption(const std::u32string& option) {
+        return option == U"-c" || option == U"-ce" || option == U"-cf" || option == U"-cp" || option == U"-cd" || option == U"-a";
+    }
 
-        std::vector<std::vector<uint8_t>> results(n);
-        std::vector<std::thread> threads;
-        std::mutex resultMutex;
+    // Block cache named by LZWPP_CACHE (limit in MB from LZWPP_CACHE_MB), or null
+    static std::unique_ptr<BlockCache> cacheFromEnvironment() {
+        std::unique_ptr<BlockCache> cache;
+        if (std::getenv("LZWPP_CACHE")) {
+            CacheOptions cacheOptions;
+            cacheOptions.directory = Utility::stringToU32String(std::getenv("LZWPP_CACHE"));
+            if (std::getenv("LZWPP_CACHE_MB")) cacheOptions.maxBytes = std::strtoull(std::getenv("LZWPP_CACHE_MB"), nullptr, 10) << 20;
+            cache.reset(new BlockCache(cacheOptions));
+        }
+        return cache;
+    }
 
-        // Lambda function to decode each chunk
-        auto processTask = [&](int index) {
-            std::vector<uint8_t> decoded = decodeChunk(chunks[index], index == n - 1 ? progressCallback : nullptr);
-            std::lock_guard<std::mutex> lock(resultMutex);
-            results[index] = decoded;
-        };
+    // Splits a path into the part before its extension and the extension with its dot
+    static void splitExtension(const std::u32string& path, std::u32string& base, std::u32string& extension) {
+        size_t dot = path.find_last_of(U'.');
+        size_t slash = path.find_last_of(U"/\\");
+        bool hasExtension = dot != std::u32string::npos && (slash == std::u32string::npos || dot > slash);
+        base = hasExtension ? path.substr(0, dot) : path;
+        extension = hasExtension ? path.substr(dot) : std::u32string();
+    }
+
+private:
+    static int execute(const Arguments& arguments) {
+        using namespace std::chrono;
+        auto started = steady_clock::now();
+        const std::u32string& option = arguments.option;
+
+        // The budget starts with the job, reading the input included
+        std::unique_ptr<Deadline> deadline;
+        if (arguments.deadline > 0 && isCompressOption(option)) {
+            DeadlineOptions deadlineOptions;
+            deadlineOptions.seconds = arguments.deadline;
+            deadline.reset(new Deadline(deadlineOptions));
+        }
 
-        // Launch decoding threads
-        for (int i = 0; i < n; ++i) {
-            threads.emplace_back(processTask, i);
+        TuneProfile profile = TuneProfile::load();
+        if (arguments.threads > 0) profile.threads = arguments.threads;
+        if (arguments.blockSize > 0) profile.blockSize = arguments.blockSize;
+        if (arguments.maxCodeBits >= 0) profile.maxCodeBits = arguments.maxCodeBits;
+
+        Throttle::getInstance().configure(ThrottleOptions::fromEnvironment());
+#ifndef _WIN32
+        Throttle::installSignalHandlers();
+#endif
+        MemoryOptions memoryOptions = MemoryOptions::fromEnvironment();
+        if (arguments.memory > 0) memoryOptions.budget = arguments.memory;
+        MemoryGovernor::getInstance().configure(memoryOptions);
+
+        const bool fromStandardInput = arguments.input == U"-";
+        std::u32string base, extension;
+        if (!fromStandardInput) {
+            if (!Utility::fileExists(arguments.input)) throw std::runtime_error("File not found at input path.");
+            splitExtension(arguments.input, base, extension);
         }
 
-        // Wait for all threads to complete
-        for (auto& thread : threads) {
-            thread.join();
+        // Outputs named after the input, or the standard output when the input came from the standard input
+        auto outputPath = [&](const std::u32string& derived) {
+            if (!arguments.output.empty()) return arguments.output;
+            return fromStandardInput ? std::u32string(U"-") : derived;
+        };
+        auto write = [](const std::u32string& path, const std::vector<uint8_t>& data) {
+            if (path == U"-") Utility::writeStandardOutput(data);
+            else Utility::writeVectorToFile(path, data);
+        };
+        auto writeText = [&](const std::string& text) {
+            write(arguments.output.empty() ? U"-" : arguments.output, std::vector<uint8_t>(text.begin(), text.end()));
+        };
+
+        // Progress in whole percents on the standard error stream
+        std::function<void(double)> progressCallback;
+        if (arguments.progress) {
+            auto shown = std::make_shared<std::atomic<int>>(-1);
+            progressCallback = [shown](double progress) {
+                int percent = static_cast<int>(progress * 100);
+                if (percent > shown->exchange(percent)) std::cerr << "\r" << percent << " %" << std::flush;
+            };
         }
 
-        // Combine all decoded results into a final std::vector<uint8_t>
-        std::vector<uint8_t> finalResult;
-        for (const auto& result : results) {
-            Utility::appendVector(finalResult, result);
+        int exitCode = Success;
+        uint64_t inputSize = 0, outputSize = 0;
+        Parallelization::SearchResult searched;
+        std::vector<ZeroRuns::Run> holes; // Left unwritten by -d
+
+        // Tuning and estimates read only samples of a file
+        if (option == U"-t" || option == U"-e") {
+            std::vector<uint8_t> input;
+            if (fromStandardInput) Utility::readStandardInput(input);
+            inputSize = fromStandardInput ? input.size() : Utility::getFileSize(arguments.input);
+
+            std::string text;
+            if (option == U"-t") {
+                if (fromStandardInput && input.size() > (8 << 20)) input.resize(8 << 20); // Same budget as a file sample
+                Autotuner::Result tuned = fromStandardInput ? Autotuner::tune(input) : Autotuner::tuneFile(arguments.input);
+                tuned.profile.save();
+                text = Autotuner::drawResult(tuned);
+            }
+            else {
+                EncodeOptions estimateOptions;
+                estimateOptions.maxCodeBits = profile.maxCodeBits;
+                text = Estimator::drawEstimate(fromStandardInput
+                    ? Estimator::estimate(input, profile.threads, estimateOptions)
+                    : Estimator::estimateFile(arguments.input, profile.threads, estimateOptions));
+            }
+            writeText(text);
         }
+        else {
+            std::vector<uint8_t> input;
+            if (fromStandardInput) Utility::readStandardInput(input);
+            else Utility::readFileToVector(arguments.input, input);
+            inputSize = input.size();
 
-        return finalResult;
-    }
+            if (option == U"-b") {
+                writeText(Benchmark::drawResults(Benchmark::runAll(input), input.size()));
+            }
+            else if (option == U"-v") {
+                // Compare with the original next to the archive when there is one, otherwise with the stored checksums
+                IOBackend& io = IOBackend::getInstance();
+                Parallelization::SourceReader source;
+                uint64_t sourceSize = 0;
+                std::u32string sourcePath = base + Utility::bytesToString(Archive::readIndex(input).extension);
+                if (!fromStandardInput && Utility::fileExists(sourcePath)) {
+                    sourceSize = io.fileSize(sourcePath);
+                    source = [&io, sourcePath](uint64_t offset, size_t length, std::vector<uint8_t>& data) {
+                        io.readRange(sourcePath, offset, length, data);
+                    };
+                }
 
-private:
-    // Encodes a single chunk of input data
-    static std::vector<uint8_t> encodeChunk(std::vector<uint8_t>& chunk, ProgressCallback progressCallback = nullptr) {
-        try {
-            return LZW::encode(chunk, progressCallback);
+                Parallelization::VerifyResult verified = Parallelization::parallelVerify(input, profile.threads, source, sourceSize, progressCallback);
+                writeText(Parallelization::drawVerifyResult(verified));
+                if (!verified.ok) exitCode = Mismatch;
+                else if (verified.nothingChecked()) exitCode = Unverified;
+            }
+            else if (option == U"-s") {
+                // Archives are analysed as stored, anything else is encoded in memory first
+                std::vector<uint8_t> archive;
+                if (extension != U".bin") {
+                    archive = Parallelization::parallelEncode(input, profile.threads, nullptr, encodeOptions(U"-c", profile), ParallelOptions(), Utility::stringToBytes(extension), chunkingOptions(U"-c", profile));
+                }
+                const std::vector<uint8_t>& analysed = extension == U".bin" ? input : archive;
+
+                std::string json = CodeStatistics::toJson(CodeStatistics::analyze(analysed, profile.threads));
+                std::vector<uint8_t> data(json.begin(), json.end());
+                write(outputPath(base + U".stats.json"), data);
+                outputSize = data.size();
+            }
+            else if (option == U"-g") {
+                SearchOptions searchOptions;
+                searchOptions.maxMatches = arguments.maxMatches;
+                searched = Parallelization::parallelSearch(input, arguments.patterns, profile.threads, searchOptions, progressCallback);
+                std::string text = Parallelization::drawSearchResult(searched);
+                writeText(text);
+                outputSize = text.size();
+                if (searched.matches.empty()) exitCode = NoMatch;
+            }
+            else if (option == U"-d") {
+                std::u32string path = outputPath(base + U" Decoded" + Utility::bytesToString(Archive::readIndex(input).extension));
+                bool sparse = arguments.sparse && path != U"-";
+                std::vector<uint8_t> decoded = Parallelization::parallelDecode(input, profile.threads, progressCallback, ParallelOptions(), sparse ? &holes : nullptr);
+                if (sparse) IOBackend::getInstance().writeSparseFile(path, decoded, holes);
+                else write(path, decoded);
+                outputSize = decoded.size();
+            }
+            else {
+                EncodeOptions options = encodeOptions(option, profile);
+                options.searchFilters = arguments.searchIndex;
+                ChunkingOptions chunking = chunkingOptions(option, profile);
+                std::unique_ptr<BlockCache> cache = cacheFromEnvironment();
+                std::u32string path = outputPath(base + U".bin");
+
+                if (option == U"-a" && Utility::fileExists(path)) {
+                    std::vector<Archive::Entry> existing = Archive::readIndexFromFile(path).entries; // Blocks already stored are referenced
+                    std::vector<Archive::Block> blocks = Parallelization::encodeBlocks(input, profile.threads, progressCallback, options, ParallelOptions(), chunking, existing, cache.get(), deadline.get());
+                    Archive::append(path, blocks);
+                    outputSize = Utility::getFileSize(path);
+                }
+                else {
+                    std::vector<uint8_t> encoded = Parallelization::parallelEncode(input, profile.threads, progressCallback, options, ParallelOptions(), Utility::stringToBytes(extension), chunking, cache.get(), deadline.get());
+                    write(path, encoded);
+                    outputSize = encoded.size();
+                }
+            }
         }
-        catch (const std::exception& e) {
-            ExceptionHandler::ExceptionHandle(e);
-            return {}; // Return empty vector in case of error
+        if (arguments.progress) std::cerr << "\n";
+        if (option == U"-g") {
+            std::cerr << "Search: " << searched.matches.size() << (searched.truncated ? "+" : "") << " matches, "
+                << searched.skipped << " of " << searched.blocks << " blocks skipped\n";
         }
-    }
 
-    // Decodes a single chunk of encoded data
-    static std::vector<uint8_t> decodeChunk(std::vector<uint8_t>& chunk, ProgressCallback progressCallback = nullptr) {
-        try {
-            return LZW::decode(chunk, progressCallback);
+        // Blocks the deadline downgraded, by tier
+        std::vector<size_t> downgraded[3];
+        if (deadline) {
+            std::vector<Deadline::Tier> tiers = deadline->blockTiers();
+            for (size_t i = 0; i < tiers.size(); ++i) downgraded[tiers[i]].push_back(i);
+            if (!downgraded[Deadline::Fast].empty() || !downgraded[Deadline::Stored].empty()) {
+                std::cerr << "Deadline: " << downgraded[Deadline::Fast].size() << " of " << tiers.size() << " blocks fast, "
+                    << downgraded[Deadline::Stored].size() << " stored\n";
+            }
         }
-        catch (const std::exception& e) {
-            ExceptionHandler::ExceptionHandle(e);
-            return {}; // Return empty string in case of error
+
+        // Summary of the run for the caller's records
+        if (!arguments.stats.empty()) {
+            double seconds = duration<double>(steady_clock::now() - started).count();
+            std::ostringstream json;
+            json << std::setprecision(6)
+                << "{\"option\": \"" << Utility::u32stringToString(option) << "\", \"exitCode\": " << exitCode
+                << ", \"inputSize\": " << inputSize << ", \"outputSize\": " << outputSize
+                << ", \"ratio\": " << (inputSize ? static_cast<double>(outputSize) / inputSize : 0.0)
+                << ", \"seconds\": " << seconds << ", \"mbPerSecond\": " << (seconds > 0 ? inputSize / seconds / (1024 * 1024) : 0.0)
+                << ", \"threads\": " << profile.threads << ", \"blockSize\": " << profile.blockSize << ", \"maxCodeBits\": " << profile.maxCodeBits;
+            if (memoryOptions.budget > 0) {
+                json << ", \"memory\": {\"budget\": " << memoryOptions.budget << ", \"peak\": " << MemoryGovernor::getInstance().peak() << "}";
+            }
+            if (deadline) {
+                json << ", \"deadline\": {\"seconds\": " << arguments.deadline;
+                for (Deadline::Tier tier : { Deadline::Fast, Deadline::Stored }) {
+                    json << ", \"" << Deadline::tierName(tier) << "\": [";
+                    for (size_t i = 0; i < downgraded[tier].size(); ++i) json << (i ? ", " : "") << downgraded[tier][i];
+                    json << "]";
+                }
+                json << "}";
+            }
+            if (option == U"-d") {
+                json << ", \"sparse\": {\"holes\": " << holes.size() << ", \"holeBytes\": " << ZeroRuns::total(holes) << "}";
+            }
+            if (option == U"-g") {
+                json << ", \"search\": {\"matches\": " << searched.matches.size() << ", \"truncated\": " << (searched.truncated ? "true" : "false")
+                    << ", \"blocks\": " << searched.blocks << ", \"skipped\": " << searched.skipped << "}";
+            }
+            json << "}\n";
+            std::string text = json.str();
+            write(arguments.stats, std::vector<uint8_t>(text.begin(), text.end()));
         }
+        return exitCode;
     }
 
-    // Concatenates multiple vectors into a single vector and includes metadata for each chunk.
-    // Metadata includes the size of each chunk and the total number of chunks.
-    static void concatenateWithMetadata(const std::vector<std::vector<uint8_t>>& vectors, std::vector<uint8_t>& result) {
-        // Append all vectors to the result
-        for (const auto& vec : vectors) {
-            result.insert(result.end(), vec.begin(), vec.end());
-        }
-        // Append the size of each vector as a 4-byte integer
-        for (const auto& vec : vectors) {
-            std::vector<uint8_t> sizeVec = Bitpacker::intToBytes(static_cast<int>(vec.size()), 4);
-            result.insert(result.end(), sizeVec.begin(), sizeVec.end());
-        }
-        // Append the total count of vectors as a single byte
-        result.push_back(static_cast<uint8_t>(vectors.size()));
+    // Positive number of seconds, fractions allowed
+    static double parseSeconds(const std::string& text) {
+        char* end = nullptr;
+        double value = std::strtod(text.c_str(), &end);
+        if (end == text.c_str() || *end != '\0' || !(value > 0)) throw std::runtime_error("Not a number of seconds: " + text + ".");
+        return value;
     }
 
-    // Splits a concatenated vector into original chunks based on size metadata.
-    // The input vector should contain metadata indicating the size of each chunk and the total count.
-    static void splitWithMetadata(std::vector<uint8_t>& data, std::vector<std::vector<uint8_t>>& output) {
-        // Retrieve the total number of chunks from the last byte of the data vector
-        int count = static_cast<int>(data[data.size() - 1]);
-        output.resize(count);
+    // Whole number with an optional K, M or G suffix, within [low, high]
+    static uint64_t parseNumber(const std::string& text, uint64_t low, uint64_t high) {
+        char* end = nullptr;
+        uint64_t value = std::strtoull(text.c_str(), &end, 10);
+        if (end == text.c_str()) throw std::runtime_error("Not a number: " + text + ".");
+        std::string suffix(end);
+        if (suffix == "K" || suffix == "k") value <<= 10;
+        else if (suffix == "M" || suffix == "m") value <<= 20;
+        else if (suffix == "G" || suffix == "g") value <<= 30;
+        else if (!suffix.empty()) throw std::runtime_error("Not a number: " + text + ".");
+        if (value < low || value > high) throw std::runtime_error("Out of range: " + text + ".");
+        return value;
+    }
+};
 
-        // Calculate the start position of the size metadata
-        size_t sizeMetadataStart = data.size() - (count * 4 + 1);
+#ifdef _WIN32
+// Interactive front end: the console screens, one job after another until the window is closed
+class ConsoleApp {
 
-        // Extract sizes of each chunk from metadata
-        std::vector<int> sizeIntVec(count);
-        for (size_t i = 0; i < count; ++i) {
-            std::vector<uint8_t> sizeBytes(data.begin() + sizeMetadataStart + i * 4, data.begin() + sizeMetadataStart + (i + 1) * 4);
-            sizeIntVec[i] = Bitpacker::bytesToInt(sizeBytes);
-        }
+public:
+    static void run() {
+        std::wcout.imbue(std::locale(""));
+        ExceptionHandler::interactive() = true;
 
-        // Split the data vector into chunks based on the extracted sizes
-        size_t start = 0;
-        for (size_t i = 0; i < output.size(); ++i) {
-            output[i] = std::vector<uint8_t>(data.begin() + start, data.begin() + start + sizeIntVec[i]);
-            start += sizeIntVec[i];
+        while (true) {
+            runJob();
+
+            // Clear the screen for the next job
+            GUI::clearScreen();
+            SharedResource::resetOnceFlag();
         }
     }
-};
 
-// Main function for encoding or decoding files based on user input
-int main() {
-    try {
-        // Set the global locale to the user's preferred locale
-        std::setlocale(LC_ALL, "");
-        std::wcout.imbue(std::locale(""));
+private:
+    // Reads one job from the main screen, runs it and shows the result
+    static void runJob() {
+        try {
+            // Draw the main screen of the GUI
+            std::cout << GUI::drawMainScreen();
+
+            // Find and set cursor position for the input field
+            COORD inputField = Cursor::findTextInConsole("Input: ");
+            Cursor::goTo(inputField.X, inputField.Y);
+
+            // Lambda to handle screen updates for input field based on line changes
+            auto lineChangeCallbackInput = [](bool direction) {
+                if (direction) {
+                    std::string screenUpdate = {
+                        "\n |                                                                  |"
+                        "\n \\__________________________________________________________________/ "
+                        "\n  __________________________________________________________________   "
+                        "\n /                                                                  \\  "
+                        "\n | Progress: [--------------------] 0 %       Time: 00:00:00        | "
+                        "\n |                                                                  | "
+                        "\n | Size: - / -                               Speed: -               | "
+                        "\n |__________________________________________________________________| "
+                        "\n |                                                                  | "
+                        "\n | Output: -                                                        | "
+                        "\n \\__________________________________________________________________/ "
+                        "\n                                                                       "
+                    };
+                    std::cout << screenUpdate;
+                }
+                else {
+                    std::string screenUpdate = {
+                        "\n \\__________________________________________________________________/ "
+                        "\n  __________________________________________________________________   "
+                        "\n /                                                                  \\  "
+                        "\n | Progress: [--------------------] 0 %       Time: 00:00:00        | "
+                        "\n |                                                                  | "
+                        "\n | Size: - / -                               Speed: -               | "
+                        "\n |__________________________________________________________________| "
+                        "\n |                                                                  | "
+                        "\n | Output: -                                                        | "
+                        "\n \\__________________________________________________________________/ "
+                        "\n                                                                       "
+                    };
+                    std::cout << screenUpdate;
+                }
+            };
 
-        // Disable assertion pop-ups that cannot be caught by standard exception handling
-        ExceptionHandler::DisableAssertionPopups();
+            // Read input from the user and update the screen accordingly
+            std::u32string userInput = Cursor::readInputStream(57, lineChangeCallbackInput);
+
+            // Split the input into separate arguments
+            std::vector<std::u32string> userInputVec = Utility::splitInputFilePathAndOption(userInput);
+
+            // Determine input path and option based on input arguments
+            const std::u32string INPUT_PATH = Utility::isIndexInRange(userInputVec, 0) ? userInputVec[0] : U"-0";
+            const std::u32string INPUT_EXT = Utility::isIndexInRange(userInputVec, 1) ? userInputVec[1] : U"-1";
+            const std::u32string INPUT_OPTION = Utility::isIndexInRange(userInputVec, 2) ? userInputVec[2] : U"-2";
+
+            // Check if the input file exists
+            if (!Utility::fileExists(INPUT_PATH + INPUT_EXT)) throw std::runtime_error("File not found at input path.");
+            // Check if the input option is valid
+            if (!Utility::isValidOption(INPUT_OPTION)) throw std::runtime_error("Input option not valid.");
+
+            // Threads, block size and reset width tuned for this machine (see "-t"), or the defaults
+            TuneProfile profile = TuneProfile::load();
+
+            // Background limits on I/O and workers (see ThrottleOptions::fromEnvironment), and the memory budget
+            Throttle::getInstance().configure(ThrottleOptions::fromEnvironment());
+            MemoryGovernor::getInstance().configure(MemoryOptions::fromEnvironment());
+    #ifndef _WIN32
+            Throttle::installSignalHandlers();
+    #endif
+
+            // Tune on a sample of the file and save the profile for later runs
+            if (INPUT_OPTION == U"-t") {
+                COORD lastChar = Cursor::getLastConsoleChar();
+                Cursor::goTo(0, lastChar.Y + 2);
+                Autotuner::Result tuned = Autotuner::tuneFile(INPUT_PATH + INPUT_EXT);
+                tuned.profile.save();
+                std::cout << Autotuner::drawResult(tuned);
+
+                Cursor::pause();
+                return; // Next job
+            }
 
-        // Draw the main screen of the GUI
-        std::cout << GUI::drawMainScreen();
+            // Estimate ratio, size and time from a sample of the file, reading only the sampled blocks
+            if (INPUT_OPTION == U"-e") {
+                EncodeOptions estimateOptions;
+                estimateOptions.maxCodeBits = profile.maxCodeBits;
+                COORD lastChar = Cursor::getLastConsoleChar();
+                Cursor::goTo(0, lastChar.Y + 2);
+                std::cout << Estimator::drawEstimate(Estimator::estimateFile(INPUT_PATH + INPUT_EXT, profile.threads, estimateOptions));
 
-        // Find and set cursor position for the input field
-        COORD inputField = Cursor::findTextInConsole("Input: ");
-        Cursor::goTo(inputField.X, inputField.Y);
+                Cursor::pause();
+                return; // Next job
+            }
 
-        // Lambda to handle screen updates for input field based on line changes
-        auto lineChangeCallbackInput = [](bool direction) {
-            if (direction) {
-                std::string screenUpdate = {
-                    "\n |                                                                  |"
-                    "\n \\__________________________________________________________________/ "
-                    "\n  __________________________________________________________________   "
-                    "\n /                                                                  \\  "
-                    "\n | Progress: [--------------------] 0 %       Time: 00:00:00        | "
-                    "\n |                                                                  | "
-                    "\n | Size: - / -                               Speed: -               | "
-                    "\n |__________________________________________________________________| "
-                    "\n |                                                                  | "
-                    "\n | Output: -                                                        | "
-                    "\n \\__________________________________________________________________/ "
-                    "\n                                                                       "
-                };
-                std::cout << screenUpdate;
+            // Read the input file bytes
+            std::vector<uint8_t> input;
+            Utility::readFileToVector(INPUT_PATH + INPUT_EXT, input);
+
+            // Benchmark every LZW policy combination on the input instead of writing an output file
+            if (INPUT_OPTION == U"-b") {
+                COORD lastChar = Cursor::getLastConsoleChar();
+                Cursor::goTo(0, lastChar.Y + 2);
+                std::cout << Benchmark::drawResults(Benchmark::runAll(input), input.size());
+
+                Cursor::pause();
+                return; // Next job
             }
-            else {
-                std::string screenUpdate = {
-                    "\n \\__________________________________________________________________/ "
-                    "\n  __________________________________________________________________   "
-                    "\n /                                                                  \\  "
-                    "\n | Progress: [--------------------] 0 %       Time: 00:00:00        | "
-                    "\n |                                                                  | "
-                    "\n | Size: - / -                               Speed: -               | "
-                    "\n |__________________________________________________________________| "
-                    "\n |                                                                  | "
-                    "\n | Output: -                                                        | "
-                    "\n \\__________________________________________________________________/ "
-                    "\n                                                                       "
-                };
-                std::cout << screenUpdate;
+
+            // Write dictionary and code-stream statistics of every block to a .stats.json file next to the input
+            // An archive is analysed as stored; any other file is first encoded in memory with the profile's settings
+            if (INPUT_OPTION == U"-s") {
+                std::vector<uint8_t> archive;
+                if (INPUT_EXT != U".bin") {
+                    archive = Parallelization::parallelEncode(input, profile.threads, nullptr, CommandLine::encodeOptions(U"-c", profile), ParallelOptions(), Utility::stringToBytes(INPUT_EXT), CommandLine::chunkingOptions(U"-c", profile));
+                }
+                const std::vector<uint8_t>& analysed = INPUT_EXT == U".bin" ? input : archive;
+
+                CodeStatistics::Report report = CodeStatistics::analyze(analysed, profile.threads);
+                std::string json = CodeStatistics::toJson(report);
+                Utility::writeVectorToFile(INPUT_PATH + U".stats.json", std::vector<uint8_t>(json.begin(), json.end()));
+
+                COORD lastChar = Cursor::getLastConsoleChar();
+                Cursor::goTo(0, lastChar.Y + 2);
+                std::cout << CodeStatistics::drawReport(report);
+
+                Cursor::pause();
+                return; // Next job
             }
-        };
 
-        // Read input from the user and update the screen accordingly
-        std::u32string userInput = Cursor::readInputStream(57, lineChangeCallbackInput);
+            // Decode the archive and compare it with the original file next to it (or with the stored
+            // checksums when it is gone), without writing anything
+            if (INPUT_OPTION == U"-v") {
+                if (INPUT_EXT != U".bin") throw std::runtime_error("Cannot verify non .bin files.");
+
+                IOBackend& io = IOBackend::getInstance();
+                std::u32string sourcePath = INPUT_PATH + Utility::bytesToString(Archive::readIndex(input).extension);
+                Parallelization::SourceReader source;
+                uint64_t sourceSize = 0;
+                if (Utility::fileExists(sourcePath)) {
+                    sourceSize = io.fileSize(sourcePath);
+                    source = [&io, sourcePath](uint64_t offset, size_t length, std::vector<uint8_t>& data) {
+                        io.readRange(sourcePath, offset, length, data);
+                    };
+                }
 
-        // Split the input into separate arguments
-        std::vector<std::u32string> userInputVec = Utility::splitInputFilePathAndOption(userInput);
+                Parallelization::VerifyResult verified = Parallelization::parallelVerify(input, profile.threads, source, sourceSize);
+                COORD lastChar = Cursor::getLastConsoleChar();
+                Cursor::goTo(0, lastChar.Y + 2);
+                std::cout << Parallelization::drawVerifyResult(verified);
 
-        // Determine input path and option based on input arguments
-        const std::u32string INPUT_PATH = Utility::isIndexInRange(userInputVec, 0) ? userInputVec[0] : U"-0";
-        const std::u32string INPUT_EXT = Utility::isIndexInRange(userInputVec, 1) ? userInputVec[1] : U"-1";
-        const std::u32string INPUT_OPTION = Utility::isIndexInRange(userInputVec, 2) ? userInputVec[2] : U"-2";
+                Cursor::pause();
+                return; // Next job
+            }
 
-        // Check if the input file exists
-        if (!Utility::fileExists(INPUT_PATH + INPUT_EXT)) throw std::exception("File not found at input path.");
-        // Check if the input option is valid
-        if (!Utility::isValidOption(INPUT_OPTION)) throw std::exception("Input option not valid.");
+            // Compress options write a .bin file, "-ce" also tries the entropy coding stage per block,
+            // "-cf" runs each block through the delta/shuffle/run-length filters that suit it best,
+            // "-cp" primes each block's dictionary on the end of the block before it (one chain per thread),
+            // "-cd" cuts blocks by content and stores repeated blocks once,
+            // "-a" does the same and adds the blocks to an existing .bin file (or creates it)
+            const bool APPEND = INPUT_OPTION == U"-a";
+            const bool COMPRESS = CommandLine::isCompressOption(INPUT_OPTION);
+            EncodeOptions encodeOptions = CommandLine::encodeOptions(INPUT_OPTION, profile);
+            ChunkingOptions chunking = CommandLine::chunkingOptions(INPUT_OPTION, profile);
+
+            // Encoded blocks are cached when LZWPP_CACHE names a directory (limit in MB from LZWPP_CACHE_MB)
+            std::unique_ptr<BlockCache> cache;
+            if (COMPRESS) cache = CommandLine::cacheFromEnvironment();
+
+            // Determine output path based on input option
+            std::u32string OUTPUT_PATH = INPUT_PATH;
+            if (COMPRESS) {
+                OUTPUT_PATH += U".bin";
+            }
+            else if (INPUT_OPTION == U"-d") {
+                if (INPUT_EXT != U".bin") throw std::runtime_error("Cannot decompress non .bin files.");
 
-        // Read the input file bytes
-        std::vector<uint8_t> input;
-        Utility::readFileToVector(INPUT_PATH + INPUT_EXT, input);
+                std::vector<uint8_t> extensionVec = Archive::readIndex(input).extension; // The extension is stored in the archive index
+                OUTPUT_PATH += U" Decoded" + Utility::bytesToString(extensionVec); // Add the file extension to the output path
+            }
 
-        // Determine output path based on input option
-        std::u32string OUTPUT_PATH = INPUT_PATH;
-        if (INPUT_OPTION == U"-c") {
-            OUTPUT_PATH += U".bin";
-        }
-        else if (INPUT_OPTION == U"-d") {
-            if (INPUT_EXT != U".bin") throw std::exception("Cannot decompress non .bin files.");
+            // Find and set cursor position for the size field, then display the input file size
+            COORD sizeField = Cursor::findTextInConsole("Size: - / ");
+            Cursor::goTo(sizeField.X, sizeField.Y);
+            std::cout << GUI::drawSizeField(Utility::getFileSize(INPUT_PATH + INPUT_EXT));
 
-            ptrdiff_t indexOfDot = Utility::findLastDot(input); // Start index of the extension
-            std::vector<uint8_t> extensionVec = Utility::extractSubVector(input, indexOfDot, input.size() - indexOfDot); // Efficient sub-vector extarction
-            OUTPUT_PATH += U" Decoded" + Utility::bytesToString(extensionVec); // Add the file extension to the output path
-            input.resize(indexOfDot); // Remove the file extension from the compressed data
-        }
+            // Find and set cursor position for the output field
+            COORD outputField = Cursor::findTextInConsole("Output: ");
+            Cursor::goTo(outputField.X, outputField.Y);
 
-        // Find and set cursor position for the size field, then display the input file size
-        COORD sizeField = Cursor::findTextInConsole("Size: - / ");
-        Cursor::goTo(sizeField.X, sizeField.Y);
-        std::cout << GUI::drawSizeField(Utility::getFileSize(INPUT_PATH + INPUT_EXT));
+            // Lambda to handle screen updates for the output field
+            auto lineChangeCallbackOutput = []() {
+                std::string screenUpdate = {
+                    "\n |                                                                  | "
+                    "\n \\__________________________________________________________________/ "
+                };
+                std::cout << screenUpdate;
+            };
 
-        // Find and set cursor position for the output field
-        COORD outputField = Cursor::findTextInConsole("Output: ");
-        Cursor::goTo(outputField.X, outputField.Y);
+            // Display the output file path
+            std::u32string outputString = Cursor::writeOutputStream(OUTPUT_PATH, 57, lineChangeCallbackOutput);
 
-        // Lambda to handle screen updates for the output field
-        auto lineChangeCallbackOutput = []() {
-            std::string screenUpdate = {
-                "\n |                                                                  | "
-                "\n \\__________________________________________________________________/ "
+            // Callback to update progress
+            auto progressCallback = [](double progress) {
+                ProgressTracker::getInstance().updateProgress(progress);
             };
-            std::cout << screenUpdate;
-        };
 
-        // Display the output file path
-        std::u32string outputString = Cursor::writeOutputStream(OUTPUT_PATH, 57, lineChangeCallbackOutput);
+            // Initialize progress tracker and timer
+            ProgressTracker& progressTracker = ProgressTracker::getInstance();
+            progressTracker.start();
+            Timer timer;
+            timer.start();
+
+            // Perform encoding or decoding based on the input option
+            if (COMPRESS) { // Encoding
+                if (APPEND && Utility::fileExists(outputString)) {
+                    std::vector<Archive::Entry> existing = Archive::readIndexFromFile(outputString).entries; // Blocks already stored are referenced
+                    std::vector<Archive::Block> blocks = Parallelization::encodeBlocks(input, profile.threads, progressCallback, encodeOptions, ParallelOptions(), chunking, existing, cache.get());
+                    Archive::append(outputString, blocks); // Only the index of the existing archive is read
+                }
+                else {
+                    std::vector<uint8_t> encodedData = Parallelization::parallelEncode(input, profile.threads, progressCallback, encodeOptions, ParallelOptions(), Utility::stringToBytes(INPUT_EXT), chunking, cache.get()); // The extension is kept in the index
+                    Utility::writeVectorToFile(outputString, encodedData); // Final write to .bin file
+                }
+            }
+            else { // Decoding
+                std::vector<ZeroRuns::Run> holes;
+                std::vector<uint8_t> decodedData = Parallelization::parallelDecode(input, profile.threads, progressCallback, ParallelOptions(), &holes);
+                IOBackend::getInstance().writeSparseFile(outputString, decodedData, holes); // Final write to original file, runs of zeros left as holes
+            }
+
+            // Stop the progress tracker and timer
+            progressTracker.stop();
+            timer.stop();
 
-        // Callback to update progress
-        auto progressCallback = [](double progress) {
-            ProgressTracker::getInstance().updateProgress(progress);
-        };
+            // Update size fields with sizes of input and output files
+            sizeField = Cursor::findTextInConsole("Size: ");
+            Cursor::goTo(sizeField.X, sizeField.Y);
+            int outputSize = Utility::getFileSize(OUTPUT_PATH);
+            int inputSize = Utility::getFileSize(INPUT_PATH + INPUT_EXT);
+            std::cout << GUI::drawSizeField(outputSize) << " / " << GUI::drawSizeField(inputSize);
 
-        // Initialize progress tracker and timer
-        ProgressTracker& progressTracker = ProgressTracker::getInstance();
-        progressTracker.start();
-        Timer timer;
-        timer.start();
+            // Display the compression ratio
+            double compressionRatio = static_cast<double>(outputSize) / inputSize;
+            std::cout << " (" << std::fixed << std::setprecision(4) << compressionRatio << ")";
 
-        // Perform encoding or decoding based on the input option
-        if (INPUT_OPTION == U"-c") { // Encoding
-            std::vector<uint8_t> encodedData = Parallelization::parallelEncode(input, 4, progressCallback);
-            Utility::appendVector(encodedData, Utility::stringToBytes(INPUT_EXT)); // Add the extension as metadata
-            Utility::writeVectorToFile(outputString, encodedData); // Final write to .bin file
+            // Display the speed
+            COORD speedField = Cursor::findTextInConsole("Speed: ");
+            Cursor::goTo(speedField.X, speedField.Y);
+            std::cout << GUI::drawSpeed(inputSize, timer.getDuration());
+
+            // Pause the cursor to prevent further input
+            Cursor::pause();
         }
-        else { // Decoding
-            std::vector<uint8_t> decodedData = Parallelization::parallelDecode(input, 4, progressCallback);
-            Utility::writeVectorToFile(outputString, decodedData); // Final write to original file
+        catch (const std::exception& e) {
+            // Handle any exceptions that occurred during processing
+            ExceptionHandler::ExceptionHandle(e);
         }
+    }
+};
+#endif
 
-        // Stop the progress tracker and timer
-        progressTracker.stop();
-        timer.stop();
-
-        // Update size fields with sizes of input and output files
-        sizeField = Cursor::findTextInConsole("Size: ");
-        Cursor::goTo(sizeField.X, sizeField.Y);
-        int outputSize = Utility::getFileSize(OUTPUT_PATH);
-        int inputSize = Utility::getFileSize(INPUT_PATH + INPUT_EXT);
-        std::cout << GUI::drawSizeField(outputSize) << " / " << GUI::drawSizeField(inputSize);
-
-        // Display the compression ratio
-        double compressionRatio = static_cast<double>(outputSize) / inputSize;
-        std::cout << " (" << std::fixed << std::setprecision(4) << compressionRatio << ")";
+// Arguments run one job from the command line, LZWPP_DAEMON serves jobs on a socket,
+// and without either the console screens take jobs interactively (Windows only)
+int main(int argc, char* argv[]) {
+    // Set the global locale to the user's preferred locale
+    std::setlocale(LC_ALL, "");
 
-        // Display the speed
-        COORD speedField = Cursor::findTextInConsole("Speed: ");
-        Cursor::goTo(speedField.X, speedField.Y);
-        std::cout << GUI::drawSpeed(inputSize, timer.getDuration());
+    // Disable assertion pop-ups that cannot be caught by standard exception handling
+    ExceptionHandler::DisableAssertionPopups();
 
-        // Pause the cursor to prevent further input
-        Cursor::pause();
+    if (argc > 1) {
+        return CommandLine::run(argc, argv);
     }
-    catch (const std::exception& e) {
-        // Handle any exceptions that occurred during processing
-        ExceptionHandler::ExceptionHandle(e);
+
+#ifndef _WIN32
+    // LZWPP_DAEMON names a socket: serve jobs on it instead of the console
+    if (std::getenv("LZWPP_DAEMON")) {
+        try {
+            Throttle::getInstance().configure(ThrottleOptions::fromEnvironment());
+            Throttle::installSignalHandlers();
+            MemoryGovernor::getInstance().configure(MemoryOptions::fromEnvironment()); // Shared by all the jobs the daemon runs
+            return Daemon(DaemonOptions::fromEnvironment()).run();
+        }
+        catch (const std::exception& e) {
+            ExceptionHandler::ExceptionHandle(e);
+            return CommandLine::Failure;
+        }
     }
 
-    // Clear the screen and restart the main function (for repeated runs)
-    GUI::clearScreen();
-    SharedResource::resetOnceFlag();
-    main();
+    std::cerr << CommandLine::usage();
+    return CommandLine::BadArguments;
+#else
+    ConsoleApp::run();
     return 0;
+#endif
 }
+#endif
@@ -0,0 +1,93 @@
+// C interface of the LZWpp compressor
+// Build LZWpp.cpp with LZWPP_NO_MAIN (and LZWPP_BUILD_DLL on Windows) to get a library exporting these functions.
+// The output of lzw_compress is an archive in the same format as the files written by the program,
+// so either side can read what the other wrote.
+#ifndef LZWPP_H
+#define LZWPP_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(LZWPP_BUILD_DLL)
+#define LZWPP_API __declspec(dllexport)
+#elif defined(LZWPP_USE_DLL)
+#define LZWPP_API __declspec(dllimport)
+#else
+#define LZWPP_API
+#endif
+#elif defined(__GNUC__)
+#define LZWPP_API __attribute__((visibility("default")))
+#else
+#define LZWPP_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Version of this interface; grows only by additions
+#define LZWPP_API_VERSION 1
+
+// Results of the functions below; everything but LZW_OK leaves *dstlen untouched
+typedef enum lzw_status {
+    LZW_OK = 0,
+    LZW_ERROR_DST_TOO_SMALL = -1, // The output does not fit in dstcap bytes
+    LZW_ERROR_CORRUPT = -2, // The input is not a valid archive or fails its checksums
+    LZW_ERROR_INVALID_ARGUMENT = -3, // Null pointer or option value out of range
+    LZW_ERROR_OUT_OF_MEMORY = -4, // A work buffer could not be grown
+    LZW_ERROR_INTERNAL = -5 // Any other failure
+} lzw_status;
+
+// Settings of a context, all optional
+typedef enum lzw_option {
+    LZW_OPT_MAX_CODE_BITS = 1, // Reset the dictionary once it needs codes this wide (9-30), 0 never resets (default)
+    LZW_OPT_GROWING_WIDTH = 2, // 1 writes each code with the width of the dictionary at that point (default), 0 one width per block
+    LZW_OPT_ENTROPY_CODING = 3, // 1 adds the Huffman stage where it helps, 0 does not (default)
+    LZW_OPT_BLOCK_SIZE = 4, // Bytes per block, LZW_MIN_BLOCK_SIZE to LZW_MAX_BLOCK_SIZE; 0 (default) uses blocks of LZW_DEFAULT_BLOCK_SIZE
+    LZW_OPT_FILTERS = 5, // Combination of lzw_filter run on each block before encoding, 0 none (default)
+    LZW_OPT_ELEMENT_WIDTH = 6, // Record width in bytes for LZW_FILTER_DELTA and LZW_FILTER_SHUFFLE (1-255, default 1)
+    LZW_OPT_PRIME_BYTES = 7, // Prime each block's dictionary on this many trailing bytes of the block before it, 0 disables (default)
+    LZW_OPT_PRIME_CHAIN = 8, // Blocks per chain of primed blocks (the first is not primed), 0 primes every block but the first (default)
+    LZW_OPT_LONG_REPEATS = 9 // 1 stores long runs and copies of earlier data as references instead of codes (default), 0 codes everything
+} lzw_option;
+
+// Reversible transforms for arrays of fixed-width records (LZW_OPT_FILTERS)
+typedef enum lzw_filter {
+    LZW_FILTER_DELTA = 0x01, // Each byte minus the byte one record earlier
+    LZW_FILTER_SHUFFLE = 0x02, // Byte j of every record gathered into plane j
+    LZW_FILTER_RUN_LENGTH = 0x04, // Runs of equal bytes stored as a count and the byte
+    LZW_FILTER_AUTO = 0x80 // Pick the filters and record width per block from a sample
+} lzw_filter;
+
+#define LZW_MIN_BLOCK_SIZE (64 * 1024)
+#define LZW_MAX_BLOCK_SIZE (1024 * 1024 * 1024)
+#define LZW_DEFAULT_BLOCK_SIZE (1024 * 1024)
+
+// Options and work buffers of one caller; a context is not safe to use from several threads at once
+// Buffers grow to the largest block seen and are then reused, so repeated calls do not allocate for them.
+typedef struct lzw_context lzw_context;
+
+LZWPP_API unsigned lzw_version(void);
+
+LZWPP_API lzw_context* lzw_context_create(void);
+LZWPP_API void lzw_context_free(lzw_context* context);
+LZWPP_API int lzw_context_set_option(lzw_context* context, lzw_option option, long long value);
+
+// Largest output lzw_compress can produce for srclen bytes with any options
+LZWPP_API size_t lzw_compress_bound(size_t srclen);
+
+// Compresses src into dst; on success stores the number of bytes written in *dstlen
+LZWPP_API int lzw_compress(lzw_context* context, const void* src, size_t srclen, void* dst, size_t dstcap, size_t* dstlen);
+
+// Size of the data an archive decompresses to, read from its index
+// Archives written before the index existed do not record it and give LZW_ERROR_CORRUPT.
+LZWPP_API int lzw_decompressed_size(const void* src, size_t srclen, unsigned long long* size);
+
+// Decompresses the archive in src into dst; on success stores the number of bytes written in *dstlen
+LZWPP_API int lzw_decompress(lzw_context* context, const void* src, size_t srclen, void* dst, size_t dstcap, size_t* dstlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
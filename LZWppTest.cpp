@@ -0,0 +1,214 @@
+// Regression tests of the LZWpp compressor
+// Build as one translation unit with the library: compile this file alone with LZWpp.cpp next to it,
+// e.g. g++ -std=c++14 -O2 LZWppTest.cpp -o LZWppTest -pthread. Exits with the number of failed checks.
+#define LZWPP_NO_MAIN
+#include "LZWpp.cpp"
+
+static int failures = 0;
+
+// Records a failed expectation without stopping the other tests
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Runs 'action' and tells whether it threw std::runtime_error with 'message'
+template <typename Action>
+static bool throwsError(Action action, const std::string& message) {
+    try {
+        action();
+    }
+    catch (const std::runtime_error& error) {
+        return message == error.what();
+    }
+    return false;
+}
+
+// Entropy coded blocks: round trip, and damaged headers rejected before anything is allocated or written
+static void testHuffmanCoder() {
+    std::vector<int> codes;
+    for (int i = 0; i < 10000; ++i) codes.push_back((i * 7919) % 5000);
+    std::vector<uint8_t> encoded;
+    HuffmanCoder::encode(codes, encoded);
+    std::vector<int> decoded;
+    HuffmanCoder::decode(encoded, decoded);
+    check(decoded == codes, "Huffman round trip");
+
+    // Every symbol one bit long oversubscribes the code space
+    std::vector<uint8_t> oversubscribed = Bitpacker::intToBytes(1, 4);
+    oversubscribed.insert(oversubscribed.end(), HuffmanCoder::numSymbols / 2, 0x11);
+    oversubscribed.insert(oversubscribed.end(), 16, 0);
+    check(throwsError([&]() { HuffmanCoder::decode(oversubscribed, decoded); }, "Bad entropy coded block."),
+        "Huffman oversubscribed lengths rejected");
+
+    // No code lengths at all for a non-empty stream
+    std::vector<uint8_t> empty = Bitpacker::intToBytes(1, 4);
+    empty.insert(empty.end(), HuffmanCoder::numSymbols / 2 + 16, 0);
+    check(throwsError([&]() { HuffmanCoder::decode(empty, decoded); }, "Bad entropy coded block."),
+        "Huffman missing lengths rejected");
+
+    // More codes than the stream has bits
+    std::vector<uint8_t> tooMany = encoded;
+    std::vector<uint8_t> count = Bitpacker::intToBytes(0x7FFFFFFF, 4);
+    std::copy(count.begin(), count.end(), tooMany.begin());
+    check(throwsError([&]() { HuffmanCoder::decode(tooMany, decoded); }, "Bad entropy coded block."),
+        "Huffman oversized count rejected");
+}
+
+// Record filters: every kind and record width gives back the original bytes
+static void testBlockFilter() {
+    std::vector<uint8_t> input(3001);
+    std::mt19937 random(1);
+    for (uint8_t& byte : input) byte = static_cast<uint8_t>(random());
+
+    const uint8_t kinds[] = { BlockFilter::Delta, BlockFilter::Shuffle, BlockFilter::Delta | BlockFilter::Shuffle };
+    for (uint8_t kind : kinds) {
+        for (int width = 1; width <= 255; ++width) {
+            std::vector<uint8_t> filtered, restored;
+            BlockFilter::apply(input.data(), input.size(), kind, width, filtered);
+            BlockFilter::invert(filtered.data(), filtered.size(), kind, width, restored);
+            check(restored == input, "filter " + std::to_string(kind) + " width " + std::to_string(width) + " round trip");
+        }
+    }
+}
+
+// Block trailers: code streams of 2^31 bits or more keep their full bit count
+static void testBlockTrailer() {
+    for (int64_t nbits : { static_cast<int64_t>(12345), static_cast<int64_t>(0x7FFFFFFF), static_cast<int64_t>(0x80000000), static_cast<int64_t>(30) << 30 }) {
+        BlockTrailer trailer;
+        trailer.nbits = nbits;
+        trailer.bitWidth = 30;
+        trailer.flags = BlockTrailer::GrowingWidth | BlockTrailer::Filtered | BlockTrailer::Primed;
+        trailer.filters = BlockFilter::Delta;
+        trailer.elementWidth = 4;
+        trailer.primeWindow = 4096;
+        trailer.primedEntries = 1000;
+        std::vector<uint8_t> block(3, 0xAB);
+        trailer.write(block);
+
+        BlockTrailer read = BlockTrailer::read(block);
+        std::string what = "trailer with " + std::to_string(nbits) + " bits";
+        check(read.nbits == nbits, what + " keeps its bit count");
+        check(read.size == block.size() - 3, what + " keeps its size");
+        check(read.bitWidth == 30 && read.elementWidth == 4 && read.primeWindow == 4096 && read.primedEntries == 1000, what + " keeps its fields");
+    }
+}
+
+// Decoding: a block that decodes but does not match its stored CRC-32 fails the job
+static void testBlockChecksums() {
+    std::vector<uint8_t> text;
+    for (int i = 0; i < 200000; ++i) text.push_back(static_cast<uint8_t>("abcdefgh"[(i * 31 + i / 7) % 8]));
+
+    std::vector<Archive::Block> blocks(2);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        std::vector<uint8_t> chunk(text.begin() + i * 100000, text.begin() + (i + 1) * 100000);
+        blocks[i].data = LZW::encode(chunk);
+        blocks[i].rawSize = chunk.size();
+        blocks[i].crc = Checksum::crc32(chunk.data(), chunk.size());
+    }
+    std::vector<uint8_t> archive = Archive::build(blocks, {});
+    check(Parallelization::parallelDecode(archive, 2) == text, "archive round trip");
+
+    blocks[1].crc ^= 1;
+    std::vector<uint8_t> damaged = Archive::build(blocks, {});
+    check(throwsError([&]() { Parallelization::parallelDecode(damaged, 2); }, "Checksum of block 1 does not match."),
+        "parallelDecode checks block checksums");
+    std::vector<uint8_t> output(text.size());
+    check(throwsError([&]() { Parallelization::parallelDecodeInto(damaged, 2, OutputSpans(output.data(), output.size())); }, "Checksum of block 1 does not match."),
+        "parallelDecodeInto checks block checksums");
+
+    // Verification reports a checksum mismatch, and does not report success when it had nothing to compare with
+    Parallelization::VerifyResult verified = Parallelization::parallelVerify(damaged, 2);
+    check(!verified.ok && verified.reason == "Checksum of block 1 does not match.", "verify finds a checksum mismatch");
+
+    std::vector<uint8_t> legacy; // Blocks, their sizes, the block count and the extension, as written before the index
+    for (const Archive::Block& block : blocks) legacy.insert(legacy.end(), block.data.begin(), block.data.end());
+    for (const Archive::Block& block : blocks) Utility::appendVector(legacy, Bitpacker::intToBytes(static_cast<int>(block.data.size()), 4));
+    legacy.push_back(static_cast<uint8_t>(blocks.size()));
+    legacy.push_back('.');
+    legacy.push_back('x');
+    verified = Parallelization::parallelVerify(legacy, 2);
+    check(verified.nothingChecked(), "verify of an archive without checksums checks nothing");
+    check(Parallelization::drawVerifyResult(verified).find(" OK") == std::string::npos, "verify without checksums does not report OK");
+}
+
+// Compresses 'input' through the C interface with 'options' set on a fresh context; empty on failure
+static std::vector<uint8_t> compressWith(const std::vector<uint8_t>& input, const std::vector<std::pair<lzw_option, long long>>& options) {
+    std::unique_ptr<lzw_context, void (*)(lzw_context*)> context(lzw_context_create(), lzw_context_free);
+    for (const auto& option : options) {
+        if (lzw_context_set_option(context.get(), option.first, option.second) != LZW_OK) return {};
+    }
+    std::vector<uint8_t> archive(lzw_compress_bound(input.size()));
+    size_t length = 0;
+    if (lzw_compress(context.get(), input.data(), input.size(), archive.data(), archive.size(), &length) != LZW_OK) return {};
+    archive.resize(length);
+    return archive;
+}
+
+// C interface: round trips with every option, and damaged archives rejected without crashing
+static void testCInterface() {
+    std::vector<uint8_t> input;
+    std::mt19937 random(7);
+    for (int i = 0; i < 300000; ++i) {
+        // Text-like runs, a few long repeats and some noise, in records of 24 bytes
+        if (i % 50000 < 2000) input.push_back(0);
+        else if (i > 100000 && i % 40000 < 3000) input.push_back(input[i - 60000]);
+        else input.push_back(static_cast<uint8_t>(i % 24 < 12 ? "the quick brown fox "[(i / 24) % 20] : random() % 16));
+    }
+
+    const std::vector<std::vector<std::pair<lzw_option, long long>>> settings = {
+        {},
+        { { LZW_OPT_ENTROPY_CODING, 1 } },
+        { { LZW_OPT_GROWING_WIDTH, 0 }, { LZW_OPT_MAX_CODE_BITS, 12 } },
+        { { LZW_OPT_BLOCK_SIZE, LZW_MIN_BLOCK_SIZE }, { LZW_OPT_PRIME_BYTES, 32768 } },
+        { { LZW_OPT_FILTERS, LZW_FILTER_DELTA }, { LZW_OPT_ELEMENT_WIDTH, 24 } },
+        { { LZW_OPT_FILTERS, LZW_FILTER_DELTA }, { LZW_OPT_ELEMENT_WIDTH, 100 } },
+        { { LZW_OPT_FILTERS, LZW_FILTER_DELTA | LZW_FILTER_SHUFFLE | LZW_FILTER_RUN_LENGTH }, { LZW_OPT_ELEMENT_WIDTH, 3 } },
+        { { LZW_OPT_FILTERS, LZW_FILTER_AUTO }, { LZW_OPT_ENTROPY_CODING, 1 }, { LZW_OPT_LONG_REPEATS, 0 } },
+    };
+    std::unique_ptr<lzw_context, void (*)(lzw_context*)> context(lzw_context_create(), lzw_context_free);
+    std::vector<uint8_t> output(input.size());
+    for (size_t s = 0; s < settings.size(); ++s) {
+        std::string what = "C interface settings " + std::to_string(s);
+        std::vector<uint8_t> archive = compressWith(input, settings[s]);
+        check(!archive.empty(), what + " compress");
+
+        unsigned long long size = 0;
+        check(lzw_decompressed_size(archive.data(), archive.size(), &size) == LZW_OK && size == input.size(), what + " decompressed size");
+        size_t length = 0;
+        check(lzw_decompress(context.get(), archive.data(), archive.size(), output.data(), output.size(), &length) == LZW_OK
+            && length == input.size() && output == input, what + " round trip");
+        check(lzw_decompress(context.get(), archive.data(), archive.size(), output.data(), output.size() - 1, &length) == LZW_ERROR_DST_TOO_SMALL,
+            what + " small output");
+    }
+
+    // The default splits large inputs into blocks rather than coding them whole
+    check(Archive::readIndex(compressWith(std::vector<uint8_t>(3 * LZW_DEFAULT_BLOCK_SIZE, 'x'), {})).entries.size() == 3, "C interface default block size");
+    check(lzw_context_set_option(context.get(), LZW_OPT_BLOCK_SIZE, LZW_MIN_BLOCK_SIZE - 1) == LZW_ERROR_INVALID_ARGUMENT, "C interface block size range");
+
+    // Damaged archives give an error or the original data, never anything else (run under ASan to catch stray accesses)
+    std::vector<uint8_t> archive = compressWith(input, settings[1]);
+    for (int trial = 0; trial < 400; ++trial) {
+        std::vector<uint8_t> damaged = archive;
+        if (trial % 4 == 0) damaged.resize(random() % damaged.size());
+        else damaged[random() % damaged.size()] ^= static_cast<uint8_t>(1 << (random() % 8));
+
+        size_t length = 0;
+        int status = lzw_decompress(context.get(), damaged.data(), damaged.size(), output.data(), output.size(), &length);
+        check(status == LZW_ERROR_CORRUPT || (status == LZW_OK && length == input.size() && output == input),
+            "C interface damaged archive " + std::to_string(trial) + " gives status " + std::to_string(status));
+    }
+}
+
+int main() {
+    testHuffmanCoder();
+    testBlockFilter();
+    testBlockTrailer();
+    testBlockChecksums();
+    testCInterface();
+
+    if (failures == 0) std::cout << "All tests passed." << std::endl;
+    return failures;
+}